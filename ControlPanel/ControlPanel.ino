@@ -6,6 +6,9 @@
 #include "FreeRTOS.h"
 #include "semphr.h"
 #include <functional>
+// Requires the DeferredLog and MpscRing libraries of the Shared folder.
+#include <DeferredLog.hpp>
+#include "LogMessages.h"
 
 #define Uart Serial1
 // Using micropython addresses.
@@ -14,6 +17,8 @@ static const uint16_t ENCODER_RESOLUTION{4096u};
 static const uint16_t ENCODER_ANGLE_OFFSET{3946u}; // - 150
 // Hysteresis for the encoder slots in percent.
 static const float ENCODER_SLOT_HYSTERESIS{0.05f};
+// Maximum number of log records that are sent per iteration of the loop.
+static const size_t LOG_RECORDS_PER_ITERATION{4u};
 
 AS5600 encoder;
 // We use 255 as a default value to not influence the calculation of the first slot (Hysteresis).
@@ -440,10 +445,7 @@ void sendButtonStateChange()
 
       numEvents++;
 
-      Serial.print("Button ");
-      Serial.print(buttonIndex);
-      Serial.print(" event: ");
-      Serial.println(event);
+      DeferredLog::write(ControlPanelLog::BUTTON_EVENT, buttonIndex, event);
     }
   }
 
@@ -529,6 +531,9 @@ void setup()
   Serial.begin(115200);
   delay(500);
   Serial.println("startup");
+#ifdef DEFERRED_LOG_TEXT
+  DeferredLog::setTextFormats(ControlPanelLogFormats);
+#endif
 
   // Create a mutex for the UART communication.
   uartMutex = xSemaphoreCreateMutex();
@@ -558,14 +563,13 @@ void loop()
     bool isConnected = encoder.isConnected();
     if (!isConnected)
     {
-      Serial.println("Encoder is not connected");
+      DeferredLog::write(ControlPanelLog::ENCODER_NOT_CONNECTED);
     }
 
     const bool hasEncoderSlotChanged = updateEncoderSlot();
     if (hasEncoderSlotChanged)
     {
-      Serial.print("Encoder slot changed to: ");
-      Serial.println(currentEndcoderSlot);
+      DeferredLog::write(ControlPanelLog::ENCODER_SLOT_CHANGED, currentEndcoderSlot);
       sendEncoderStateChange(0, currentEndcoderSlot);
     }
   }
@@ -574,6 +578,9 @@ void loop()
   loopButtons();
   sendButtonStateChange();
 
+  // Logs are sent once the time critical work of the iteration is done.
+  DeferredLog::drain(Serial, LOG_RECORDS_PER_ITERATION);
+
   delay(1);
 }
 
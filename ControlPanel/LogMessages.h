@@ -0,0 +1,12 @@
+#pragma once
+
+#include <DeferredLogFormat.hpp>
+
+// Messages of the control panel for the deferred logger. New messages are only appended, otherwise, the decoder shows
+// wrong texts for captures of older firmwares.
+#define CONTROL_PANEL_LOG_MESSAGES(X)                         \
+  X(BUTTON_EVENT, "Button %u event: %u")                      \
+  X(ENCODER_NOT_CONNECTED, "Encoder is not connected")        \
+  X(ENCODER_SLOT_CHANGED, "Encoder slot changed to: %u")
+
+DEFERRED_LOG_CATALOG(ControlPanelLog, CONTROL_PANEL_LOG_MESSAGES);
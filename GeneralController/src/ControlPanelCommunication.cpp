@@ -1,12 +1,48 @@
 #include "ControlPanelCommunication.hpp"
+#include "LogMessages.hpp"
+#include <DeferredLog.hpp>
 
 #define Uart Serial2
 
-ControlPanelCommunication::ControlPanelCommunication(std::queue<InputEvent *> *const eventQueue, const int8_t tx_pin, const int8_t rx_pin, const uint32_t config, const uint32_t baudrate) : eventQueue(eventQueue)
+ControlPanelCommunication::ControlPanelCommunication(InputEventQueue *const eventQueue, const int8_t tx_pin, const int8_t rx_pin, const uint32_t config, const uint32_t baudrate) : eventQueue(eventQueue)
 {
     Uart.begin(baudrate, config, rx_pin, tx_pin);
 }
 
+void ControlPanelCommunication::startReaderTask(TaskHandle_t eventTask)
+{
+    eventTaskHandle = eventTask;
+    xTaskCreatePinnedToCore(
+        [](void *param)
+        {
+            static_cast<ControlPanelCommunication *>(param)->runTask();
+        },
+        "ControlPanelReaderTask", // Task name
+        4096,                     // Stack size (bytes)
+        this,                     // Parameter
+        4,                        // Task priority, above the control task such that a button reaches it right away
+        &taskHandle,              // Task handle
+        1);                       // Core where the task should run
+    // Called by the event task of the UART driver, which waits on the event queue of the driver. The driver reports
+    // the received bytes once the line was idle for a few symbols, i.e. right after a message.
+    Uart.onReceive(
+        [this]()
+        {
+            xTaskNotifyGive(taskHandle);
+        });
+}
+
+void ControlPanelCommunication::runTask()
+{
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (update())
+        {
+        }
+    }
+}
+
 bool ControlPanelCommunication::update()
 {
     return receiveMessage();
@@ -22,7 +58,12 @@ void ControlPanelCommunication::processMessage(const char *message, size_t messa
         const uint8_t buttonId = static_cast<uint8_t>(message[1u + (i * 4u)]);
         const uint8_t buttonEvent = static_cast<uint8_t>(message[3u + (i * 4u)]);
 
-        eventQueue->push(new InputEvent(buttonId, buttonEvent));
+        // The queue counts an event that does not fit, the control task reports it.
+        eventQueue->push(InputEvent(buttonId, buttonEvent));
+    }
+    if ((numEvents > 0u) && (eventTaskHandle != nullptr))
+    {
+        xTaskNotifyGive(eventTaskHandle);
     }
 }
 
@@ -42,15 +83,16 @@ bool ControlPanelCommunication::receiveMessage()
             // Read the next character from the buffer
             char receivedChar = Uart.read();
 
-            if (controlPanelMsgBuffer.length() == (expectedMsgLength - 1u))
+            if (controlPanelMsgLength == (expectedMsgLength - 1u))
             {
                 messageComplete = true;
                 isMsgValid = (static_cast<uint8_t>(receivedChar) == 0u);
             }
             else
             {
-                // Add the new character to the end of the string.
-                controlPanelMsgBuffer += receivedChar;
+                // Add the new character to the end of the message.
+                controlPanelMsgBuffer[controlPanelMsgLength] = receivedChar;
+                controlPanelMsgLength++;
             }
         }
     }
@@ -58,34 +100,23 @@ bool ControlPanelCommunication::receiveMessage()
     // If we received a full message and it is valid, then print it
     if (messageComplete && isMsgValid)
     {
-        const char *controlPanelMsg = controlPanelMsgBuffer.c_str();
+        const char *controlPanelMsg = controlPanelMsgBuffer;
 
         switch (controlPanelMsg[0u])
         {
         case 'B':
-            processMessage(controlPanelMsg, controlPanelMsgBuffer.length());
+            processMessage(controlPanelMsg, controlPanelMsgLength);
             break;
         case 'E':
-            Serial.print("Encoder: ");
-            Serial.print(static_cast<uint32_t>(controlPanelMsg[1u]));
-            Serial.print(" State: ");
-            Serial.println(*reinterpret_cast<const uint16_t *>(&(controlPanelMsg[3u])));
+            DeferredLog::write(ControllerLog::ENCODER, static_cast<uint8_t>(controlPanelMsg[1u]), *reinterpret_cast<const uint16_t *>(&(controlPanelMsg[3u])));
             break;
         default:
-            Serial.println("Unknown");
-            for (size_t i = 0u; i < controlPanelMsgBuffer.length(); i++)
-            {
-                Serial.print("'");
-                Serial.print(static_cast<uint32_t>(controlPanelMsgBuffer[i]));
-                Serial.print("'");
-                Serial.print(" ");
-            }
-            Serial.println();
+            DeferredLog::write(ControllerLog::UNKNOWN_PANEL_MESSAGE, controlPanelMsgLength, static_cast<uint8_t>(controlPanelMsg[0u]));
             break;
         }
 
         // Clear everything for the next message.
-        controlPanelMsgBuffer = "";
+        controlPanelMsgLength = 0u;
         expectedMsgLength = 0u;
     }
 
@@ -1,23 +1,35 @@
 #pragma once
 
 #include <Arduino.h>
-#include <queue>
 #include "InputController.hpp"
 
 class ControlPanelCommunication
 {
 private:
-    std::queue<InputEvent *> *const eventQueue{};
+    // A message starts with its length byte, which does not count itself.
+    static constexpr size_t MAX_MESSAGE_LENGTH{UINT8_MAX};
 
-    std::string controlPanelMsgBuffer{""};
+    InputEventQueue *const eventQueue{};
+    TaskHandle_t taskHandle{nullptr};
+    // Notified whenever events were queued, e.g. the control task.
+    TaskHandle_t eventTaskHandle{nullptr};
+
+    // Fixed buffer, such that reading a message never allocates.
+    char controlPanelMsgBuffer[MAX_MESSAGE_LENGTH]{};
+    size_t controlPanelMsgLength{0u};
     uint8_t expectedMsgLength{0u};
 
     bool receiveMessage();
     void processMessage(const char *message, size_t messageLength);
+    void runTask();
 
 public:
-    ControlPanelCommunication(std::queue<InputEvent *> *const eventQueue, const int8_t tx_pin, const int8_t rx_pin, const uint32_t config, const uint32_t baudrate);
+    ControlPanelCommunication(InputEventQueue *const eventQueue, const int8_t tx_pin, const int8_t rx_pin, const uint32_t config, const uint32_t baudrate);
     ~ControlPanelCommunication() = default;
 
+    // Starts the task that reads the messages of the control panel as soon as the UART driver received them, it
+    // notifies the event task once it queued events. Without it, update() has to be called instead.
+    void startReaderTask(TaskHandle_t eventTask);
+    // Reads the next message, returns true if a message was complete.
     bool update();
 };
\ No newline at end of file
@@ -1,268 +1,505 @@
 #include "GearboxCommunication.hpp"
+#include "LogMessages.hpp"
+#include <DeferredLog.hpp>
 
-GearboxCommunication::GearboxCommunication(const uint8_t gearboxLeftAddress, const uint8_t gearboxRightAddress, TwoWire *i2c, const int i2cSdaPin, const int i2cSclPin, const uint32_t i2cFrequency) : addressLeft(gearboxLeftAddress), addressRight(gearboxRightAddress), i2c(i2c)
+static_assert(GearboxProtocol::MAX_COMMAND_LENGTH <= I2cTransactionEngine::MAX_WRITE_LENGTH, "Every command has to fit into a transaction.");
+
+GearboxCommunication::GearboxCommunication(const uint8_t gearboxLeftAddress, const uint8_t gearboxRightAddress, TwoWire *i2c, const int i2cSdaPin, const int i2cSclPin, const uint32_t i2cFrequency) : GearboxCommunication(gearboxLeftAddress, gearboxRightAddress, i2c, i2cSdaPin, i2cSclPin, nullptr, -1, -1, i2cFrequency)
+{
+}
+
+GearboxCommunication::GearboxCommunication(const uint8_t gearboxLeftAddress, const uint8_t gearboxRightAddress, TwoWire *i2cLeft, const int i2cLeftSdaPin, const int i2cLeftSclPin, TwoWire *i2cRight, const int i2cRightSdaPin, const int i2cRightSclPin, const uint32_t i2cFrequency) : addressLeft(gearboxLeftAddress), addressRight(gearboxRightAddress), busLeft(i2cLeft, i2cLeftSdaPin, i2cLeftSclPin, i2cFrequency), busRight(i2cRight != nullptr ? i2cRight : i2cLeft, i2cRightSdaPin, i2cRightSclPin, i2cFrequency), hasSeparateBuses(i2cRight != nullptr)
 {
     // Initialize I2C bus.
     Serial.begin(115200);
     Serial.println("Initializing Gearbox I2C bus");
-    const bool i2cSuccess = i2c->begin(i2cSdaPin, i2cSclPin, i2cFrequency);
+    bool i2cSuccess = busLeft.begin();
+    if (hasSeparateBuses)
+    {
+        i2cSuccess &= busRight.begin();
+    }
     Serial.print("Gearbox I2C bus initialized: ");
     Serial.println(i2cSuccess ? "true" : "false");
+#ifdef GEARBOX_ATTENTION_LINE
+    pinMode(GEARBOX_LEFT_ATTENTION_PIN, INPUT_PULLUP);
+    pinMode(GEARBOX_RIGHT_ATTENTION_PIN, INPUT_PULLUP);
+#endif
 }
 
-bool GearboxCommunication::sendCommand(uint8_t *data, const size_t dataLength, const bool isLeftGearbox)
+I2cTransactionEngine &GearboxCommunication::busOf(const bool isLeftGearbox)
 {
-    constexpr size_t RESPONSE_LENGTH{5u};
-    const uint8_t address = isLeftGearbox ? addressLeft : addressRight;
-    uint8_t response[RESPONSE_LENGTH] = {0u};
+    return (isLeftGearbox || !hasSeparateBuses) ? busLeft : busRight;
+}
 
-    i2c->beginTransmission(address);
-    size_t bytesWritten{0u};
-    while (bytesWritten < dataLength)
+void GearboxCommunication::startBusTask()
+{
+    busLeft.startTask();
+    if (hasSeparateBuses)
     {
-        bytesWritten += i2c->write(&(data[bytesWritten]), dataLength - bytesWritten);
+        busRight.startTask();
     }
-    i2c->endTransmission();
-
-    // Request a response from the gearbox.
-    // TODO: After driving the motors and then stopping, we receive this error from the general controller: [ 10253][E][Wire.cpp:513] requestFrom(): i2cRead returned Error 263
-    uint8_t readCount = i2c->requestFrom(address, RESPONSE_LENGTH);
+}
 
-    if (readCount != RESPONSE_LENGTH)
+size_t GearboxCommunication::processReplies()
+{
+#ifdef EMERGENCY_STOP_LINE
+    emergencyStopLine.update();
+#endif
+    const unsigned long currentTimeUS = micros();
+    if (currentTimeUS - lastLinkHealthLogUS >= LINK_HEALTH_LOG_INTERVAL_US)
+    {
+        lastLinkHealthLogUS = currentTimeUS;
+        logLinkHealth(busLeft, true, lastLoggedErrorsLeft);
+        if (hasSeparateBuses)
+        {
+            logLinkHealth(busRight, false, lastLoggedErrorsRight);
+        }
+    }
+    // A time sync reply takes the place of a status, thus, a moving desk keeps its polls and the gearboxes go on with
+    // the drift they learned.
+    const bool isAtRest = (sampleLeft.speed == 0) && (sampleRight.speed == 0);
+    if (isAtRest && (currentTimeUS - lastTimeSyncUS >= TIME_SYNC_INTERVAL_US))
     {
-        // Failed sending command.
-        return false;
+        lastTimeSyncUS = currentTimeUS;
+        sendTimeSync(true);
+        sendTimeSync(false);
     }
+    if (isAtRest && isLeftReachable && isRightReachable && !isBroadcastSupported() && !isBroadcastRejected && (currentTimeUS - lastBroadcastProbeUS >= BROADCAST_PROBE_INTERVAL_US))
+    {
+        lastBroadcastProbeUS = currentTimeUS;
+        probeBroadcast();
+    }
+    return busLeft.dispatchCompletions() + busRight.dispatchCompletions();
+}
 
-    // Read the response.
-    size_t bytesRead{0u};
-    while (bytesRead < RESPONSE_LENGTH)
+void GearboxCommunication::logLinkHealth(const I2cTransactionEngine &bus, const bool isLeftBus, uint32_t &lastLoggedErrors)
+{
+    const uint32_t errors = bus.getNacks() + bus.getTimeouts() + bus.getRetries();
+    if (errors != lastLoggedErrors)
     {
-        if (i2c->available())
-        {
-            response[bytesRead] = i2c->read();
-            bytesRead++;
-        }
+        DeferredLog::write(ControllerLog::I2C_LINK_HEALTH, isLeftBus ? 0u : 1u, bus.getNacks(), bus.getTimeouts(), bus.getRetries());
+        lastLoggedErrors = errors;
     }
+}
 
-    processResponse(response, isLeftGearbox);
-    return true;
+I2cTransactionEngine::Transaction GearboxCommunication::createTransaction(const uint8_t address, const uint32_t tag)
+{
+    I2cTransactionEngine::Transaction transaction{};
+    transaction.address = address;
+    transaction.deadlineUS = micros() + COMMAND_DEADLINE_US;
+    transaction.callback = &GearboxCommunication::onReply;
+    transaction.context = this;
+    transaction.tag = tag;
+    return transaction;
 }
 
-void GearboxCommunication::processResponse(const uint8_t *const response, const bool isLeftGearbox)
+bool GearboxCommunication::sendCommand(GearboxProtocol::Command &command, const bool isLeftGearbox)
 {
-    // Process the response.
-    if (isLeftGearbox)
+    // The gearboxes take time syncs aside, every other command ends their jog.
+    if ((command.code != GearboxProtocol::CMD_JOG) && (command.code != GearboxProtocol::CMD_TIME_SYNC))
     {
-        positionLeft = *reinterpret_cast<const uint32_t *>(response);
-        brakeStateLeft = response[4u];
+        lastJogDirection = 0;
     }
-    else
+    sequence++;
+    command.sequence = sequence;
+
+    I2cTransactionEngine::Transaction transaction = createTransaction(isLeftGearbox ? addressLeft : addressRight, isLeftGearbox ? 0u : 1u);
+    transaction.writeLength = GearboxProtocol::encodeCommand(command, transaction.writeData);
+    transaction.readLength = GearboxProtocol::STATUS_LENGTH;
+    return busOf(isLeftGearbox).submit(transaction);
+}
+
+bool GearboxCommunication::requestStatus(const bool isLeftGearbox)
+{
+    I2cTransactionEngine::Transaction transaction = createTransaction(isLeftGearbox ? addressLeft : addressRight, isLeftGearbox ? 0u : 1u);
+    transaction.readLength = GearboxProtocol::STATUS_LENGTH;
+    return busOf(isLeftGearbox).submit(transaction);
+}
+
+bool GearboxCommunication::broadcast(GearboxProtocol::Command &command)
+{
+    if (!isBroadcastSupported())
     {
-        positionRight = *reinterpret_cast<const uint32_t *>(response);
-        brakeStateRight = response[4u];
+        return sendToBoth(command);
     }
+    isLastBroadcastResent = false;
+    return submitBroadcast(command);
 }
 
-void GearboxCommunication::driveUp()
+bool GearboxCommunication::probeBroadcast()
 {
-    constexpr size_t DATA_LENGTH{5u};
-    // Save last position such that both gearboxes get the position from roughly the same time.
-    const uint32_t lastPositionRight{positionRight};
-    const uint32_t lastPositionLeft{positionLeft};
+    GearboxProtocol::Command command{};
+    command.code = GearboxProtocol::CMD_GET_POSITION;
+    // A rejected probe is not sent again, the gearboxes are polled anyway.
+    isLastBroadcastResent = true;
+    return submitBroadcast(command);
+}
 
-    uint8_t data[DATA_LENGTH] = {0u};
-    // Set first byte to command code
-    data[0u] = CMD_MOVE_UP;
+bool GearboxCommunication::submitBroadcast(GearboxProtocol::Command &command)
+{
+    lastJogDirection = 0;
+    sequence++;
+    command.sequence = sequence;
+    lastBroadcast = command;
+
+    I2cTransactionEngine::Transaction transaction = createTransaction(GearboxProtocol::BROADCAST_ADDRESS, BROADCAST_TAG);
+    transaction.writeLength = GearboxProtocol::encodeBroadcast(command, toMotion(sampleLeft), toMotion(sampleRight), transaction.writeData);
+    bool success = busLeft.submit(transaction);
+    if (hasSeparateBuses)
+    {
+        // Both tasks start the broadcast right away, thus, the gearboxes still get it at about the same time.
+        transaction.tag = BROADCAST_TAG | RIGHT_BUS_TAG_FLAG;
+        success &= busRight.submit(transaction);
+    }
 
-    // Left
-    // Set last 4 bytes to position of right gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionRight;
-    sendCommand(data, DATA_LENGTH, true);
+    // The reads follow the broadcast on the same bus.
+    success &= requestStatus(true);
+    success &= requestStatus(false);
+    return success;
+}
 
-    // Right
-    // Set last 4 bytes to position of left gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionLeft;
-    sendCommand(data, DATA_LENGTH, false);
+bool GearboxCommunication::sendTimeSync(const bool isLeftGearbox)
+{
+    TimeSyncExchange &exchange = isLeftGearbox ? timeSyncLeft : timeSyncRight;
+    GearboxProtocol::Command command{};
+    command.code = GearboxProtocol::CMD_TIME_SYNC;
+    command.peer = toMotion(isLeftGearbox ? sampleRight : sampleLeft);
+    // Without a complete exchange, the sequence of this command never matches the last exchange of the gearbox.
+    command.previousSyncSequence = exchange.isComplete ? exchange.sequence : static_cast<uint8_t>(sequence + 1u);
+    command.previousSyncWrittenUS = exchange.writtenUS;
+    command.previousSyncReadUS = exchange.readUS;
+
+    sequence++;
+    command.sequence = sequence;
+    exchange = TimeSyncExchange{};
+    exchange.sequence = sequence;
+
+    I2cTransactionEngine::Transaction transaction = createTransaction(isLeftGearbox ? addressLeft : addressRight, (isLeftGearbox ? 0u : 1u) | TIME_SYNC_TAG_FLAG);
+    transaction.writeLength = GearboxProtocol::encodeCommand(command, transaction.writeData);
+    transaction.readLength = GearboxProtocol::STATUS_LENGTH;
+    return busOf(isLeftGearbox).submit(transaction);
 }
 
-void GearboxCommunication::driveDown()
+void GearboxCommunication::onReply(void *context, const I2cTransactionEngine::Transaction &transaction)
 {
-    constexpr size_t DATA_LENGTH{5u};
-    // Save last position such that both gearboxes get the position from roughly the same time.
-    const uint32_t lastPositionRight{positionRight};
-    const uint32_t lastPositionLeft{positionLeft};
+    static_cast<GearboxCommunication *>(context)->processReply(transaction);
+}
 
-    uint8_t data[DATA_LENGTH] = {0u};
-    // Set first byte to command code
-    data[0u] = CMD_MOVE_DOWN;
+void GearboxCommunication::processReply(const I2cTransactionEngine::Transaction &transaction)
+{
+    if ((transaction.tag & ~RIGHT_BUS_TAG_FLAG) == BROADCAST_TAG)
+    {
+        processBroadcastReply(transaction);
+        return;
+    }
 
-    // Left
-    // Set last 4 bytes to position of right gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionRight;
-    sendCommand(data, DATA_LENGTH, true);
-    // Right
-    // Set last 4 bytes to position of left gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionLeft;
-    sendCommand(data, DATA_LENGTH, false);
+    const bool isLeftGearbox = (transaction.tag & ~TIME_SYNC_TAG_FLAG) == 0u;
+    bool &isReachable = isLeftGearbox ? isLeftReachable : isRightReachable;
+    if (transaction.result != I2cTransactionEngine::Result::Ok)
+    {
+        DeferredLog::write(ControllerLog::GEARBOX_TRANSACTION_FAILED, isLeftGearbox ? 0u : 1u, transaction.attempts, static_cast<uint8_t>(transaction.result));
+        isReachable = false;
+        return;
+    }
+    if ((transaction.tag & TIME_SYNC_TAG_FLAG) != 0u)
+    {
+        TimeSyncExchange &exchange = isLeftGearbox ? timeSyncLeft : timeSyncRight;
+        exchange.writtenUS = static_cast<uint32_t>(transaction.writtenUS);
+        exchange.isWritten = true;
+    }
+    // The first read after a time sync is answered with the times of the gearbox instead of its status.
+    if (GearboxProtocol::isTimeSyncReply(transaction.readData, transaction.readLength))
+    {
+        isReachable = true;
+        processTimeSyncReply(transaction, isLeftGearbox);
+        return;
+    }
+
+    // A corrupted status is dropped, the last valid one is kept.
+    GearboxProtocol::Status status{};
+    const GearboxProtocol::DecodeResult result = GearboxProtocol::decodeStatus(transaction.readData, transaction.readLength, status);
+    if (result != GearboxProtocol::DecodeResult::Ok)
+    {
+        DeferredLog::write(ControllerLog::GEARBOX_STATUS_REJECTED, isLeftGearbox ? 0u : 1u, static_cast<uint8_t>(result));
+        isReachable = false;
+        return;
+    }
+
+    isReachable = true;
+    processResponse(status, isLeftGearbox, transaction.completedUS);
 }
 
-void GearboxCommunication::driveTo(const uint32_t position)
+void GearboxCommunication::processBroadcastReply(const I2cTransactionEngine::Transaction &transaction)
 {
-    constexpr size_t DATA_LENGTH{9u};
-    // Save last position such that both gearboxes get the position from roughly the same time.
-    const uint32_t lastPositionRight{positionRight};
-    const uint32_t lastPositionLeft{positionLeft};
+    const bool isLeftBus = (transaction.tag & RIGHT_BUS_TAG_FLAG) == 0u;
+    bool &isAcknowledged = isLeftBus ? isBroadcastAcknowledgedLeft : isBroadcastAcknowledgedRight;
+    if (transaction.result == I2cTransactionEngine::Result::Ok)
+    {
+        if (!isAcknowledged)
+        {
+            DeferredLog::write(ControllerLog::GEARBOX_BROADCAST_ACKNOWLEDGED, isLeftBus ? 0u : 1u);
+        }
+        isAcknowledged = true;
+        return;
+    }
+    DeferredLog::write(ControllerLog::GEARBOX_BROADCAST_FAILED, transaction.attempts, static_cast<uint8_t>(transaction.result));
+    if (transaction.result != I2cTransactionEngine::Result::Nack)
+    {
+        return;
+    }
 
-    uint8_t data[DATA_LENGTH] = {0u};
-    // Set first byte to command code
-    data[0u] = CMD_MOVE_TO;
-    // Set bytes 1-4 to target position
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = position;
+    // Gearboxes that are switched off or a bus that falls back to a slower clock reject the broadcast as well, only
+    // gearboxes that answer their own address tell that the general call is not supported. Either way, the next
+    // commands are addressed to each gearbox till a probe is acknowledged again.
+    isAcknowledged = false;
+    if (isLeftReachable && isRightReachable && !isBroadcastRejected)
+    {
+        isBroadcastRejected = true;
+        DeferredLog::write(ControllerLog::GEARBOX_BROADCAST_UNSUPPORTED);
+    }
+    // With separate buses, both broadcasts are rejected, the command is sent again only once.
+    if (!isLastBroadcastResent)
+    {
+        isLastBroadcastResent = true;
+        sendToBoth(lastBroadcast);
+    }
+}
+
+void GearboxCommunication::processTimeSyncReply(const I2cTransactionEngine::Transaction &transaction, const bool isLeftGearbox)
+{
+    GearboxProtocol::TimeSyncReply reply{};
+    const GearboxProtocol::DecodeResult result = GearboxProtocol::decodeTimeSyncReply(transaction.readData, transaction.readLength, reply);
+    if (result != GearboxProtocol::DecodeResult::Ok)
+    {
+        DeferredLog::write(ControllerLog::GEARBOX_STATUS_REJECTED, isLeftGearbox ? 0u : 1u, static_cast<uint8_t>(result));
+        return;
+    }
+
+    TimeSyncExchange &exchange = isLeftGearbox ? timeSyncLeft : timeSyncRight;
+    if (!exchange.isWritten || (reply.sequence != exchange.sequence))
+    {
+        return;
+    }
+    // The gearbox took its time when the read started, the address and the reply took 9 clocks per byte after it.
+    const uint32_t replyTransferUS = static_cast<uint32_t>((9u * (1u + GearboxProtocol::TIME_SYNC_REPLY_LENGTH) * 1000000u) / busOf(isLeftGearbox).getFrequency());
+    exchange.readUS = static_cast<uint32_t>(transaction.completedUS) - replyTransferUS;
+    exchange.isComplete = true;
+}
+
+bool GearboxCommunication::sendToBoth(GearboxProtocol::Command &command)
+{
+    // Save last samples such that both gearboxes get the position from roughly the same time.
+    const GearboxSample lastSampleLeft{sampleLeft};
+    const GearboxSample lastSampleRight{sampleRight};
+    bool success{true};
 
     // Left
-    // Set last 4 bytes to position of right gearbox
-    *reinterpret_cast<uint32_t *>(&(data[5u])) = lastPositionRight;
-    sendCommand(data, DATA_LENGTH, true);
+    // Send the motion of the right gearbox
+    command.peer = toMotion(lastSampleRight);
+    success &= sendCommand(command, true);
+
     // Right
-    // Set last 4 bytes to position of left gearbox
-    *reinterpret_cast<uint32_t *>(&(data[5u])) = lastPositionLeft;
-    sendCommand(data, DATA_LENGTH, false);
+    // Send the motion of the left gearbox
+    command.peer = toMotion(lastSampleLeft);
+    success &= sendCommand(command, false);
+
+    return success;
 }
 
-void GearboxCommunication::emergencyStop()
+void GearboxCommunication::processResponse(const GearboxProtocol::Status &status, const bool isLeftGearbox, const unsigned long receivedUS)
 {
-    constexpr size_t DATA_LENGTH{5u};
-    // Save last position such that both gearboxes get the position from roughly the same time.
-    const uint32_t lastPositionRight{positionRight};
-    const uint32_t lastPositionLeft{positionLeft};
+    // The status may be sent before the gearbox handled the command, thus, only the gearbox can tell that it lost one.
+    if ((status.flags & GearboxProtocol::FLAG_COMMAND_LOST) != 0u)
+    {
+        DeferredLog::write(ControllerLog::GEARBOX_COMMAND_LOST, isLeftGearbox ? 0u : 1u, status.sequence);
+    }
+    if (status.events != 0u)
+    {
+        DeferredLog::write(ControllerLog::GEARBOX_EVENTS, isLeftGearbox ? 0u : 1u, status.events);
+    }
 
-    uint8_t data[DATA_LENGTH] = {0U};
-    // Set first byte to command code
-    data[0u] = CMD_EMERGENCY_STOP;
+    // Process the response.
+    GearboxSample &sample = isLeftGearbox ? sampleLeft : sampleRight;
+    sample.position = status.motion.position;
+    sample.speed = status.motion.speed;
+    sample.sampleTimeUS = receivedUS - status.motion.ageUS;
+    sample.brakeState = status.brakeState;
+    sample.flags = status.flags;
+    sample.skippedSteps = status.skippedSteps;
+    sample.acceptedSequence = status.sequence;
+}
 
-    // Left
-    // Set last 4 bytes to position of right gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionRight;
-    sendCommand(data, DATA_LENGTH, true);
+GearboxProtocol::Motion GearboxCommunication::toMotion(const GearboxSample &sample)
+{
+    GearboxProtocol::Motion motion{};
+    motion.position = sample.position;
+    motion.speed = sample.speed;
+    // The age saturates, a gearbox treats such an old position as is anyway.
+    motion.ageUS = static_cast<uint16_t>(min(micros() - sample.sampleTimeUS, static_cast<unsigned long>(UINT16_MAX)));
+    return motion;
+}
 
-    // Right
-    // Set last 4 bytes to position of left gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionLeft;
-    sendCommand(data, DATA_LENGTH, false);
+int32_t GearboxCommunication::extrapolatePosition(const GearboxSample &sample, const unsigned long referenceUS)
+{
+    // Signed such that a reference before the sample works as well.
+    const int32_t elapsedUS = static_cast<int32_t>(referenceUS - sample.sampleTimeUS);
+    return static_cast<int32_t>(sample.position) + static_cast<int32_t>((static_cast<int64_t>(sample.speed) * elapsedUS) / 1000000);
 }
 
-void GearboxCommunication::getPosition()
+unsigned long GearboxCommunication::getExchangeDurationUS() const
 {
-    constexpr size_t DATA_LENGTH{5u};
-    // Save last position such that both gearboxes get the position from roughly the same time.
-    const uint32_t lastPositionRight{positionRight};
-    const uint32_t lastPositionLeft{positionLeft};
+    const uint32_t frequency = min(getBus(true).getFrequency(), getBus(false).getFrequency());
+    const uint32_t gearboxesPerBus = hasSeparateBuses ? 1u : 2u;
+    return ((gearboxesPerBus * EXCHANGE_CLOCKS * 1000000u) + frequency - 1u) / frequency;
+}
 
-    uint8_t data[DATA_LENGTH] = {0u};
-    // Set first byte to command code
-    data[0u] = CMD_GET_POSITION;
+int32_t GearboxCommunication::getDeviation() const
+{
+    const bool isLeftLater = static_cast<int32_t>(sampleLeft.sampleTimeUS - sampleRight.sampleTimeUS) >= 0;
+    const unsigned long referenceUS = isLeftLater ? sampleLeft.sampleTimeUS : sampleRight.sampleTimeUS;
+    return extrapolatePosition(sampleLeft, referenceUS) - extrapolatePosition(sampleRight, referenceUS);
+}
 
-    // Left
-    // Set last 4 bytes to position of right gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionRight;
-    sendCommand(data, DATA_LENGTH, true);
-    // Right
-    // Set last 4 bytes to position of left gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionLeft;
-    sendCommand(data, DATA_LENGTH, false);
+void GearboxCommunication::driveUp()
+{
+    jog(1, 0u);
 }
 
-void GearboxCommunication::loosenBrake()
+void GearboxCommunication::driveDown()
 {
-    constexpr size_t DATA_LENGTH{5u};
-    // Save last position such that both gearboxes get the position from roughly the same time.
-    const uint32_t lastPositionRight{positionRight};
-    const uint32_t lastPositionLeft{positionLeft};
+    jog(-1, 0u);
+}
 
-    uint8_t data[DATA_LENGTH] = {0u};
-    // Set first byte to command code
-    data[0u] = CMD_LOOSEN_BRAKE;
+void GearboxCommunication::jog(const int8_t direction, const uint16_t speed)
+{
+    // Till both gearboxes run the jog, e.g. while one of them still finishes a move in the other direction and refuses
+    // it, every call sends it again.
+    const unsigned long currentTimeUS = micros();
+    const bool isJogRunning = ((sampleLeft.speed * direction) > 0) && ((sampleRight.speed * direction) > 0);
+    if (isJogRunning && (direction == lastJogDirection) && (speed == lastJogSpeed) && (currentTimeUS - lastJogUS < JOG_RENEW_INTERVAL_US))
+    {
+        return;
+    }
 
-    // Left
-    // Set last 4 bytes to position of right gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionRight;
-    sendCommand(data, DATA_LENGTH, true);
-    // Right
-    // Set last 4 bytes to position of left gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionLeft;
-    sendCommand(data, DATA_LENGTH, false);
+    GearboxProtocol::Command command{};
+    command.code = GearboxProtocol::CMD_JOG;
+    command.jogDirection = direction;
+    command.jogSpeed = speed;
+    command.leaseMS = JOG_LEASE_MS;
+    // A jog that did not fit into the queues is sent again by the next loop.
+    if (sendToBoth(command))
+    {
+        lastJogDirection = direction;
+        lastJogSpeed = speed;
+        lastJogUS = currentTimeUS;
+    }
 }
 
-void GearboxCommunication::fastenBrake()
+void GearboxCommunication::driveTo(const uint32_t position)
 {
-    constexpr size_t DATA_LENGTH{5u};
-    // Save last position such that both gearboxes get the position from roughly the same time.
-    const uint32_t lastPositionRight{positionRight};
-    const uint32_t lastPositionLeft{positionLeft};
+    GearboxProtocol::Command command{};
+    command.code = GearboxProtocol::CMD_MOVE_TO;
+    command.targetPosition = position;
+    sendToBoth(command);
+}
 
-    uint8_t data[DATA_LENGTH] = {0u};
-    // Set first byte to command code
-    data[0u] = CMD_FASTEN_BRAKE;
+void GearboxCommunication::driveSegment(const uint32_t position, const uint16_t speed)
+{
+    GearboxProtocol::Command command{};
+    command.code = GearboxProtocol::CMD_SEGMENT;
+    command.targetPosition = position;
+    command.segmentSpeed = speed;
+    command.startDelayUS = SEGMENT_START_DELAY_US;
+    // Only if both gearboxes estimate the clock of the controller, they would start apart otherwise. The broadcast is
+    // given up at its deadline, thus, every gearbox that gets it has it before the start.
+    command.isStartSynchronized = ((sampleLeft.flags & sampleRight.flags & GearboxProtocol::FLAG_CLOCK_SYNCHRONIZED) != 0u);
+    command.startUS = static_cast<uint32_t>(micros() + COMMAND_DEADLINE_US);
+    broadcast(command);
+}
 
-    // Left
-    // Set last 4 bytes to position of right gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionRight;
-    sendCommand(data, DATA_LENGTH, true);
-    // Right
-    // Set last 4 bytes to position of left gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionLeft;
-    sendCommand(data, DATA_LENGTH, false);
+void GearboxCommunication::emergencyStop()
+{
+#ifdef EMERGENCY_STOP_LINE
+    emergencyStopLine.pull();
+#endif
+    GearboxProtocol::Command command{};
+    command.code = GearboxProtocol::CMD_EMERGENCY_STOP;
+    // Addressed to each gearbox, a rejected broadcast would only reach them after its retries.
+    sendToBoth(command);
 }
 
-bool GearboxCommunication::toggleMotorControl(const bool enable)
+bool GearboxCommunication::takeEmergencyStopRequest()
 {
-    constexpr size_t DATA_LENGTH{6u};
-    // Save last position such that both gearboxes get the position from roughly the same time.
-    const uint32_t lastPositionRight{positionRight};
-    const uint32_t lastPositionLeft{positionLeft};
-    bool success{true};
+#ifdef EMERGENCY_STOP_LINE
+    return emergencyStopLine.takeTrigger();
+#else
+    return false;
+#endif
+}
 
-    uint8_t data[DATA_LENGTH] = {0u};
-    // Set first byte to command code
-    data[0u] = CMD_TOGGLE_MOTOR_CONTROL;
-    // Set second byte to enable/disable
-    data[5u] = enable ? 1u : 0u;
+void GearboxCommunication::getPosition()
+{
+    GearboxProtocol::Command command{};
+    command.code = GearboxProtocol::CMD_GET_POSITION;
+    sendToBoth(command);
+}
 
-    // Left
-    // Set last 4 bytes to position of right gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionRight;
-    success &= sendCommand(data, DATA_LENGTH, true);
-    // Right
-    // Set last 4 bytes to position of left gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionLeft;
-    success &= sendCommand(data, DATA_LENGTH, false);
+void GearboxCommunication::watchEvents()
+{
+#ifdef GEARBOX_ATTENTION_LINE
+    // A moving gearbox gets the position command as before, which ends its jog and passes the motion of the other
+    // gearbox on.
+    if ((sampleLeft.speed != 0) || (sampleRight.speed != 0))
+    {
+        getPosition();
+        return;
+    }
+    watchGearbox(true);
+    watchGearbox(false);
+#else
+    getPosition();
+#endif
+}
 
-    return success;
+void GearboxCommunication::watchGearbox(const bool isLeftGearbox)
+{
+    unsigned long &lastWatchUS = isLeftGearbox ? lastWatchLeftUS : lastWatchRightUS;
+    const bool isAttentionRaised = digitalRead(isLeftGearbox ? GEARBOX_LEFT_ATTENTION_PIN : GEARBOX_RIGHT_ATTENTION_PIN) == LOW;
+    const unsigned long currentTimeUS = micros();
+    // The line stays low till the read is done, thus, a gearbox with events is read once per loop.
+    if (isAttentionRaised || (currentTimeUS - lastWatchUS >= STATUS_KEEPALIVE_INTERVAL_US))
+    {
+        lastWatchUS = currentTimeUS;
+        requestStatus(isLeftGearbox);
+    }
 }
 
-bool GearboxCommunication::toggleMotorControlPower(const bool enable)
+void GearboxCommunication::loosenBrake()
 {
-    constexpr size_t DATA_LENGTH{6u};
-    // Save last position such that both gearboxes get the position from roughly the same time.
-    const uint32_t lastPositionRight{positionRight};
-    const uint32_t lastPositionLeft{positionLeft};
-    bool success{true};
+    GearboxProtocol::Command command{};
+    command.code = GearboxProtocol::CMD_LOOSEN_BRAKE;
+    sendToBoth(command);
+}
 
-    uint8_t data[DATA_LENGTH] = {0u};
-    // Set first byte to command code
-    data[0u] = CMD_TOGGLE_MOTOR_CONTROL_POWER;
-    // Set second byte to enable/disable
-    data[5u] = enable ? 1u : 0u;
+void GearboxCommunication::fastenBrake()
+{
+    GearboxProtocol::Command command{};
+    command.code = GearboxProtocol::CMD_FASTEN_BRAKE;
+    sendToBoth(command);
+}
 
-    // Left
-    // Set last 4 bytes to position of right gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionRight;
-    success &= sendCommand(data, DATA_LENGTH, true);
-    // Right
-    // Set last 4 bytes to position of left gearbox
-    *reinterpret_cast<uint32_t *>(&(data[1u])) = lastPositionLeft;
-    success &= sendCommand(data, DATA_LENGTH, false);
+bool GearboxCommunication::toggleMotorControl(const bool enable)
+{
+    GearboxProtocol::Command command{};
+    command.code = GearboxProtocol::CMD_TOGGLE_MOTOR_CONTROL;
+    command.isEnabled = enable;
+    return broadcast(command) && isLeftReachable && isRightReachable;
+}
 
-    return success;
-}
\ No newline at end of file
+bool GearboxCommunication::toggleMotorControlPower(const bool enable)
+{
+    GearboxProtocol::Command command{};
+    command.code = GearboxProtocol::CMD_TOGGLE_MOTOR_CONTROL_POWER;
+    command.isEnabled = enable;
+    return broadcast(command) && isLeftReachable && isRightReachable;
+}
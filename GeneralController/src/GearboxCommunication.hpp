@@ -2,32 +2,141 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include <GearboxProtocol.hpp>
+#include "I2cTransactionEngine.hpp"
+#include "Pinout.hpp"
+#ifdef EMERGENCY_STOP_LINE
+#include <EmergencyStopLine.hpp>
+#endif
 
 typedef uint8_t BrakeState;
 
 class GearboxCommunication
 {
+    friend class DeskSimulatorController;
+
 private:
-    static constexpr char CMD_MOVE_UP = 'u';
-    static constexpr char CMD_MOVE_DOWN = 'd';
-    static constexpr char CMD_MOVE_TO = 'm';
-    static constexpr char CMD_EMERGENCY_STOP = 'e';
-    static constexpr char CMD_GET_POSITION = 'p';
-    static constexpr char CMD_LOOSEN_BRAKE = 'l';
-    static constexpr char CMD_FASTEN_BRAKE = 'f';
-    static constexpr char CMD_TOGGLE_MOTOR_CONTROL = 'c';
-    static constexpr char CMD_TOGGLE_MOTOR_CONTROL_POWER = 't';
+    // A command that could not be sent within this time is dropped, the next loop sends a newer one anyway.
+    static constexpr unsigned long COMMAND_DEADLINE_US{8000u};
+    // Tag of a broadcast transaction, the ones of the gearboxes are 0 (left) and 1 (right).
+    static constexpr uint32_t BROADCAST_TAG{2u};
+    // Added to the broadcast tag for the transaction on the bus of the right gearbox.
+    static constexpr uint32_t RIGHT_BUS_TAG_FLAG{1u};
+    // Added to the tag of the gearbox for a time sync exchange.
+    static constexpr uint32_t TIME_SYNC_TAG_FLAG{4u};
+    // Each gearbox gets a time sync exchange at this interval while the desk rests, it estimates the clock of the
+    // controller from them.
+    static constexpr unsigned long TIME_SYNC_INTERVAL_US{200000u};
+    // The error counters of the buses are logged at this interval if they changed.
+    static constexpr unsigned long LINK_HEALTH_LOG_INTERVAL_US{10000000u};
+    // A gearbox keeps jogging this long after the last jog it got, thus, a few late or lost commands do not make the
+    // columns stutter, while a lost link still stops them.
+    static constexpr uint16_t JOG_LEASE_MS{100u};
+    // A jog in the same direction and at the same speed is only renewed after this time, well within its lease.
+    static constexpr unsigned long JOG_RENEW_INTERVAL_US{30000u};
+    // Time from the reception of a segment till the gearboxes start it, enough for both to plan their first step. Only
+    // used till both gearboxes synchronized their clock, afterwards they start at the time in the segment.
+    static constexpr uint16_t SEGMENT_START_DELAY_US{2000u};
+    // While broadcasts are not known to work, a resting desk probes them at this interval.
+    static constexpr unsigned long BROADCAST_PROBE_INTERVAL_US{1000000u};
+    // A resting gearbox is only read once it raised its attention line or after this time, which still tells whether it
+    // is reachable.
+    static constexpr unsigned long STATUS_KEEPALIVE_INTERVAL_US{1000000u};
+    // Clocks of a command and a status, each transfer with its address, every byte takes 9 clocks with the acknowledge.
+    static constexpr uint32_t EXCHANGE_CLOCKS{9u * (2u + GearboxProtocol::MAX_COMMAND_LENGTH + GearboxProtocol::STATUS_LENGTH)};
+
+    // Last status of a gearbox, see GearboxProtocol. Every command passes the position and speed on to the other
+    // gearbox, which extrapolates the position with the time of the sample.
+    struct GearboxSample
+    {
+        uint32_t position{0u};
+        int16_t speed{0}; // steps/s
+        unsigned long sampleTimeUS{0u};
+        uint8_t brakeState{BRAKE_STATE_LOCKED};
+        uint8_t flags{0u};
+        uint16_t skippedSteps{0u};
+        uint8_t acceptedSequence{0u};
+    };
 
     const uint8_t addressLeft{};
     const uint8_t addressRight{};
-    TwoWire *const i2c{};
-    uint32_t positionLeft{0u};
-    uint32_t positionRight{0u};
-    uint8_t brakeStateLeft{BRAKE_STATE_LOCKED};
-    uint8_t brakeStateRight{BRAKE_STATE_LOCKED};
+    I2cTransactionEngine busLeft;
+    // Only used if the right gearbox has a bus of its own, the transactions of both gearboxes run at the same time then.
+    // Otherwise, both gearboxes share the bus of the left one.
+    I2cTransactionEngine busRight;
+    const bool hasSeparateBuses{};
+    GearboxSample sampleLeft;
+    GearboxSample sampleRight;
+    // Sequence number of the last command. The gearbox echoes the one it accepted last and flags lost commands.
+    uint8_t sequence{0u};
+    // Whether the last transaction with the gearbox returned a valid status.
+    bool isLeftReachable{false};
+    bool isRightReachable{false};
+    // Commands are addressed to each gearbox till a probe broadcast was acknowledged on every bus, the I2C slave of a
+    // gearbox may not accept the general call at all. Once both gearboxes answer their own address but reject the
+    // general call, no more probes follow.
+    bool isBroadcastAcknowledgedLeft{false};
+    bool isBroadcastAcknowledgedRight{false};
+    bool isBroadcastRejected{false};
+    unsigned long lastBroadcastProbeUS{0u};
+    // Sent again to each gearbox if its broadcast was not acknowledged.
+    GearboxProtocol::Command lastBroadcast{};
+    bool isLastBroadcastResent{false};
+    // Times of the last time sync exchange with a gearbox on the clock of the controller, the next one hands them over.
+    struct TimeSyncExchange
+    {
+        uint8_t sequence{0u};
+        uint32_t writtenUS{0u};
+        uint32_t readUS{0u};
+        bool isWritten{false};
+        bool isComplete{false};
+    };
+    TimeSyncExchange timeSyncLeft;
+    TimeSyncExchange timeSyncRight;
+    unsigned long lastTimeSyncUS{0u};
+    // Direction and speed of the jog the gearboxes run and when it was sent last, the direction is zero once another
+    // command ended it.
+    int8_t lastJogDirection{0};
+    uint16_t lastJogSpeed{0u};
+    unsigned long lastJogUS{0u};
+    // Times of the last status request of watchEvents().
+    unsigned long lastWatchLeftUS{0u};
+    unsigned long lastWatchRightUS{0u};
+#ifdef EMERGENCY_STOP_LINE
+    // Pulled by emergencyStop(), the gearboxes stop in their ISR before the command arrives.
+    EmergencyStopLine emergencyStopLine{EMERGENCY_STOP_LINE_PIN};
+#endif
+    unsigned long lastLinkHealthLogUS{0u};
+    uint32_t lastLoggedErrorsLeft{0u};
+    uint32_t lastLoggedErrorsRight{0u};
 
-    bool sendCommand(uint8_t *data, const size_t dataLength, const bool isLeftGearbox);
-    void processResponse(const uint8_t *const response, const bool isLeftGearbox);
+    I2cTransactionEngine &busOf(const bool isLeftGearbox);
+    I2cTransactionEngine::Transaction createTransaction(const uint8_t address, const uint32_t tag);
+    // Queues the command, returns false if the bus queue is full. The status arrives with processReplies().
+    bool sendCommand(GearboxProtocol::Command &command, const bool isLeftGearbox);
+    // Sends the command to both gearboxes, each one gets the motion of the other one.
+    bool sendToBoth(GearboxProtocol::Command &command);
+    // Sends the command to both gearboxes in one transaction, such that both act on it at the same time, and reads
+    // their status afterwards. Uses sendToBoth() till a broadcast was acknowledged, and sends the command again to each
+    // gearbox if the broadcast is rejected.
+    bool broadcast(GearboxProtocol::Command &command);
+    // Broadcasts a position command, which a resting gearbox only answers, to find out whether the gearboxes
+    // acknowledge the general call.
+    bool probeBroadcast();
+    bool submitBroadcast(GearboxProtocol::Command &command);
+    bool isBroadcastSupported() const { return isBroadcastAcknowledgedLeft && (isBroadcastAcknowledgedRight || !hasSeparateBuses); }
+    bool requestStatus(const bool isLeftGearbox);
+    bool sendTimeSync(const bool isLeftGearbox);
+    void watchGearbox(const bool isLeftGearbox);
+    static void onReply(void *context, const I2cTransactionEngine::Transaction &transaction);
+    void processReply(const I2cTransactionEngine::Transaction &transaction);
+    void processBroadcastReply(const I2cTransactionEngine::Transaction &transaction);
+    void processTimeSyncReply(const I2cTransactionEngine::Transaction &transaction, const bool isLeftGearbox);
+    void logLinkHealth(const I2cTransactionEngine &bus, const bool isLeftBus, uint32_t &lastLoggedErrors);
+    void processResponse(const GearboxProtocol::Status &status, const bool isLeftGearbox, const unsigned long receivedUS);
+    static GearboxProtocol::Motion toMotion(const GearboxSample &sample);
+    // Position the gearbox had at the reference time, assuming it kept the speed of its sample.
+    static int32_t extrapolatePosition(const GearboxSample &sample, const unsigned long referenceUS);
 
 public:
     static constexpr BrakeState BRAKE_STATE_LOCKED = 0;
@@ -35,21 +144,54 @@ public:
     static constexpr BrakeState BRAKE_STATE_UNLOCKED = 3;
     static constexpr BrakeState BRAKE_STATE_ERROR = 2;
 
+    // Both gearboxes on one bus.
     GearboxCommunication(const uint8_t gearboxLeftAddress, const uint8_t gearboxRightAddress, TwoWire *i2c, const int i2cSdaPin, const int i2cSclPin, const uint32_t i2cFrequency);
+    // Each gearbox on a bus of its own, e.g. Wire and Wire1.
+    GearboxCommunication(const uint8_t gearboxLeftAddress, const uint8_t gearboxRightAddress, TwoWire *i2cLeft, const int i2cLeftSdaPin, const int i2cLeftSclPin, TwoWire *i2cRight, const int i2cRightSdaPin, const int i2cRightSclPin, const uint32_t i2cFrequency);
     ~GearboxCommunication() = default;
 
+    // Starts the tasks that talk to the gearboxes, the commands below only queue their transactions.
+    void startBusTask();
+    // Takes over the status replies of all finished transactions, returns their number. Called at the start of every loop.
+    size_t processReplies();
+    // Bus of the gearbox, e.g. for its clock and error counters.
+    const I2cTransactionEngine &getBus(const bool isLeftGearbox) const { return (isLeftGearbox || !hasSeparateBuses) ? busLeft : busRight; }
+    // Time the buses take at their current clock to send a command to each gearbox and read its status.
+    unsigned long getExchangeDurationUS() const;
+
+    // Jog at the max speed. A call renews the lease once a fraction of it has passed or the jog changed, in between it
+    // does not send anything. Any other command ends the jog.
     void driveUp();
     void driveDown();
+    void jog(const int8_t direction, const uint16_t speed);
     void driveTo(const uint32_t position);
+    // Broadcasts a move to the position at the speed (zero for the max speed), both gearboxes start it at the same
+    // time on the clock of the controller. They follow it on their own, getPosition() keeps them synchronized till the next command.
+    void driveSegment(const uint32_t position, const uint16_t speed);
     void emergencyStop();
+    // True once after a gearbox pulled the emergency stop line, which stopped both of them already.
+    bool takeEmergencyStopRequest();
     void getPosition();
+    // For states in which the desk rests: same as getPosition() while a gearbox moves, otherwise it only reads the
+    // status of a gearbox once it raised its attention line or after the keepalive interval. Without
+    // GEARBOX_ATTENTION_LINE, it is always getPosition().
+    void watchEvents();
     void loosenBrake();
     void fastenBrake();
+    // Return true if both gearboxes answered their last transaction.
     bool toggleMotorControl(const bool enable);
     bool toggleMotorControlPower(const bool enable);
 
-    uint32_t getPositionLeft() const { return positionLeft; };
-    uint32_t getPositionRight() const { return positionRight; };
-    uint8_t getBrakeStateLeft() const { return brakeStateLeft; };
-    uint8_t getBrakeStateRight() const { return brakeStateRight; };
+    uint32_t getPositionLeft() const { return sampleLeft.position; };
+    uint32_t getPositionRight() const { return sampleRight.position; };
+    int16_t getSpeedLeft() const { return sampleLeft.speed; };
+    int16_t getSpeedRight() const { return sampleRight.speed; };
+    // Whether the gearbox reported a segment that it waits for or follows, see GearboxProtocol::FLAG_SEGMENT_ACTIVE.
+    bool hasSegmentLeft() const { return (sampleLeft.flags & GearboxProtocol::FLAG_SEGMENT_ACTIVE) != 0u; };
+    bool hasSegmentRight() const { return (sampleRight.flags & GearboxProtocol::FLAG_SEGMENT_ACTIVE) != 0u; };
+    // Height difference of the left to the right gearbox. The gearboxes are not polled at the same time, thus, both
+    // positions are extrapolated to the later of their sample times.
+    int32_t getDeviation() const;
+    uint8_t getBrakeStateLeft() const { return sampleLeft.brakeState; };
+    uint8_t getBrakeStateRight() const { return sampleRight.brakeState; };
 };
\ No newline at end of file
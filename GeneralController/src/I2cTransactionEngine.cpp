@@ -0,0 +1,243 @@
+#include "I2cTransactionEngine.hpp"
+#include "LogMessages.hpp"
+#include <DeferredLog.hpp>
+
+I2cTransactionEngine::I2cTransactionEngine(TwoWire *i2c, const int sdaPin, const int sclPin, const uint32_t maxFrequency) : i2c(i2c), sdaPin(sdaPin), sclPin(sclPin), maxFrequency(maxFrequency), frequency(maxFrequency)
+{
+}
+
+bool I2cTransactionEngine::begin()
+{
+    const bool isStarted = i2c->begin(sdaPin, sclPin, frequency.load());
+    i2c->setTimeOut(TRANSFER_TIMEOUT_MS);
+    return isStarted;
+}
+
+void I2cTransactionEngine::startTask()
+{
+    xTaskCreatePinnedToCore(
+        [](void *param)
+        {
+            static_cast<I2cTransactionEngine *>(param)->runTask();
+        },
+        "I2cTransactionTask", // Task name
+        4096,                 // Stack size (bytes)
+        this,                 // Parameter
+        4,                    // Task priority, above the control task such that queued transactions start right away
+        &taskHandle,          // Task handle
+        1);                   // Core where the task should run
+}
+
+void I2cTransactionEngine::runTask()
+{
+    while (true)
+    {
+        // The driver blocks this task while the bytes are on the wire, the loop keeps running meanwhile.
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        processQueue();
+    }
+}
+
+bool I2cTransactionEngine::submit(const Transaction &transaction)
+{
+    if (!pending.push(transaction))
+    {
+        return false;
+    }
+    if (taskHandle != nullptr)
+    {
+        xTaskNotifyGive(taskHandle);
+    }
+    return true;
+}
+
+void I2cTransactionEngine::processQueue()
+{
+    Transaction transaction{};
+    while (pending.pop(transaction))
+    {
+        execute(transaction);
+        if (transaction.result != Result::Ok)
+        {
+            failedTransactions++;
+        }
+        adaptFrequency(transaction.result);
+        if (!completed.push(transaction))
+        {
+            droppedCompletions++;
+        }
+    }
+}
+
+size_t I2cTransactionEngine::dispatchCompletions()
+{
+    size_t count{0u};
+    Transaction transaction{};
+    while (completed.pop(transaction))
+    {
+        if (transaction.callback != nullptr)
+        {
+            transaction.callback(transaction.context, transaction);
+        }
+        count++;
+    }
+    return count;
+}
+
+void I2cTransactionEngine::execute(Transaction &transaction)
+{
+    transaction.attempts = 0u;
+    // A written command is not repeated if only its read fails, the slave would execute it twice.
+    bool isWritten{transaction.writeLength == 0u};
+
+    while (true)
+    {
+        if (static_cast<long>(micros() - transaction.deadlineUS) >= 0)
+        {
+            transaction.result = Result::Expired;
+            return;
+        }
+
+        transaction.attempts++;
+        transaction.result = isWritten ? Result::Ok : write(transaction);
+        if (transaction.result == Result::Ok)
+        {
+            isWritten = true;
+            transaction.completedUS = micros();
+            transaction.writtenUS = transaction.completedUS;
+            if (transaction.readLength > 0u)
+            {
+                transaction.result = read(transaction);
+            }
+        }
+
+        if (transaction.result == Result::Ok)
+        {
+            return;
+        }
+        if (transaction.result == Result::Nack)
+        {
+            nacks++;
+        }
+        if (transaction.result == Result::BusError)
+        {
+            timeouts++;
+            recoverBus();
+        }
+        if (transaction.attempts >= MAX_ATTEMPTS)
+        {
+            return;
+        }
+        retries++;
+    }
+}
+
+I2cTransactionEngine::Result I2cTransactionEngine::write(const Transaction &transaction)
+{
+    i2c->beginTransmission(transaction.address);
+    i2c->write(transaction.writeData, transaction.writeLength);
+    switch (i2c->endTransmission())
+    {
+    case 0u:
+        return Result::Ok;
+    case 2u: // NACK on the address
+    case 3u: // NACK on a data byte
+        return Result::Nack;
+    default: // Data too long, timeout or other errors
+        return Result::BusError;
+    }
+}
+
+I2cTransactionEngine::Result I2cTransactionEngine::read(Transaction &transaction)
+{
+    const size_t readCount = i2c->requestFrom(transaction.address, transaction.readLength);
+    size_t bytesRead{0u};
+    while ((bytesRead < readCount) && (i2c->available() > 0))
+    {
+        transaction.readData[bytesRead++] = static_cast<uint8_t>(i2c->read());
+    }
+    transaction.completedUS = micros();
+
+    if (readCount == 0u)
+    {
+        // The driver reports timeouts of a read only this way.
+        return Result::BusError;
+    }
+    return bytesRead == transaction.readLength ? Result::Ok : Result::ShortRead;
+}
+
+void I2cTransactionEngine::adaptFrequency(const Result result)
+{
+    if (result == Result::Expired)
+    {
+        // Says nothing about the bus, the transaction waited too long in the queue.
+        return;
+    }
+
+    if (result != Result::Ok)
+    {
+        consecutiveSuccesses = 0u;
+        consecutiveFailures++;
+        if ((consecutiveFailures < FALLBACK_FAILURES) || (frequency.load() <= STANDARD_MODE_HZ))
+        {
+            return;
+        }
+        if (isTryingFrequency)
+        {
+            raiseSuccesses = (raiseSuccesses < MAX_RAISE_SUCCESSES / 2u) ? 2u * raiseSuccesses : MAX_RAISE_SUCCESSES;
+        }
+        isTryingFrequency = false;
+        consecutiveFailures = 0u;
+        frequencyFallbacks++;
+        setFrequency(frequency.load() > FAST_MODE_HZ ? FAST_MODE_HZ : STANDARD_MODE_HZ);
+        return;
+    }
+
+    consecutiveFailures = 0u;
+    consecutiveSuccesses++;
+    if (consecutiveSuccesses < raiseSuccesses)
+    {
+        return;
+    }
+    consecutiveSuccesses = 0u;
+    isTryingFrequency = frequency.load() < maxFrequency;
+    if (isTryingFrequency)
+    {
+        const uint32_t fasterFrequency = (frequency.load() < FAST_MODE_HZ) ? FAST_MODE_HZ : FAST_MODE_PLUS_HZ;
+        setFrequency(fasterFrequency < maxFrequency ? fasterFrequency : maxFrequency);
+    }
+}
+
+void I2cTransactionEngine::setFrequency(const uint32_t newFrequency)
+{
+    DeferredLog::write(ControllerLog::I2C_FREQUENCY_CHANGED, frequency.load() / 1000u, newFrequency / 1000u);
+    frequency = newFrequency;
+    i2c->setClock(newFrequency);
+}
+
+void I2cTransactionEngine::recoverBus()
+{
+    i2c->end();
+
+    pinMode(sdaPin, INPUT_PULLUP);
+    pinMode(sclPin, OUTPUT_OPEN_DRAIN);
+    digitalWrite(sclPin, HIGH);
+    for (uint8_t i = 0u; (i < RECOVERY_CLOCKS) && (digitalRead(sdaPin) == LOW); i++)
+    {
+        digitalWrite(sclPin, LOW);
+        delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+        digitalWrite(sclPin, HIGH);
+        delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+    }
+
+    // Stop condition: SDA rises while SCL is high.
+    pinMode(sdaPin, OUTPUT_OPEN_DRAIN);
+    digitalWrite(sdaPin, LOW);
+    delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+    digitalWrite(sdaPin, HIGH);
+    delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+
+    begin();
+    busRecoveries++;
+    DeferredLog::write(ControllerLog::I2C_BUS_RECOVERED, busRecoveries.load());
+}
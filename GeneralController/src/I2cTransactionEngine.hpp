@@ -0,0 +1,136 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <atomic>
+#include <SpscRing.hpp>
+
+// Runs I2C transactions, a write followed by a read, each of them optional, in a task of its own. The control loop only queues them
+// and collects the finished ones, thus, it keeps running while the bytes are on the wire and a slave that stops
+// answering costs it nothing but the failed transactions. The clock starts at the given frequency and drops to the next
+// slower I2C mode while transactions keep failing, a faster one is tried again after a run of successful transactions.
+class I2cTransactionEngine
+{
+public:
+    static constexpr size_t MAX_WRITE_LENGTH{40u};
+    static constexpr size_t MAX_READ_LENGTH{32u};
+
+    enum class Result : uint8_t
+    {
+        Ok,
+        // The slave did not acknowledge its address or a byte.
+        Nack,
+        // Timeout or arbitration loss, the bus is recovered afterwards.
+        BusError,
+        ShortRead,
+        // The deadline passed before the transaction succeeded.
+        Expired,
+    };
+
+    struct Transaction;
+    // Called by the control loop, see dispatchCompletions().
+    using CompletionCallback = void (*)(void *context, const Transaction &transaction);
+
+    struct Transaction
+    {
+        uint8_t address;
+        uint8_t writeData[MAX_WRITE_LENGTH];
+        size_t writeLength;
+        uint8_t readData[MAX_READ_LENGTH];
+        size_t readLength;
+        // The transaction is given up once micros() passes the deadline, retries included.
+        unsigned long deadlineUS;
+        CompletionCallback callback;
+        void *context;
+        // Free for the caller, e.g. to tell which slave a completion belongs to.
+        uint32_t tag;
+
+        // Filled by the engine.
+        Result result;
+        uint8_t attempts;
+        // Time at which the read, respectively the write, finished.
+        unsigned long completedUS;
+        // Time at which the write finished, e.g. for the time sync with a slave.
+        unsigned long writtenUS;
+    };
+
+private:
+    static constexpr size_t QUEUE_CAPACITY{8u};
+    static constexpr uint8_t MAX_ATTEMPTS{3u};
+    // Timeout of a single transfer, the ESP32 default of 50 ms is longer than the loop of the controller.
+    static constexpr uint16_t TRANSFER_TIMEOUT_MS{5u};
+    // A slave that holds SDA low in the middle of a byte releases it after at most nine clocks.
+    static constexpr uint8_t RECOVERY_CLOCKS{9u};
+    static constexpr uint32_t RECOVERY_HALF_PERIOD_US{5u};
+
+    static constexpr uint32_t STANDARD_MODE_HZ{100000u};
+    static constexpr uint32_t FAST_MODE_HZ{400000u};
+    static constexpr uint32_t FAST_MODE_PLUS_HZ{1000000u};
+    // Consecutive failed transactions, each with all its attempts, after which the clock drops one mode.
+    static constexpr uint8_t FALLBACK_FAILURES{2u};
+    // Consecutive successful transactions after which the next faster mode is tried. Doubled whenever a tried mode
+    // fails again, such that a marginal bus does not keep switching.
+    static constexpr uint32_t RAISE_SUCCESSES{1000u};
+    static constexpr uint32_t MAX_RAISE_SUCCESSES{64000u};
+
+    TwoWire *const i2c{};
+    const int sdaPin{};
+    const int sclPin{};
+    const uint32_t maxFrequency{};
+    std::atomic<uint32_t> frequency{0u};
+    TaskHandle_t taskHandle{nullptr};
+    // Only used by the task.
+    uint8_t consecutiveFailures{0u};
+    uint32_t consecutiveSuccesses{0u};
+    uint32_t raiseSuccesses{RAISE_SUCCESSES};
+    // Whether the current mode was only tried and has not yet run RAISE_SUCCESSES transactions.
+    bool isTryingFrequency{false};
+
+    SpscRing<Transaction, QUEUE_CAPACITY> pending;
+    SpscRing<Transaction, QUEUE_CAPACITY> completed;
+
+    std::atomic<uint32_t> retries{0u};
+    std::atomic<uint32_t> nacks{0u};
+    std::atomic<uint32_t> timeouts{0u};
+    std::atomic<uint32_t> frequencyFallbacks{0u};
+    std::atomic<uint32_t> busRecoveries{0u};
+    std::atomic<uint32_t> failedTransactions{0u};
+    // Completions that did not fit into the queue, their callbacks are never called.
+    std::atomic<uint32_t> droppedCompletions{0u};
+
+    void execute(Transaction &transaction);
+    Result write(const Transaction &transaction);
+    Result read(Transaction &transaction);
+    // Clocks SCL till the slaves release SDA, sends a stop condition and restarts the driver.
+    void recoverBus();
+    // Picks the clock for the next transactions from the outcome of the last one.
+    void adaptFrequency(const Result result);
+    void setFrequency(const uint32_t newFrequency);
+    void runTask();
+
+public:
+    // The frequency is the fastest clock the bus may run at, e.g. 1 MHz for Fast-mode Plus.
+    I2cTransactionEngine(TwoWire *i2c, const int sdaPin, const int sclPin, const uint32_t maxFrequency);
+    ~I2cTransactionEngine() = default;
+
+    bool begin();
+    // Starts the task that runs the transactions. Without it, processQueue() has to be called instead.
+    void startTask();
+
+    // Queues the transaction, returns false if the queue is full. Only called by the control loop.
+    bool submit(const Transaction &transaction);
+    // Runs all queued transactions, the body of the task.
+    void processQueue();
+    // Calls the callbacks of all finished transactions, returns their number. Only called by the control loop.
+    size_t dispatchCompletions();
+
+    uint32_t getFrequency() const { return frequency.load(); }
+    uint32_t getRetries() const { return retries.load(); }
+    // Failed attempts, a transaction may count several times.
+    uint32_t getNacks() const { return nacks.load(); }
+    uint32_t getTimeouts() const { return timeouts.load(); }
+    uint32_t getFrequencyFallbacks() const { return frequencyFallbacks.load(); }
+    uint32_t getBusRecoveries() const { return busRecoveries.load(); }
+    uint32_t getFailedTransactions() const { return failedTransactions.load(); }
+    uint32_t getDroppedCompletions() const { return droppedCompletions.load(); }
+};
@@ -1,7 +1,9 @@
 #include "InputController.hpp"
 #include "Pinout.hpp"
+#include "LogMessages.hpp"
+#include <DeferredLog.hpp>
 
-InputController::InputController(GearboxCommunication *const gearbox, std::queue<InputEvent *> *const eventQueue) : gearbox(gearbox), eventQueue(eventQueue)
+InputController::InputController(GearboxCommunication *const gearbox, InputEventQueue *const eventQueue) : gearbox(gearbox), eventQueue(eventQueue)
 {
     pinMode(RELAY_24V_PIN, OUTPUT);
     pinMode(GEARBOX_POWER_RELAY_PIN, OUTPUT);
@@ -17,10 +19,7 @@ void InputController::update()
 
     if (lastPosLeft != gearbox->getPositionLeft() || lastPosRight != gearbox->getPositionRight())
     {
-        Serial.print("Gearbox position left: ");
-        Serial.print(gearbox->getPositionLeft());
-        Serial.print(" right: ");
-        Serial.println(gearbox->getPositionRight());
+        DeferredLog::write(ControllerLog::GEARBOX_POSITION, gearbox->getPositionLeft(), gearbox->getPositionRight());
 
         lastPosLeft = gearbox->getPositionLeft();
         lastPosRight = gearbox->getPositionRight();
@@ -29,28 +28,7 @@ void InputController::update()
     static UiState lastUiState = UiState::MoveDown;
     if (lastUiState != uiState)
     {
-        Serial.print("UI State: ");
-        switch (uiState)
-        {
-        case UiState::Idle:
-            Serial.println("Idle");
-            break;
-        case UiState::DriveControl:
-            Serial.println("DriveControl");
-            break;
-        case UiState::MoveUp:
-            Serial.println("MoveUp");
-            break;
-        case UiState::MoveDown:
-            Serial.println("MoveDown");
-            break;
-        case UiState::MoveTo:
-            Serial.println("MoveTo");
-            break;
-        default:
-            Serial.println("Unknown");
-            break;
-        }
+        DeferredLog::write(ControllerLog::UI_STATE, uiState);
 
         lastUiState = uiState;
     }
@@ -58,34 +36,7 @@ void InputController::update()
     static GearboxState lastGearboxState = GearboxState::LockingBrakes;
     if (lastGearboxState != gearboxState)
     {
-        Serial.print("Gearbox State: ");
-        switch (gearboxState)
-        {
-        case GearboxState::OnBrake:
-            Serial.println("OnBrake");
-            break;
-        case GearboxState::LockingBrakes:
-            Serial.println("LockingBrakes");
-            break;
-        case GearboxState::UnlockingBrakes:
-            Serial.println("UnlockingBrakes");
-            break;
-        case GearboxState::Stop:
-            Serial.println("Stop");
-            break;
-        case GearboxState::DriveMode:
-            Serial.println("DriveMode");
-            break;
-        case GearboxState::EmergencyStop:
-            Serial.println("EmergencyStop");
-            break;
-        case GearboxState::EmergencyStopRecovery:
-            Serial.println("EmergencyStopRecovery");
-            break;
-        default:
-            Serial.println("Unknown");
-            break;
-        }
+        DeferredLog::write(ControllerLog::GEARBOX_STATE, gearboxState);
 
         lastGearboxState = gearboxState;
     }
@@ -93,28 +44,7 @@ void InputController::update()
     static BrakeState lastBrakeStateLeft = 255;
     if (lastBrakeStateLeft != gearbox->getBrakeStateLeft())
     {
-        Serial.print("Brake State Left: ");
-        Serial.print(static_cast<uint32_t>(gearbox->getBrakeStateLeft()));
-        Serial.print(" ");
-        // Print name of brake state
-        switch (gearbox->getBrakeStateLeft())
-        {
-        case GearboxCommunication::BRAKE_STATE_UNLOCKED:
-            Serial.println("BRAKE_STATE_UNLOCKED");
-            break;
-        case GearboxCommunication::BRAKE_STATE_LOCKED:
-            Serial.println("BRAKE_STATE_LOCKED");
-            break;
-        case GearboxCommunication::BRAKE_STATE_INTERMEDIARY:
-            Serial.println("BRAKE_STATE_INTERMEDIARY");
-            break;
-        case GearboxCommunication::BRAKE_STATE_ERROR:
-            Serial.println("BRAKE_STATE_ERROR");
-            break;
-        default:
-            Serial.println("Unknown");
-            break;
-        }
+        DeferredLog::write(ControllerLog::BRAKE_STATE_LEFT, gearbox->getBrakeStateLeft(), gearbox->getBrakeStateLeft());
 
         lastBrakeStateLeft = gearbox->getBrakeStateLeft();
     }
@@ -122,26 +52,7 @@ void InputController::update()
     static BrakeState lastBrakeStateRight = 255;
     if (lastBrakeStateRight != gearbox->getBrakeStateRight())
     {
-        Serial.print("Brake State Right: ");
-        // Print name of brake state
-        switch (gearbox->getBrakeStateRight())
-        {
-        case GearboxCommunication::BRAKE_STATE_UNLOCKED:
-            Serial.println("BRAKE_STATE_UNLOCKED");
-            break;
-        case GearboxCommunication::BRAKE_STATE_LOCKED:
-            Serial.println("BRAKE_STATE_LOCKED");
-            break;
-        case GearboxCommunication::BRAKE_STATE_INTERMEDIARY:
-            Serial.println("BRAKE_STATE_INTERMEDIARY");
-            break;
-        case GearboxCommunication::BRAKE_STATE_ERROR:
-            Serial.println("BRAKE_STATE_ERROR");
-            break;
-        default:
-            Serial.println("Unknown");
-            break;
-        }
+        DeferredLog::write(ControllerLog::BRAKE_STATE_RIGHT, gearbox->getBrakeStateRight());
 
         lastBrakeStateRight = gearbox->getBrakeStateRight();
     }
@@ -154,64 +65,10 @@ void InputController::update()
 void InputController::updateUiStateMachine()
 {
     // Process all input events in UI State Machine.
-    while (!eventQueue->empty())
+    InputEvent event{};
+    while (eventQueue->pop(event))
     {
-        InputEvent *const event = eventQueue->front();
-
-        // Print Event.
-        Serial.print("Button: ");
-        // Print name of button
-        switch (event->buttonId)
-        {
-        case ButtonEvents::ID_MAIN:
-            Serial.print("Main");
-            break;
-        case ButtonEvents::ID_MOVE_UP:
-            Serial.print("Up");
-            break;
-        case ButtonEvents::ID_MOVE_DOWN:
-            Serial.print("Down");
-            break;
-        case ButtonEvents::ID_SHORTCUT_1:
-            Serial.print("Shortcut 1");
-            break;
-        case ButtonEvents::ID_SHORTCUT_2:
-            Serial.print("Shortcut 2");
-            break;
-        default:
-            Serial.print("Unknown");
-            break;
-        }
-
-        Serial.print(", Event: ");
-        // Print name of event
-        switch (event->buttonEvent)
-        {
-        case ButtonEvents::BUTTON_PRESSED:
-            Serial.println("BUTTON_PRESSED");
-            break;
-        case ButtonEvents::BUTTON_RELEASED:
-            Serial.println("BUTTON_RELEASED");
-            break;
-        case ButtonEvents::LONG_CLICK:
-            Serial.println("LONG_CLICK");
-            break;
-        case ButtonEvents::DOUBLE_CLICK:
-            Serial.println("DOUBLE_CLICK");
-            break;
-        case ButtonEvents::SINGLE_CLICK:
-            Serial.println("SINGLE_CLICK");
-            break;
-        case ButtonEvents::START_DOUBLE_HOLD_CLICK:
-            Serial.println("START_DOUBLE_HOLD_CLICK");
-            break;
-        case ButtonEvents::END_DOUBLE_HOLD_CLICK:
-            Serial.println("END_DOUBLE_HOLD_CLICK");
-            break;
-        default:
-            Serial.println("Unknown");
-            break;
-        }
+        DeferredLog::write(ControllerLog::BUTTON_EVENT, event.buttonId, event.buttonEvent);
 
         switch (uiState)
         {
@@ -231,23 +88,32 @@ void InputController::updateUiStateMachine()
             moveTo(event);
             break;
         }
+    }
 
-        eventQueue->pop();
-        delete event;
+    // Events that did not fit into the queue are lost, e.g. while the control task was blocked.
+    const uint32_t eventOverflows = eventQueue->getOverflows();
+    if (eventOverflows != lastLoggedEventOverflows)
+    {
+        DeferredLog::write(ControllerLog::INPUT_EVENTS_DROPPED, eventOverflows);
+        lastLoggedEventOverflows = eventOverflows;
     }
 }
 
 void InputController::updateGearboxStateMachine()
 {
+    // A gearbox that pulled the emergency stop line stopped both columns already.
+    const bool isEmergencyStopLinePulled = gearbox->takeEmergencyStopRequest();
     // We do not want to enter the emergency stop again if we are currently in the emergency stop recovery state (It is to be expected that the gearbox deviation is too large in this state).
     if (gearboxState != GearboxState::EmergencyStopRecovery)
     {
         // Check for conditions of emergency stop.
-        // Calculate diff between position of gearboxes.
-        const uint32_t gearboxLeftPosition = gearbox->getPositionLeft();
-        const uint32_t gearboxRightPosition = gearbox->getPositionRight();
-        const int32_t diff = static_cast<int32_t>(gearboxLeftPosition) - static_cast<int32_t>(gearboxRightPosition);
-        if (abs(diff) > MAX_GEARBOX_DEVIATION)
+        // Calculate diff between position of gearboxes at the same point in time.
+        const int32_t diff = gearbox->getDeviation();
+        if (isEmergencyStopLinePulled)
+        {
+            DeferredLog::write(ControllerLog::EMERGENCY_STOP_LINE_PULLED);
+        }
+        if ((abs(diff) > MAX_GEARBOX_DEVIATION) || isEmergencyStopLinePulled)
         {
             gearboxState = GearboxState::EmergencyStop;
         }
@@ -312,37 +178,51 @@ void InputController::updateGearboxStateMachine()
     }
 }
 
+unsigned long InputController::getLoopIntervalUS() const
+{
+    switch (gearboxState)
+    {
+    case GearboxState::DriveMode:
+    case GearboxState::EmergencyStopRecovery:
+        return max(DRIVE_LOOP_INTERVAL_US, gearbox->getExchangeDurationUS());
+    case GearboxState::OnBrake:
+        return RESTING_LOOP_INTERVAL_US;
+    default:
+        return LOOP_INTERVAL_US;
+    }
+}
+
 bool InputController::isInMovingUiState()
 {
     return (uiState == UiState::MoveUp || uiState == UiState::MoveDown || uiState == UiState::MoveTo || uiState == UiState::DriveControl);
 }
 
 #pragma region UI Methods
-void InputController::uiIdle(InputEvent *const event)
+void InputController::uiIdle(const InputEvent &event)
 {
-    if (event->buttonId == ButtonEvents::ID_MAIN && event->buttonEvent == ButtonEvents::SINGLE_CLICK)
+    if (event.buttonId == ButtonEvents::ID_MAIN && event.buttonEvent == ButtonEvents::SINGLE_CLICK)
     {
         // Main button clicked -> Drive control mode.
         uiState = UiState::DriveControl;
     }
 }
 
-void InputController::uiDriveControl(InputEvent *const event)
+void InputController::uiDriveControl(const InputEvent &event)
 {
-    if (event->buttonId == ButtonEvents::ID_MAIN && event->buttonEvent == ButtonEvents::SINGLE_CLICK)
+    if (event.buttonId == ButtonEvents::ID_MAIN && event.buttonEvent == ButtonEvents::SINGLE_CLICK)
     {
         // Main button clicked -> Back to idle mode.
         uiState = UiState::Idle;
         return;
     }
-    const bool moveUp = event->buttonId == ButtonEvents::ID_MOVE_UP && event->buttonEvent == ButtonEvents::BUTTON_PRESSED;
+    const bool moveUp = event.buttonId == ButtonEvents::ID_MOVE_UP && event.buttonEvent == ButtonEvents::BUTTON_PRESSED;
     if (moveUp)
     {
         // Move up.
         uiState = UiState::MoveUp;
         return;
     }
-    const bool moveDown = event->buttonId == ButtonEvents::ID_MOVE_DOWN && event->buttonEvent == ButtonEvents::BUTTON_PRESSED;
+    const bool moveDown = event.buttonId == ButtonEvents::ID_MOVE_DOWN && event.buttonEvent == ButtonEvents::BUTTON_PRESSED;
     if (moveDown)
     {
         // Move down.
@@ -350,7 +230,7 @@ void InputController::uiDriveControl(InputEvent *const event)
         return;
     }
 
-    if (event->buttonId == ButtonEvents::ID_SHORTCUT_2 && event->buttonEvent == ButtonEvents::SINGLE_CLICK)
+    if (event.buttonId == ButtonEvents::ID_SHORTCUT_2 && event.buttonEvent == ButtonEvents::SINGLE_CLICK)
     {
         // Shortcut 2 clicked -> Move to.
         uiState = UiState::MoveTo;
@@ -358,23 +238,23 @@ void InputController::uiDriveControl(InputEvent *const event)
     }
 }
 
-void InputController::moveUp(InputEvent *const event)
+void InputController::moveUp(const InputEvent &event)
 {
-    if (event->buttonId == ButtonEvents::ID_MAIN && event->buttonEvent == ButtonEvents::SINGLE_CLICK)
+    if (event.buttonId == ButtonEvents::ID_MAIN && event.buttonEvent == ButtonEvents::SINGLE_CLICK)
     {
         // Main button clicked -> Back to idle mode.
         uiState = UiState::Idle;
         return;
     }
 
-    if (event->buttonId == ButtonEvents::ID_MOVE_UP && event->buttonEvent == ButtonEvents::BUTTON_RELEASED)
+    if (event.buttonId == ButtonEvents::ID_MOVE_UP && event.buttonEvent == ButtonEvents::BUTTON_RELEASED)
     {
         // Move up button released -> Don't move.
         uiState = UiState::DriveControl;
         return;
     }
 
-    if (event->buttonId == ButtonEvents::ID_MOVE_DOWN && event->buttonEvent == ButtonEvents::BUTTON_PRESSED)
+    if (event.buttonId == ButtonEvents::ID_MOVE_DOWN && event.buttonEvent == ButtonEvents::BUTTON_PRESSED)
     {
         // Move down button pressed -> Don't move.
         uiState = UiState::DriveControl;
@@ -382,23 +262,23 @@ void InputController::moveUp(InputEvent *const event)
     }
 }
 
-void InputController::moveDown(InputEvent *const event)
+void InputController::moveDown(const InputEvent &event)
 {
-    if (event->buttonId == ButtonEvents::ID_MAIN && event->buttonEvent == ButtonEvents::SINGLE_CLICK)
+    if (event.buttonId == ButtonEvents::ID_MAIN && event.buttonEvent == ButtonEvents::SINGLE_CLICK)
     {
         // Main button clicked -> Back to idle mode.
         uiState = UiState::Idle;
         return;
     }
 
-    if (event->buttonId == ButtonEvents::ID_MOVE_DOWN && event->buttonEvent == ButtonEvents::BUTTON_RELEASED)
+    if (event.buttonId == ButtonEvents::ID_MOVE_DOWN && event.buttonEvent == ButtonEvents::BUTTON_RELEASED)
     {
         // Move down button released -> Don't move.
         uiState = UiState::DriveControl;
         return;
     }
 
-    if (event->buttonId == ButtonEvents::ID_MOVE_UP && event->buttonEvent == ButtonEvents::BUTTON_PRESSED)
+    if (event.buttonId == ButtonEvents::ID_MOVE_UP && event.buttonEvent == ButtonEvents::BUTTON_PRESSED)
     {
         // Move up button pressed -> Don't move.
         uiState = UiState::DriveControl;
@@ -406,9 +286,9 @@ void InputController::moveDown(InputEvent *const event)
     }
 }
 
-void InputController::moveTo(InputEvent *const event)
+void InputController::moveTo(const InputEvent &event)
 {
-    if (event->buttonId == ButtonEvents::ID_MAIN && event->buttonEvent == ButtonEvents::SINGLE_CLICK)
+    if (event.buttonId == ButtonEvents::ID_MAIN && event.buttonEvent == ButtonEvents::SINGLE_CLICK)
     {
         // Main button clicked -> Back to idle mode.
         uiState = UiState::Idle;
@@ -449,31 +329,7 @@ void InputController::checkTransitionUnlockingBrakes()
 
     if (lastUnlockingBrakeState != unlockingBrakeState)
     {
-        Serial.print("UnlockingBrakeState: ");
-        switch (unlockingBrakeState)
-        {
-        case UnlockingBrakeState::SwitchOnGearboxPower:
-            Serial.println("SwitchOnGearboxPower");
-            break;
-        case UnlockingBrakeState::SwitchOnMotorPowerSupply:
-            Serial.println("SwitchOnMotorPowerSupply");
-            break;
-        case UnlockingBrakeState::SwitchOnMotorControlPower:
-            Serial.println("SwitchOnMotorControlPower");
-            break;
-        case UnlockingBrakeState::SwitchOnMotorControl:
-            Serial.println("SwitchOnMotorControl");
-            break;
-        case UnlockingBrakeState::UnlockBrakes:
-            Serial.println("UnlockBrakes");
-            break;
-        case UnlockingBrakeState::UnlockDriveUp:
-            Serial.println("UnlockDriveUp");
-            break;
-        default:
-            Serial.println("Unknown");
-            break;
-        }
+        DeferredLog::write(ControllerLog::UNLOCKING_BRAKE_STATE, unlockingBrakeState);
         lastUnlockingBrakeState = unlockingBrakeState;
     }
     // Check state transition for sub state machine.
@@ -632,28 +488,7 @@ void InputController::checkTransitionLockingBrakes()
 
     if (lastLockingBrakeState != lockingBrakeState)
     {
-        Serial.print("LockingBrakeState: ");
-        switch (lockingBrakeState)
-        {
-        case LockingBrakeState::LockBrakes:
-            Serial.println("LockBrakes");
-            break;
-        case LockingBrakeState::SwitchOffMotorControl:
-            Serial.println("SwitchOffMotorControl");
-            break;
-        case LockingBrakeState::SwitchOffMotorControlPower:
-            Serial.println("SwitchOffMotorControlPower");
-            break;
-        case LockingBrakeState::SwitchOffMotorPowerSupply:
-            Serial.println("SwitchOffMotorPowerSupply");
-            break;
-        case LockingBrakeState::SwitchOffGearboxPower:
-            Serial.println("SwitchOffGearboxPower");
-            break;
-        default:
-            Serial.println("Unknown");
-            break;
-        }
+        DeferredLog::write(ControllerLog::LOCKING_BRAKE_STATE, lockingBrakeState);
         lastLockingBrakeState = lockingBrakeState;
     }
 
@@ -802,7 +637,7 @@ void InputController::checkTransitionEmergencyStopRecovery()
 void InputController::performOnBrake()
 {
     // Nothing to do, this state just waits for any events.
-    gearbox->getPosition();
+    gearbox->watchEvents();
 }
 
 void InputController::performLockingBrakes()
@@ -863,12 +698,16 @@ void InputController::performUnlockingBrakes()
 void InputController::performStop()
 {
     // We do nothing in this state, we wait for the gearboxes to stop, they will not get any new commands.
-    gearbox->getPosition();
+    gearbox->watchEvents();
 }
 
 void InputController::performDriveMode()
 {
     // Depending on the UI State we either drive up, down, to or not at all.
+    if (uiState != UiState::MoveTo)
+    {
+        isSegmentSent = false;
+    }
     switch (uiState)
     {
     case UiState::MoveUp:
@@ -878,14 +717,44 @@ void InputController::performDriveMode()
         gearbox->driveDown();
         break;
     case UiState::MoveTo:
-        gearbox->driveTo(40000u);
+        performMoveTo();
         break;
     default:
-        gearbox->getPosition();
+        gearbox->watchEvents();
         break;
     }
 }
 
+void InputController::performMoveTo()
+{
+    // Both gearboxes get the segment once and start it at the same time, afterwards, they are only polled. A gearbox
+    // that reports no segment away from the target, e.g. because it missed it, gets it again. One that waits for its
+    // start or is held by the load still has its segment, a new start time would only set it apart from the other one.
+    const uint32_t currentTime = millis();
+    const bool isLeftMissing = !gearbox->hasSegmentLeft() && (gearbox->getPositionLeft() != MOVE_TO_POSITION);
+    const bool isRightMissing = !gearbox->hasSegmentRight() && (gearbox->getPositionRight() != MOVE_TO_POSITION);
+    if (!isSegmentSent || ((isLeftMissing || isRightMissing) && (currentTime - lastSegmentTime >= SEGMENT_RESEND_TIME)))
+    {
+        gearbox->driveSegment(MOVE_TO_POSITION, 0u);
+        isSegmentSent = true;
+        lastSegmentTime = currentTime;
+        return;
+    }
+    // At the target only events matter.
+    const bool isAtTarget = (gearbox->getPositionLeft() == MOVE_TO_POSITION) && (gearbox->getPositionRight() == MOVE_TO_POSITION) && (gearbox->getSpeedLeft() == 0) && (gearbox->getSpeedRight() == 0);
+    if (isAtTarget)
+    {
+        gearbox->watchEvents();
+        return;
+    }
+    // Each poll passes the motion of the other gearbox on for the deviation check and the speed trim.
+    if (currentTime - lastSegmentPollTime >= SEGMENT_POLL_TIME)
+    {
+        lastSegmentPollTime = currentTime;
+        gearbox->getPosition();
+    }
+}
+
 void InputController::performEmergencyStop()
 {
     gearbox->emergencyStop();
@@ -906,13 +775,13 @@ void InputController::performEmergencyStopRecovery()
 void InputController::performSwitchOnGearboxPower()
 {
     digitalWrite(GEARBOX_POWER_RELAY_PIN, HIGH);
-    gearbox->getPosition();
+    gearbox->watchEvents();
 }
 
 void InputController::performSwitchOnMotorPowerSupply()
 {
     digitalWrite(RELAY_24V_PIN, HIGH);
-    gearbox->getPosition();
+    gearbox->watchEvents();
 }
 
 void InputController::performSwitchOnMotorControlPower()
@@ -967,12 +836,12 @@ void InputController::performSwitchOffMotorControlPower()
 void InputController::performSwitchOffMotorPowerSupply()
 {
     digitalWrite(RELAY_24V_PIN, LOW);
-    gearbox->getPosition();
+    gearbox->watchEvents();
 }
 
 void InputController::performSwitchOffGearboxPower()
 {
     digitalWrite(GEARBOX_POWER_RELAY_PIN, LOW);
-    gearbox->getPosition();
+    gearbox->watchEvents();
 }
 #pragma endregion Gearbox Machine
\ No newline at end of file
@@ -3,24 +3,33 @@
 #include <Arduino.h>
 #include "GearboxCommunication.hpp"
 #include "ButtonEvents.hpp"
-#include <queue>
+#include <EventRing.hpp>
 
 class InputEvent
 {
 public:
-    ButtonId buttonId;
-    ButtonEvent buttonEvent;
+    ButtonId buttonId{0u};
+    ButtonEvent buttonEvent{0u};
 
+    InputEvent() = default;
     InputEvent(ButtonId buttonId, ButtonEvent buttonEvent) : buttonId(buttonId), buttonEvent(buttonEvent) {}
     ~InputEvent() = default;
 };
 
+// Button events from the reader of the control panel to the control task, copied into the ring.
+using InputEventQueue = EventRing<InputEvent, 16u>;
+
 class InputController
 {
 private:
     static constexpr uint32_t MAX_GEARBOX_DEVIATION = 800u;
     static constexpr uint32_t UNLOCKING_DRIVE_UP_DISTANCE = 40u;
     static constexpr uint32_t MAX_DEVIATION_STOP_RECOVERY = 0u;
+    static constexpr uint32_t MOVE_TO_POSITION{40000u};
+    // A segment is sent again after this time if a gearbox away from its target still reports no segment.
+    static constexpr uint32_t SEGMENT_RESEND_TIME{500u};
+    // Both gearboxes follow a segment on their own, their status is only read at this interval to keep them synchronized.
+    static constexpr uint32_t SEGMENT_POLL_TIME{20u};
 
     static constexpr uint32_t SWITCH_ON_GEARBOX_POWER_TIME{10u};
     static constexpr uint32_t SWITCH_ON_MOTOR_POWER_SUPPLY_TIME{10u};
@@ -37,6 +46,11 @@ private:
     static constexpr uint32_t MAX_BRAKE_UNLOCKING_TIME{250u};
     static constexpr uint32_t MAX_BRAKE_LOCKING_TIME{1000u};
 
+    // Loop intervals, see getLoopIntervalUS().
+    static constexpr unsigned long LOOP_INTERVAL_US{10000u};
+    static constexpr unsigned long DRIVE_LOOP_INTERVAL_US{2000u};
+    static constexpr unsigned long RESTING_LOOP_INTERVAL_US{20000u};
+
     // UI State Machine
     enum class UiState
     {
@@ -86,12 +100,18 @@ private:
     uint32_t startPositionDriveUp{0u};
     uint32_t targetPositionDriveUp{0u};
 
+    // Gearbox move to
+    bool isSegmentSent{false};
+    uint32_t lastSegmentTime{0u};
+    uint32_t lastSegmentPollTime{0u};
+
     // gearbox stop
     uint32_t lastPositionLeft{0u};
     uint32_t lastPositionRight{0u};
 
     GearboxCommunication *const gearbox{};
-    std::queue<InputEvent *> *const eventQueue{};
+    InputEventQueue *const eventQueue{};
+    uint32_t lastLoggedEventOverflows{0u};
     UiState uiState{UiState::Idle};
     UnlockingBrakeState unlockingBrakeState{UnlockingBrakeState::SwitchOnGearboxPower};
     LockingBrakeState lockingBrakeState{LockingBrakeState::LockBrakes};
@@ -106,11 +126,11 @@ private:
     bool isInMovingUiState();
 
     // UI Methods
-    void uiIdle(InputEvent *const event);
-    void uiDriveControl(InputEvent *const event);
-    void moveUp(InputEvent *const event);
-    void moveDown(InputEvent *const event);
-    void moveTo(InputEvent *const event);
+    void uiIdle(const InputEvent &event);
+    void uiDriveControl(const InputEvent &event);
+    void moveUp(const InputEvent &event);
+    void moveDown(const InputEvent &event);
+    void moveTo(const InputEvent &event);
 
     void checkTransitionOnBrake();
     void checkTransitionLockingBrakes();
@@ -140,6 +160,7 @@ private:
     void performUnlockingBrakes();
     void performStop();
     void performDriveMode();
+    void performMoveTo();
     void performEmergencyStop();
     void performEmergencyStopRecovery();
 
@@ -159,8 +180,12 @@ private:
     void performSwitchOffGearboxPower();
 
 public:
-    InputController(GearboxCommunication *const gearbox, std::queue<InputEvent *> *const eventQueue);
+    InputController(GearboxCommunication *const gearbox, InputEventQueue *const eventQueue);
     ~InputController() = default;
 
     void update();
+    // Interval till the next loop iteration. It is short while the columns move, such that deviations and stops are
+    // handled early, but never shorter than the buses need for a command to each gearbox. While the desk rests on its
+    // brakes, the loop only waits for a button, the UART buffer of 256 bytes holds 22 ms of the control panel.
+    unsigned long getLoopIntervalUS() const;
 };
\ No newline at end of file
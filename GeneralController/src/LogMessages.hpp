@@ -0,0 +1,41 @@
+#pragma once
+
+#include <DeferredLogFormat.hpp>
+
+// Messages of the general controller for the deferred logger. New messages are only appended, otherwise, the decoder
+// shows wrong texts for captures of older firmwares. Names of enums are listed in the order of their values.
+#define CONTROLLER_LOG_MESSAGES(X)                                                                                     \
+    X(GEARBOX_POSITION, "Gearbox position left: %u right: %u")                                                         \
+    X(UI_STATE, "UI State: %{DriveControl|Idle|MoveUp|MoveDown|MoveTo}")                                               \
+    X(GEARBOX_STATE, "Gearbox State: %{OnBrake|LockingBrakes|UnlockingBrakes|Stop|DriveMode|EmergencyStop|"            \
+                     "EmergencyStopRecovery}")                                                                         \
+    X(BRAKE_STATE_LEFT, "Brake State Left: %u %{BRAKE_STATE_LOCKED|BRAKE_STATE_INTERMEDIARY|BRAKE_STATE_ERROR|"        \
+                        "BRAKE_STATE_UNLOCKED}")                                                                       \
+    X(BRAKE_STATE_RIGHT, "Brake State Right: %{BRAKE_STATE_LOCKED|BRAKE_STATE_INTERMEDIARY|BRAKE_STATE_ERROR|"         \
+                         "BRAKE_STATE_UNLOCKED}")                                                                      \
+    X(BUTTON_EVENT, "Button: %{Main|Up|Down|Shortcut 1|Shortcut 2}, Event: %{SINGLE_CLICK|DOUBLE_CLICK|LONG_CLICK|"    \
+                    "START_DOUBLE_HOLD_CLICK|END_DOUBLE_HOLD_CLICK|NO_EVENT|BUTTON_PRESSED|BUTTON_RELEASED}")          \
+    X(UNLOCKING_BRAKE_STATE, "UnlockingBrakeState: %{SwitchOnGearboxPower|SwitchOnMotorPowerSupply|"                   \
+                             "SwitchOnMotorControlPower|SwitchOnMotorControl|UnlockBrakes|UnlockDriveUp}")             \
+    X(LOCKING_BRAKE_STATE, "LockingBrakeState: %{LockBrakes|SwitchOffMotorControl|SwitchOffMotorControlPower|"         \
+                           "SwitchOffMotorPowerSupply|SwitchOffGearboxPower}")                                         \
+    X(ENCODER, "Encoder: %u State: %u")                                                                                \
+    X(UNKNOWN_PANEL_MESSAGE, "Unknown control panel message of length %u, type %u")                                   \
+    X(GEARBOX_STATUS_REJECTED, "Gearbox %{Left|Right}: Rejected status, reason: %{Ok|TooShort|WrongVersion|"           \
+                               "WrongLength|WrongCrc}")                                                                \
+    X(GEARBOX_COMMAND_LOST, "Gearbox %{Left|Right}: Lost a command, last accepted sequence: %u")                       \
+    X(GEARBOX_TRANSACTION_FAILED, "Gearbox %{Left|Right}: I2C transaction failed after %u attempts, result: "          \
+                                  "%{Ok|Nack|BusError|ShortRead|Expired}")                                             \
+    X(I2C_BUS_RECOVERED, "Recovered the I2C bus, recoveries: %u")                                                      \
+    X(GEARBOX_BROADCAST_FAILED, "Broadcast failed after %u attempts, result: %{Ok|Nack|BusError|ShortRead|Expired}")   \
+    X(GEARBOX_BROADCAST_UNSUPPORTED, "Gearboxes do not acknowledge the general call, addressing each of them")         \
+    X(I2C_FREQUENCY_CHANGED, "I2C clock changed from %u kHz to %u kHz")                                                \
+    X(I2C_LINK_HEALTH, "I2C bus %{Left|Right}: NACKs: %u, timeouts: %u, retries: %u")                                  \
+    X(EMERGENCY_STOP_LINE_PULLED, "Emergency stop line pulled by a gearbox")                                           \
+    X(GEARBOX_EVENTS, "Gearbox %{Left|Right}: Events 0x%02x (started, stopped, stall, brake, deviation, driver "       \
+                      "fault)")                                                                                        \
+    X(LOOP_STATISTICS, "Loop: overruns: %u, skipped iterations: %u, jitter mean: %u us, max: %u us")                   \
+    X(INPUT_EVENTS_DROPPED, "Control panel events dropped, the event queue was full: %u")                              \
+    X(GEARBOX_BROADCAST_ACKNOWLEDGED, "Gearboxes acknowledge the general call on bus %{Left|Right}")
+
+DEFERRED_LOG_CATALOG(ControllerLog, CONTROLLER_LOG_MESSAGES);
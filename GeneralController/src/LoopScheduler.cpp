@@ -0,0 +1,74 @@
+#include "LoopScheduler.hpp"
+#include "LogMessages.hpp"
+#include <DeferredLog.hpp>
+
+LoopScheduler::LoopScheduler(const unsigned long intervalUS, const CatchUpPolicy catchUpPolicy) : catchUpPolicy(catchUpPolicy), intervalUS(intervalUS)
+{
+}
+
+void LoopScheduler::begin(const unsigned long nowUS)
+{
+    dueUS = nowUS;
+    lastLogUS = nowUS;
+}
+
+void LoopScheduler::beginIteration(const unsigned long nowUS)
+{
+    isCatchUpIteration = catchUpIterations > 0u;
+    if (isCatchUpIteration)
+    {
+        // Its delay belongs to the overrun that it catches up on.
+        catchUpIterations--;
+        return;
+    }
+
+    const long jitterUS = static_cast<long>(nowUS - dueUS);
+    if (jitterUS > 0)
+    {
+        jitterSumUS += static_cast<unsigned long>(jitterUS);
+        maxJitterUS = max(maxJitterUS, static_cast<unsigned long>(jitterUS));
+    }
+    else
+    {
+        dueUS = nowUS;
+    }
+    iterations++;
+}
+
+void LoopScheduler::endIteration(const unsigned long nowUS, const unsigned long nextIntervalUS)
+{
+    intervalUS = nextIntervalUS;
+    dueUS += intervalUS;
+
+    // A catch-up iteration ends behind the schedule by design, the overrun that it catches up on was counted already.
+    const long lateUS = static_cast<long>(nowUS - dueUS);
+    if ((lateUS > 0) && !isCatchUpIteration)
+    {
+        overruns++;
+        // Iterations that were due before the next one, which runs right away.
+        uint32_t missedIterations = static_cast<unsigned long>(lateUS) / intervalUS;
+        if (catchUpPolicy == CatchUpPolicy::Burst)
+        {
+            catchUpIterations =
+                (missedIterations > MAX_CATCH_UP_ITERATIONS) ? MAX_CATCH_UP_ITERATIONS : missedIterations;
+            missedIterations -= catchUpIterations;
+        }
+        dueUS += missedIterations * intervalUS;
+        skippedIterations += missedIterations;
+    }
+
+    if (nowUS - lastLogUS >= STATISTICS_LOG_INTERVAL_US)
+    {
+        logStatistics(nowUS);
+    }
+}
+
+void LoopScheduler::logStatistics(const unsigned long nowUS)
+{
+    const uint32_t meanJitterUS = (iterations > 0u) ? static_cast<uint32_t>(jitterSumUS / iterations) : 0u;
+    DeferredLog::write(ControllerLog::LOOP_STATISTICS, overruns, skippedIterations, meanJitterUS, maxJitterUS);
+    iterations = 0u;
+    jitterSumUS = 0u;
+    maxJitterUS = 0u;
+    lastLogUS = nowUS;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Paces the loop of the general controller. Every iteration picks the interval till the next one, e.g. a short one
+// while the columns move and a long one while the desk rests on its brakes. An iteration that ends after the next one
+// was due is an overrun, the catch-up policy decides what becomes of the iterations it missed. The delay of the start
+// of an iteration behind its due time is its jitter. Iterations that run back to back to catch up are neither overruns
+// nor count for the jitter, a stall counts as one overrun.
+class LoopScheduler
+{
+public:
+    enum class CatchUpPolicy : uint8_t
+    {
+        // The missed iterations run back to back till the loop is on schedule again, at most MAX_CATCH_UP_ITERATIONS of
+        // them, the rest is skipped.
+        Burst,
+        // Only the late iteration runs, the loop returns to its schedule afterwards.
+        Skip,
+    };
+
+private:
+    static constexpr uint32_t MAX_CATCH_UP_ITERATIONS{4u};
+    // The statistics are logged at this interval.
+    static constexpr unsigned long STATISTICS_LOG_INTERVAL_US{10000000u};
+
+    const CatchUpPolicy catchUpPolicy{};
+    unsigned long intervalUS{};
+    unsigned long dueUS{0u};
+    uint32_t overruns{0u};
+    uint32_t skippedIterations{0u};
+    // Missed iterations that still run back to back, see Burst, and whether the current one is one of them.
+    uint32_t catchUpIterations{0u};
+    bool isCatchUpIteration{false};
+    // Since the last log.
+    uint32_t iterations{0u};
+    uint64_t jitterSumUS{0u};
+    unsigned long maxJitterUS{0u};
+    unsigned long lastLogUS{0u};
+
+    void logStatistics(const unsigned long nowUS);
+
+public:
+    LoopScheduler(const unsigned long intervalUS, const CatchUpPolicy catchUpPolicy);
+    ~LoopScheduler() = default;
+
+    // Starts the schedule, the first iteration is due right away.
+    void begin(const unsigned long nowUS);
+    // Records the jitter of the iteration that starts now. An iteration that starts early, e.g. woken by a button,
+    // moves the schedule to its start.
+    void beginIteration(const unsigned long nowUS);
+    // Schedules the next iteration the interval after the due time of this one.
+    void endIteration(const unsigned long nowUS, const unsigned long nextIntervalUS);
+
+    unsigned long getDueUS() const { return dueUS; }
+    unsigned long getIntervalUS() const { return intervalUS; }
+    uint32_t getOverruns() const { return overruns; }
+    uint32_t getSkippedIterations() const { return skippedIterations; }
+};
@@ -1,2 +1,9 @@
+#pragma once
+
 #define GEARBOX_POWER_RELAY_PIN 32
-#define RELAY_24V_PIN 33
\ No newline at end of file
+#define RELAY_24V_PIN 33
+// Emergency stop line shared with both gearboxes (EMERGENCY_STOP_LINE)
+#define EMERGENCY_STOP_LINE_PIN 27
+// Attention lines of the gearboxes, low while the gearbox has events pending (GEARBOX_ATTENTION_LINE)
+#define GEARBOX_LEFT_ATTENTION_PIN 18
+#define GEARBOX_RIGHT_ATTENTION_PIN 19
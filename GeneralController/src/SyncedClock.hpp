@@ -0,0 +1,10 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Time base of the desk. The gearboxes estimate the clock of the general controller from the time sync exchanges of
+// GearboxCommunication, thus, the controller's own clock is the synced one.
+inline unsigned long syncedMicros()
+{
+    return micros();
+}
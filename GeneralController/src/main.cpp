@@ -1,11 +1,11 @@
 #include <Arduino.h>
-#include <chrono>
-#include <thread>
 #include <Wire.h>
 #include "GearboxCommunication.hpp"
 #include "InputController.hpp"
 #include "ControlPanelCommunication.hpp"
-#include <queue>
+#include "LogMessages.hpp"
+#include "LoopScheduler.hpp"
+#include <DeferredLog.hpp>
 
 static constexpr uint8_t GEARBOX_LEFT_ADDRESS = 0x33;
 static constexpr uint8_t GEARBOX_RIGHT_ADDRESS = 0x88;
@@ -13,7 +13,13 @@ static constexpr uint8_t GEARBOX_RIGHT_ADDRESS = 0x88;
 // Gearboxes I2C Connection.
 static constexpr int I2C_SDA_PIN = 21;
 static constexpr int I2C_SCL_PIN = 22;
-static constexpr uint32_t I2C_FREQ = 100000u;
+// Fastest clock of the gearbox buses (Fast-mode Plus), the bus falls back to slower modes by itself if it fails.
+static constexpr uint32_t I2C_FREQ = 1000000u;
+#ifdef GEARBOX_SEPARATE_I2C_BUSES
+// The right gearbox on the second I2C controller, both gearboxes are served at the same time then.
+static constexpr int I2C_RIGHT_SDA_PIN = 25;
+static constexpr int I2C_RIGHT_SCL_PIN = 26;
+#endif
 
 // Control Panel Uart Connection.
 static constexpr int8_t UART_TX_PIN = 17;
@@ -21,37 +27,67 @@ static constexpr int8_t UART_RX_PIN = 16;
 static constexpr uint32_t UART_CONFIG = SERIAL_8N1;
 static constexpr uint32_t UART_BAUDRATE = 115200u;
 
-std::chrono::steady_clock::time_point start;
-std::chrono::steady_clock::time_point target;
-std::chrono::steady_clock::duration iterationDuration = std::chrono::milliseconds(10);
+// Rate at which buffered log records are sent over the serial port.
+static constexpr uint32_t LOG_DRAIN_INTERVAL_MS = 50u;
 
+// The control task owns the state machines, it only yields to the control panel reader and the I2C tasks, which merely
+// hand data over. The log drain runs below it.
+static constexpr UBaseType_t CONTROL_TASK_PRIORITY = 3u;
+static constexpr uint32_t CONTROL_TASK_STACK_SIZE = 8192u;
+static constexpr unsigned long TICK_US = portTICK_PERIOD_MS * 1000u;
+
+// Iterations missed by an overrun are skipped, the next one sends newer commands to the gearboxes anyway.
+static constexpr LoopScheduler::CatchUpPolicy LOOP_CATCH_UP_POLICY = LoopScheduler::CatchUpPolicy::Skip;
+
+#ifdef GEARBOX_SEPARATE_I2C_BUSES
+GearboxCommunication gearbox(GEARBOX_LEFT_ADDRESS, GEARBOX_RIGHT_ADDRESS, &Wire, I2C_SDA_PIN, I2C_SCL_PIN, &Wire1, I2C_RIGHT_SDA_PIN, I2C_RIGHT_SCL_PIN, I2C_FREQ);
+#else
 GearboxCommunication gearbox(GEARBOX_LEFT_ADDRESS, GEARBOX_RIGHT_ADDRESS, &Wire, I2C_SDA_PIN, I2C_SCL_PIN, I2C_FREQ);
-std::queue<InputEvent *> eventQueue;
+#endif
+InputEventQueue eventQueue;
 InputController inputController(&gearbox, &eventQueue);
 ControlPanelCommunication controlPanelCommunication(&eventQueue, UART_TX_PIN, UART_RX_PIN, UART_CONFIG, UART_BAUDRATE);
+LoopScheduler loopScheduler(inputController.getLoopIntervalUS(), LOOP_CATCH_UP_POLICY);
+TaskHandle_t controlTaskHandle{nullptr};
+
+void runControlTask(void *)
+{
+  loopScheduler.begin(micros());
+  while (true)
+  {
+    // Wait till the next iteration should start or the control panel queued events, which starts it right away.
+    const long remainingUS = static_cast<long>(loopScheduler.getDueUS() - micros());
+    if (remainingUS > 0)
+    {
+      ulTaskNotifyTake(pdTRUE, (remainingUS + TICK_US - 1u) / TICK_US);
+    }
+    loopScheduler.beginIteration(micros());
+
+    // Take over the replies of the gearboxes to the commands of the last iteration.
+    gearbox.processReplies();
+
+    inputController.update();
+
+    // The state the iteration left the desk in sets the time till the next one.
+    loopScheduler.endIteration(micros(), inputController.getLoopIntervalUS());
+  }
+}
 
 void setup()
 {
   // Initialize Serial communication
   Serial.begin(115200);
-
-  // Initialize start time
-  start = std::chrono::steady_clock::now();
-  target = start;
+#ifdef DEFERRED_LOG_TEXT
+  DeferredLog::setTextFormats(ControllerLogFormats);
+#endif
+  DeferredLog::startDrainTask(Serial, LOG_DRAIN_INTERVAL_MS);
+  gearbox.startBusTask();
+  xTaskCreatePinnedToCore(runControlTask, "ControlTask", CONTROL_TASK_STACK_SIZE, nullptr, CONTROL_TASK_PRIORITY, &controlTaskHandle, 1);
+  controlPanelCommunication.startReaderTask(controlTaskHandle);
 }
 
 void loop()
 {
-  // Wait till the next iteration should start.
-  std::this_thread::sleep_until(target);
-
-  // Read all messages from the control panel.
-  while (controlPanelCommunication.update())
-  {
-  }
-
-  inputController.update();
-
-  // Update the target time for the next iteration.
-  target += iterationDuration;
-}
\ No newline at end of file
+  // Everything runs in the tasks started by setup().
+  vTaskDelete(nullptr);
+}
@@ -0,0 +1,302 @@
+// Host benchmark of the gearbox firmware. The firmware runs against the simulated clock of the native stand-ins, while
+// the host clock measures how long its hot paths take. The numbers are not the ones of the ESP32, but they are stable
+// enough to compare two versions of the code on the same machine.
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <DeferredLog.hpp>
+#include <GearboxProtocol.hpp>
+
+#include "NativeArduino.hpp"
+#include "Communication.hpp"
+#include "MotorTimer.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+#ifdef GEARBOX_LEFT
+    constexpr const char *const VARIANT_NAME{"left"};
+#else
+    constexpr const char *const VARIANT_NAME{"right"};
+#endif
+    // Length of the moves, about 30 s at max speed.
+    constexpr long TRAVEL_STEPS{40000};
+    // The general controller sends a command to every gearbox at this rate.
+    constexpr uint64_t COMMAND_INTERVAL_US{20000u};
+    constexpr size_t DISPATCH_ITERATIONS{100000u};
+    // Bounds every simulation in case the motor never reaches its target.
+    constexpr uint64_t SIMULATION_LIMIT_US{120000000u};
+
+    // Host time of repeated calls of one operation.
+    class Timing
+    {
+    private:
+        std::vector<uint32_t> samplesNS;
+        uint64_t totalNS{0u};
+
+    public:
+        void add(const Clock::duration duration)
+        {
+            const uint32_t durationNS = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+            samplesNS.push_back(durationNS);
+            totalNS += durationNS;
+        }
+
+        size_t count() const { return samplesNS.size(); }
+        uint64_t total() const { return totalNS; }
+        double average() const { return samplesNS.empty() ? 0.0 : static_cast<double>(totalNS) / samplesNS.size(); }
+
+        uint32_t percentile(const double fraction) const
+        {
+            if (samplesNS.empty())
+            {
+                return 0u;
+            }
+            std::vector<uint32_t> sorted = samplesNS;
+            const size_t index = std::min(sorted.size() - 1u, static_cast<size_t>(fraction * sorted.size()));
+            std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+            return sorted[index];
+        }
+    };
+
+    // Log records are drained outside of the measured code, like the drain task does on the target.
+    class NullPrint : public Print
+    {
+    public:
+        size_t write(uint8_t value) override { return 1u; }
+    };
+    NullPrint logSink;
+
+    void printTiming(const char *name, const Timing &timing)
+    {
+        printf("%-26s %10zu calls %10.1f ns avg %10u ns p99 %10u ns max\n", name, timing.count(), timing.average(),
+               timing.percentile(0.99), timing.percentile(1.0));
+        fflush(stdout);
+    }
+
+    // The other gearbox is at the same position and stands still.
+    void sendCommand(const uint8_t code, const uint32_t otherPosition, const uint32_t targetPosition)
+    {
+        GearboxProtocol::Command command{};
+        command.code = code;
+        command.peer.position = otherPosition;
+        command.targetPosition = targetPosition;
+        uint8_t data[GearboxProtocol::MAX_COMMAND_LENGTH];
+        Wire.receive(data, GearboxProtocol::encodeCommand(command, data));
+    }
+}
+
+Communication communication{0.0f, 0.0f};
+MotorTimer motorTimer{communication.getGearbox()->getDeskMotor(), communication.getGearbox()->getLargeBrake(), []()
+                      { return communication.processCommands(); }};
+
+// Runs the cycle of the motor task, which is private to it.
+class MotorLoopBenchmark
+{
+public:
+    static uint32_t runCycle() { return motorTimer.runCycle(); }
+};
+
+namespace
+{
+    // Moves the desk motor to the position by calling step() whenever it is due.
+    void benchmarkDeskMotorStep(const long targetPosition)
+    {
+        DeskMotor *const deskMotor = communication.getGearbox()->getDeskMotor();
+        const long startPosition = deskMotor->getCurrentPosition();
+        deskMotor->setNewTargetPosition(targetPosition);
+        deskMotor->start();
+
+        Timing timing;
+        const uint64_t endUS = NativeArduino::now() + SIMULATION_LIMIT_US;
+        while (NativeArduino::now() < endUS)
+        {
+            const Clock::time_point start = Clock::now();
+            const uint32_t timeToNextStepUS = deskMotor->step();
+            timing.add(Clock::now() - start);
+            if (timeToNextStepUS == DeskMotor::NO_STEP_DUE)
+            {
+                break;
+            }
+            NativeArduino::advance(timeToNextStepUS);
+        }
+
+        const long steps = labs(static_cast<long>(deskMotor->getCurrentPosition()) - startPosition);
+        printTiming("DeskMotor::step", timing);
+        printf("%-26s %10ld steps %10.1f ns/step\n", "", steps, steps > 0 ? static_cast<double>(timing.total()) / steps : 0.0);
+    }
+
+#ifdef DESK_MOTOR_RMT_STEPS
+    // Moves the desk motor with the RMT and compares the interval between every two step pulses on the output with the
+    // one the profile planned, including the ones across the refills of the channel RAM.
+    void checkPulseTrain(const long targetPosition)
+    {
+        // Resolution and min interval of StepPulseGenerator.
+        constexpr uint32_t NS_PER_TICK{100u};
+        constexpr uint32_t MIN_INTERVAL_TICKS{21u};
+
+        DeskMotor *const deskMotor = communication.getGearbox()->getDeskMotor();
+        const long distance = labs(targetPosition - static_cast<long>(deskMotor->getCurrentPosition()));
+        MotionProfile plannedProfile{deskMotor->getMaxSpeed(), deskMotor->getMaxAcceleration(),
+                                     deskMotor->getMaxJerk()};
+        plannedProfile.setTargetPosition(distance);
+        std::vector<uint64_t> plannedIntervalsNS;
+        uint32_t intervalNS{0u};
+        int8_t direction{0};
+        while (plannedProfile.planStep(intervalNS, direction))
+        {
+            const uint32_t ticks = std::max(intervalNS / NS_PER_TICK, MIN_INTERVAL_TICKS);
+            plannedIntervalsNS.push_back(static_cast<uint64_t>(ticks) * NS_PER_TICK);
+        }
+
+        std::vector<uint64_t> edgesNS;
+        NativeArduino::currentBoard().rmt.onRisingEdge = [&edgesNS](const uint64_t timeNS)
+        { edgesNS.push_back(timeNS); };
+        const uint32_t refills = deskMotor->getPulseGenerator().getRefills();
+        const uint32_t transmissions = deskMotor->getPulseGenerator().getTransmissions();
+        deskMotor->setNewTargetPosition(targetPosition);
+        deskMotor->start();
+        const uint64_t endUS = NativeArduino::now() + SIMULATION_LIMIT_US;
+        while (NativeArduino::now() < endUS)
+        {
+            const uint32_t timeToNextStepUS = deskMotor->step();
+            if (timeToNextStepUS == DeskMotor::NO_STEP_DUE)
+            {
+                break;
+            }
+            NativeArduino::advance(timeToNextStepUS);
+        }
+        NativeArduino::currentBoard().rmt.onRisingEdge = nullptr;
+
+        // The first step is timed from the start of the transmission.
+        uint64_t maxErrorNS{0u};
+        for (size_t i = 1u; (i < edgesNS.size()) && (i < plannedIntervalsNS.size()); i++)
+        {
+            const uint64_t measuredNS = edgesNS[i] - edgesNS[i - 1u];
+            const uint64_t errorNS = (measuredNS > plannedIntervalsNS[i]) ? measuredNS - plannedIntervalsNS[i]
+                                                                           : plannedIntervalsNS[i] - measuredNS;
+            maxErrorNS = std::max(maxErrorNS, errorNS);
+        }
+        printf("%-26s %10zu steps %10zu planned %10u refills %10u transmissions %10llu ns max interval error\n",
+               "RMT pulse train", edgesNS.size(), plannedIntervalsNS.size(),
+               deskMotor->getPulseGenerator().getRefills() - refills,
+               deskMotor->getPulseGenerator().getTransmissions() - transmissions,
+               static_cast<unsigned long long>(maxErrorNS));
+        fflush(stdout);
+    }
+#endif
+
+    void benchmarkBrakeStep()
+    {
+        Brake *const brake = communication.getGearbox()->getLargeBrake();
+        brake->openBrake();
+
+        Timing timing;
+        const uint64_t endUS = NativeArduino::now() + SIMULATION_LIMIT_US;
+        while (NativeArduino::now() < endUS)
+        {
+            const Clock::time_point start = Clock::now();
+            const uint32_t timeToNextStepUS = brake->step();
+            timing.add(Clock::now() - start);
+            if (timeToNextStepUS == Brake::NO_STEP_DUE)
+            {
+                break;
+            }
+            NativeArduino::advance(std::max(timeToNextStepUS, 1u));
+        }
+        printTiming("Brake::step", timing);
+        DeferredLog::drain(logSink, SIZE_MAX);
+    }
+
+    // Time from the I2C callback receiving a command till the motor task executed it.
+    void benchmarkCommandDispatch()
+    {
+        Gearbox *const gearbox = communication.getGearbox();
+        Timing moveTiming;
+        Timing requestTiming;
+        for (size_t i = 0u; i < DISPATCH_ITERATIONS; i++)
+        {
+            const uint32_t position = gearbox->getCurrentPosition();
+            Clock::time_point start = Clock::now();
+            sendCommand(i % 2u == 0u ? GearboxProtocol::CMD_MOVE_UP : GearboxProtocol::CMD_MOVE_DOWN, position, 0u);
+            communication.processCommands();
+            moveTiming.add(Clock::now() - start);
+
+            uint8_t reply[GearboxProtocol::STATUS_LENGTH];
+            start = Clock::now();
+            Wire.request(reply, sizeof(reply));
+            requestTiming.add(Clock::now() - start);
+
+            NativeArduino::advance(1000u);
+            DeferredLog::drain(logSink, SIZE_MAX);
+        }
+        gearbox->stopMotor();
+        printTiming("I2C command dispatch", moveTiming);
+        printTiming("I2C status request", requestTiming);
+    }
+
+    // Runs the motor task like the target does: the task wakes on the timer alarm, on a command or when its cycle asked
+    // for it. Commands arrive at the rate of the general controller.
+    void benchmarkMotionLoop(const uint32_t targetPosition)
+    {
+        Gearbox *const gearbox = communication.getGearbox();
+        sendCommand(GearboxProtocol::CMD_LOOSEN_BRAKE, gearbox->getCurrentPosition(), 0u);
+
+        Timing timing;
+        const uint64_t startUS = NativeArduino::now();
+        uint64_t nextCommandUS = startUS;
+        const uint64_t endUS = NativeArduino::now() + SIMULATION_LIMIT_US;
+        while (NativeArduino::now() < endUS)
+        {
+            if (NativeArduino::now() >= nextCommandUS)
+            {
+                sendCommand(GearboxProtocol::CMD_MOVE_TO, gearbox->getCurrentPosition(), targetPosition);
+                nextCommandUS += COMMAND_INTERVAL_US;
+            }
+
+            const Clock::time_point start = Clock::now();
+            const uint32_t cycleDueUS = MotorLoopBenchmark::runCycle();
+            timing.add(Clock::now() - start);
+            DeferredLog::drain(logSink, SIZE_MAX);
+
+            if (gearbox->getCurrentPosition() == targetPosition && !NativeArduino::isAlarmEnabled())
+            {
+                break;
+            }
+
+            uint64_t wakeUS = nextCommandUS;
+            if (cycleDueUS != MotorTimer::NO_CYCLE_DUE)
+            {
+                wakeUS = std::min(wakeUS, NativeArduino::now() + cycleDueUS);
+            }
+            if (NativeArduino::isAlarmEnabled())
+            {
+                wakeUS = std::min(wakeUS, NativeArduino::alarmTime());
+            }
+            NativeArduino::advance(wakeUS > NativeArduino::now() ? wakeUS - NativeArduino::now() : 0u);
+        }
+
+        printTiming("Motion loop cycle", timing);
+        printf("%-26s %10u position %10.3f s move\n", "", gearbox->getCurrentPosition(), (NativeArduino::now() - startUS) / 1e6);
+    }
+}
+
+int main()
+{
+    printf("\nGearbox %s benchmark\n", VARIANT_NAME);
+    benchmarkDeskMotorStep(TRAVEL_STEPS);
+    benchmarkDeskMotorStep(0);
+#ifdef DESK_MOTOR_RMT_STEPS
+    checkPulseTrain(TRAVEL_STEPS);
+    checkPulseTrain(0);
+#endif
+    benchmarkBrakeStep();
+    benchmarkCommandDispatch();
+    benchmarkMotionLoop(TRAVEL_STEPS);
+    benchmarkMotionLoop(0u);
+    return 0;
+}
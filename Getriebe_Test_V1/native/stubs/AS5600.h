@@ -0,0 +1,13 @@
+#pragma once
+
+#include <Wire.h>
+
+// Stand-in for the rotary sensor, it always reports the lowest position.
+class AS5600
+{
+public:
+    bool begin() { return true; }
+    bool isConnected() { return true; }
+    uint16_t readAngle() { return 0u; }
+    uint16_t rawAngle() { return 0u; }
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+// Minimal stand-in for the ESP32 Arduino core, just enough to compile the gearbox firmware and the general controller on
+// the host. Time is simulated, see NativeArduino.hpp, and FreeRTOS tasks are never started, the benchmark and the desk
+// simulator run their cycles themselves.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+#define IRAM_ATTR
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define OUTPUT_OPEN_DRAIN 0x13
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define SERIAL_8N1 0x800001c
+
+#define PI 3.1415926535897932384626433832795
+
+// The core defines these as macros, which accept arguments of different types.
+template <typename A, typename B>
+constexpr typename std::common_type<A, B>::type min(const A a, const B b) { return b < a ? b : a; }
+template <typename A, typename B>
+constexpr typename std::common_type<A, B>::type max(const A a, const B b) { return a < b ? b : a; }
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+#define digitalPinToInterrupt(pin) (pin)
+// Pin interrupts fire when the simulation changes the level of an input, see NativeArduino::setInputLevel().
+void attachInterruptArg(uint8_t pin, void (*callback)(void *), void *argument, int mode);
+void detachInterrupt(uint8_t pin);
+
+// FreeRTOS
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1u
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
+#define configMAX_PRIORITIES 25
+#define tskIDLE_PRIORITY 0
+#define portYIELD_FROM_ISR()
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t coreId);
+BaseType_t xPortGetCoreID();
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previousWakeTime, TickType_t ticks);
+TickType_t xTaskGetTickCount();
+
+// Hardware timer, counts the simulated time in us.
+typedef struct hw_timer_s hw_timer_t;
+hw_timer_t *timerBegin(uint8_t timer, uint16_t divider, bool countUp);
+void timerAttachInterrupt(hw_timer_t *timer, void (*callback)(), bool edge);
+uint64_t timerRead(hw_timer_t *timer);
+void timerAlarmWrite(hw_timer_t *timer, uint64_t alarmValue, bool autoreload);
+void timerAlarmEnable(hw_timer_t *timer);
+void timerAlarmDisable(hw_timer_t *timer);
+
+class String : public std::string
+{
+public:
+    String() = default;
+    String(const char *text) : std::string(text) {}
+    String(const std::string &text) : std::string(text) {}
+    template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    explicit String(const T value) : std::string(std::to_string(value)) {}
+};
+
+inline String operator+(const String &a, const String &b)
+{
+    return String(static_cast<const std::string &>(a) + static_cast<const std::string &>(b));
+}
+inline String operator+(const char *a, const String &b) { return String(a + static_cast<const std::string &>(b)); }
+inline String operator+(const String &a, const char *b) { return String(static_cast<const std::string &>(a) + b); }
+
+class Print
+{
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t value) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        for (size_t i = 0u; i < size; i++)
+        {
+            write(buffer[i]);
+        }
+        return size;
+    }
+    size_t write(const char *text) { return write(reinterpret_cast<const uint8_t *>(text), strlen(text)); }
+
+    size_t printf(const char *format, ...)
+    {
+        char buffer[256u];
+        va_list arguments;
+        va_start(arguments, format);
+        const int length = vsnprintf(buffer, sizeof(buffer), format, arguments);
+        va_end(arguments);
+        return length > 0 ? write(reinterpret_cast<const uint8_t *>(buffer), min(static_cast<size_t>(length), sizeof(buffer) - 1u)) : 0u;
+    }
+
+    size_t print(const char *text) { return write(text); }
+    size_t print(const std::string &text) { return write(text.c_str()); }
+    size_t print(const char value) { return write(static_cast<uint8_t>(value)); }
+    size_t print(const bool value) { return printf("%d", value ? 1 : 0); }
+    size_t print(const int value, const int base = 10) { return base == 16 ? printf("%x", value) : printf("%d", value); }
+    size_t print(const unsigned int value, const int base = 10) { return base == 16 ? printf("%x", value) : printf("%u", value); }
+    size_t print(const long value, const int base = 10) { return base == 16 ? printf("%lx", value) : printf("%ld", value); }
+    size_t print(const unsigned long value, const int base = 10) { return base == 16 ? printf("%lx", value) : printf("%lu", value); }
+    size_t print(const unsigned char value, const int base = 10) { return print(static_cast<unsigned int>(value), base); }
+    size_t print(const double value, const int digits = 2) { return printf("%.*f", digits, value); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T &value)
+    {
+        const size_t length = print(value);
+        return length + println();
+    }
+    template <typename T>
+    size_t println(const T &value, const int format)
+    {
+        const size_t length = print(value, format);
+        return length + println();
+    }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+};
+
+// Writes to stdout unless it is muted. Received bytes are handed in with receive(), like the hardware FIFO they are
+// dropped once the buffer is full. Constant initialized, thus, it can be used by the constructors of other globals.
+class HardwareSerial : public Stream
+{
+private:
+    static constexpr size_t RX_BUFFER_SIZE{256u};
+
+    bool isMuted{false};
+    uint8_t rxBuffer[RX_BUFFER_SIZE]{};
+    size_t rxHead{0u};
+    size_t rxCount{0u};
+
+public:
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1) {}
+    // Never called, like the tasks it would wake.
+    void onReceive(std::function<void()> callback, bool onlyOnTimeout = false) {}
+    void setMuted(const bool muted) { isMuted = muted; }
+    size_t write(uint8_t value) override { return (isMuted || fputc(value, stdout) != EOF) ? 1u : 0u; }
+    size_t write(const uint8_t *buffer, size_t size) override { return isMuted ? size : fwrite(buffer, 1u, size, stdout); }
+    using Print::write;
+    int available() override { return static_cast<int>(rxCount); }
+    int read() override
+    {
+        if (rxCount == 0u)
+        {
+            return -1;
+        }
+        const uint8_t value = rxBuffer[rxHead];
+        rxHead = (rxHead + 1u) % RX_BUFFER_SIZE;
+        rxCount--;
+        return value;
+    }
+    void flush()
+    {
+        if (!isMuted)
+        {
+            fflush(stdout);
+        }
+    }
+
+    // Emulates bytes arriving at the RX pin.
+    void receive(const uint8_t *data, const size_t size)
+    {
+        for (size_t i = 0u; (i < size) && (rxCount < RX_BUFFER_SIZE); i++)
+        {
+            rxBuffer[(rxHead + rxCount) % RX_BUFFER_SIZE] = data[i];
+            rxCount++;
+        }
+    }
+};
+
+extern HardwareSerial Serial;
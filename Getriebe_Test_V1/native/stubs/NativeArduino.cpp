@@ -0,0 +1,338 @@
+#include "NativeArduino.hpp"
+#include <Wire.h>
+#include <SPI.h>
+#include <driver/rmt.h>
+#include <soc/rmt_reg.h>
+#include <soc/rmt_struct.h>
+
+HardwareSerial Serial;
+TwoWire Wire;
+TwoWire Wire1;
+SPIClass SPI;
+rmt_dev_t RMT;
+
+namespace
+{
+    uint64_t simulatedTimeUS{0u};
+    NativeArduino::Board *selectedBoard{nullptr};
+
+    // The default board is constructed on first use, the peripherals of the firmware access it from the constructors of
+    // global objects, e.g. the RMT.
+    NativeArduino::Board &board()
+    {
+        static NativeArduino::Board defaultBoard;
+        return (selectedBoard != nullptr) ? *selectedBoard : defaultBoard;
+    }
+    // Only the address is handed out, the timer itself is the simulated time.
+    int timerToken{0};
+    int taskToken{0};
+
+    uint64_t boardTimeUS()
+    {
+        const uint64_t timeUS = max(simulatedTimeUS, board().busyUntilUS);
+        const double driftUS = static_cast<double>(timeUS) * board().clockDriftPPM * 1e-6;
+        return timeUS + static_cast<uint64_t>(board().clockOffsetUS + static_cast<int64_t>(driftUS));
+    }
+
+    uint64_t rmtTicksToNS(const NativeArduino::RmtChannel &rmt, const uint32_t ticks)
+    {
+        return static_cast<uint64_t>(ticks) * rmt.clockDivider * 25u / 2u;
+    }
+
+    // Runs the RMT interrupt at the time of the event, the bits it does not clear are dropped.
+    void raiseRmtInterrupt(NativeArduino::RmtChannel &rmt, const uint32_t status, const uint64_t timeNS)
+    {
+        simulatedTimeUS = max(simulatedTimeUS, timeNS / 1000u);
+        if (rmt.interrupt == nullptr)
+        {
+            return;
+        }
+        RMT.int_st.val = status;
+        RMT.int_clr.val = 0u;
+        rmt.interrupt(rmt.interruptArgument);
+        RMT.int_st.val = 0u;
+    }
+
+    // Sends the items of the channel RAM that end until the time.
+    void runRmt(NativeArduino::RmtChannel &rmt, const uint64_t untilNS)
+    {
+        while (rmt.isRunning)
+        {
+            rmt_item32_t item;
+            item.val = rmt.items[rmt.readIndex];
+            if (item.duration0 == 0u)
+            {
+                rmt.isRunning = false;
+                if (rmt.isEndInterruptEnabled)
+                {
+                    raiseRmtInterrupt(rmt, RMT_CH0_TX_END_INT_ST, rmt.itemStartNS);
+                }
+                return;
+            }
+            const uint64_t edgeNS = rmt.itemStartNS + rmtTicksToNS(rmt, item.duration0);
+            const uint64_t itemEndNS = edgeNS + rmtTicksToNS(rmt, item.duration1);
+            if (itemEndNS > untilNS)
+            {
+                return;
+            }
+            if ((item.level0 == 0u) && (item.level1 == 1u) && (item.duration1 > 0u) && rmt.onRisingEdge)
+            {
+                rmt.onRisingEdge(edgeNS);
+            }
+            rmt.itemStartNS = itemEndNS;
+            rmt.readIndex++;
+            if (rmt.readIndex == NativeArduino::RmtChannel::ITEMS)
+            {
+                if (RMT.apb_conf.mem_tx_wrap_en == 0u)
+                {
+                    rmt.isRunning = false;
+                    return;
+                }
+                rmt.readIndex = 0u;
+            }
+            rmt.itemsSinceThreshold++;
+            if (rmt.isThresholdInterruptEnabled && (rmt.itemsSinceThreshold == rmt.threshold))
+            {
+                rmt.itemsSinceThreshold = 0u;
+                raiseRmtInterrupt(rmt, RMT_CH0_TX_THR_EVENT_INT_ST, itemEndNS);
+            }
+        }
+    }
+}
+
+uint64_t NativeArduino::now()
+{
+    return simulatedTimeUS;
+}
+
+void NativeArduino::advance(const uint64_t durationUS)
+{
+    const uint64_t untilUS = simulatedTimeUS + durationUS;
+    runRmt(board().rmt, 1000u * untilUS);
+    simulatedTimeUS = untilUS;
+}
+
+void NativeArduino::resetTime()
+{
+    simulatedTimeUS = 0u;
+}
+
+void NativeArduino::selectBoard(Board &newBoard)
+{
+    selectedBoard = &newBoard;
+}
+
+NativeArduino::Board &NativeArduino::currentBoard()
+{
+    return board();
+}
+
+bool NativeArduino::isAlarmEnabled()
+{
+    return board().alarmEnabled;
+}
+
+uint64_t NativeArduino::alarmTime()
+{
+    return board().alarmValueUS;
+}
+
+bool NativeArduino::takeNotification()
+{
+    const bool wasNotified = board().isNotified;
+    board().isNotified = false;
+    return wasNotified;
+}
+
+void NativeArduino::setInputLevel(const uint8_t pin, const uint8_t level)
+{
+    const uint8_t previousLevel = board().pinLevels[pin];
+    board().pinLevels[pin] = level;
+    const uint8_t edge = (level == previousLevel) ? 0u : (level == HIGH) ? RISING : FALLING;
+    if ((board().interruptCallbacks[pin] != nullptr) && ((board().interruptModes[pin] & edge) != 0u))
+    {
+        board().interruptCallbacks[pin](board().interruptArguments[pin]);
+    }
+}
+
+unsigned long millis()
+{
+    return static_cast<unsigned long>(boardTimeUS() / 1000u);
+}
+
+unsigned long micros()
+{
+    // Wraps at 32 bit like on the ESP32.
+    return static_cast<uint32_t>(boardTimeUS());
+}
+
+void delay(uint32_t ms)
+{
+    simulatedTimeUS += 1000u * static_cast<uint64_t>(ms);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    // Pulse widths are not part of the simulation, the benchmark would only count them twice.
+}
+
+void yield()
+{
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    board().pinLevels[pin] = value;
+    if (board().onPinWrite)
+    {
+        board().onPinWrite(pin, value);
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    return board().pinLevels[pin];
+}
+
+void attachInterruptArg(uint8_t pin, void (*callback)(void *), void *argument, int mode)
+{
+    board().interruptCallbacks[pin] = callback;
+    board().interruptArguments[pin] = argument;
+    board().interruptModes[pin] = static_cast<uint8_t>(mode);
+}
+
+void detachInterrupt(uint8_t pin)
+{
+    board().interruptCallbacks[pin] = nullptr;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameter,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t coreId)
+{
+    // The task is not started, but it gets a valid handle such that notifications to it are accepted.
+    if (handle != nullptr)
+    {
+        *handle = &taskToken;
+    }
+    return pdPASS;
+}
+
+BaseType_t xPortGetCoreID()
+{
+    return 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait)
+{
+    return 0u;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    board().isNotified = true;
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+    board().isNotified = true;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+}
+
+void vTaskDelayUntil(TickType_t *previousWakeTime, TickType_t ticks)
+{
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return static_cast<TickType_t>(millis());
+}
+
+hw_timer_t *timerBegin(uint8_t timer, uint16_t divider, bool countUp)
+{
+    return reinterpret_cast<hw_timer_t *>(&timerToken);
+}
+
+void timerAttachInterrupt(hw_timer_t *timer, void (*callback)(), bool edge)
+{
+}
+
+uint64_t timerRead(hw_timer_t *timer)
+{
+    // Time passes while the firmware waits for a step that is due within a few us, otherwise it would spin forever.
+    return simulatedTimeUS++;
+}
+
+void timerAlarmWrite(hw_timer_t *timer, uint64_t alarmValue, bool autoreload)
+{
+    board().alarmValueUS = alarmValue;
+}
+
+void timerAlarmEnable(hw_timer_t *timer)
+{
+    board().alarmEnabled = true;
+}
+
+void timerAlarmDisable(hw_timer_t *timer)
+{
+    board().alarmEnabled = false;
+}
+
+esp_err_t rmt_config(const rmt_config_t *config)
+{
+    board().rmt.clockDivider = config->clk_div;
+    return ESP_OK;
+}
+
+esp_err_t rmt_isr_register(void (*fn)(void *), void *arg, int intr_alloc_flags, rmt_isr_handle_t *handle)
+{
+    board().rmt.interrupt = fn;
+    board().rmt.interruptArgument = arg;
+    return ESP_OK;
+}
+
+esp_err_t rmt_set_tx_thr_intr_en(rmt_channel_t channel, bool en, uint16_t evt_thresh)
+{
+    board().rmt.isThresholdInterruptEnabled = en;
+    board().rmt.threshold = evt_thresh;
+    return ESP_OK;
+}
+
+esp_err_t rmt_set_tx_intr_en(rmt_channel_t channel, bool en)
+{
+    board().rmt.isEndInterruptEnabled = en;
+    return ESP_OK;
+}
+
+esp_err_t rmt_fill_tx_items(rmt_channel_t channel, const rmt_item32_t *item, uint16_t item_num, uint16_t mem_offset)
+{
+    for (uint16_t i = 0u; (i < item_num) && (mem_offset + i < NativeArduino::RmtChannel::ITEMS); i++)
+    {
+        board().rmt.items[mem_offset + i] = item[i].val;
+    }
+    return ESP_OK;
+}
+
+esp_err_t rmt_tx_start(rmt_channel_t channel, bool tx_idx_rst)
+{
+    NativeArduino::RmtChannel &rmt = board().rmt;
+    if (tx_idx_rst)
+    {
+        rmt.readIndex = 0u;
+    }
+    rmt.itemsSinceThreshold = 0u;
+    rmt.itemStartNS = 1000u * simulatedTimeUS;
+    rmt.isRunning = true;
+    return ESP_OK;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+
+// Control over the simulated hardware of the native build.
+namespace NativeArduino
+{
+    static constexpr size_t PIN_COUNT{256u};
+
+    // RMT channel 0 of a board. While the simulated time advances, it sends the items of its channel RAM like the
+    // ESP32: it wraps around at the end, raises the threshold interrupt every threshold items and the end interrupt at
+    // an item with a zero duration.
+    struct RmtChannel
+    {
+        static constexpr size_t ITEMS{64u};
+
+        uint32_t items[ITEMS]{};
+        // Divider of the 80 MHz APB clock.
+        uint8_t clockDivider{80u};
+        bool isRunning{false};
+        size_t readIndex{0u};
+        // Simulated time at which the item at the read index started, in ns.
+        uint64_t itemStartNS{0u};
+        uint16_t threshold{0u};
+        bool isThresholdInterruptEnabled{false};
+        bool isEndInterruptEnabled{false};
+        size_t itemsSinceThreshold{0u};
+        void (*interrupt)(void *){nullptr};
+        void *interruptArgument{nullptr};
+        // Called for every rising edge of the output with its time in ns of the simulated time, e.g. to measure the
+        // intervals of the step pulses.
+        std::function<void(uint64_t timeNS)> onRisingEdge;
+    };
+
+    // Peripherals of one simulated ESP32. The benchmark only uses the default board, the desk simulator selects the
+    // board of a firmware before it runs code of that firmware. All boards share the simulated time, but each one may
+    // read it with an offset and a drift of its own.
+    struct Board
+    {
+        // Clock of micros() and millis() relative to the simulated time, like unsynchronized crystals.
+        int64_t clockOffsetUS{0};
+        double clockDriftPPM{0.0};
+        // The simulation spends no time on an I2C transfer, the board's clock does not read less than the end of its
+        // last one.
+        uint64_t busyUntilUS{0u};
+        uint8_t pinLevels[PIN_COUNT]{};
+        bool alarmEnabled{false};
+        uint64_t alarmValueUS{0u};
+        // Set by a task notification, the simulation decides when the notified task runs.
+        bool isNotified{false};
+        // 20 bit LOST_STEPS counter of the TMC2130 stand-in.
+        uint32_t driverLostSteps{0u};
+        // Called after an output pin was written, e.g. to count step pulses.
+        std::function<void(uint8_t pin, uint8_t value)> onPinWrite;
+        // Attached pin interrupts, the mode is RISING, FALLING or CHANGE.
+        void (*interruptCallbacks[PIN_COUNT])(void *){};
+        void *interruptArguments[PIN_COUNT]{};
+        uint8_t interruptModes[PIN_COUNT]{};
+        RmtChannel rmt;
+    };
+
+    // Simulated time in us since start, used by micros(), millis() and the hardware timer. It only advances if it is
+    // told to and by 1 us per read of the hardware timer, thus, the firmware sees almost no time passing while it
+    // computes.
+    uint64_t now();
+    // Also sends the RMT items of the current board that end meanwhile and runs their interrupts at their time.
+    void advance(const uint64_t durationUS);
+    // Sets the time back to zero, e.g. before the firmware is constructed again.
+    void resetTime();
+
+    void selectBoard(Board &board);
+    Board &currentBoard();
+
+    // Alarm of the hardware timer, the benchmark jumps to it to emulate the timer interrupt.
+    bool isAlarmEnabled();
+    uint64_t alarmTime();
+
+    // Returns true and clears the notification if a task of the current board was notified.
+    bool takeNotification();
+
+    // Level that digitalRead returns for an input pin, a change fires its interrupt.
+    void setInputLevel(const uint8_t pin, const uint8_t level);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <SPI.h>
+#include "NativeArduino.hpp"
+
+// Stand-in for the TMC2130 driver, configuration is ignored and the diagnostics report a healthy driver. Lost steps are
+// the ones the simulation counted up or down in the counter of the current board.
+class TMC2130Stepper
+{
+public:
+    TMC2130Stepper(uint16_t csPin, float rSense) {}
+
+    void begin() {}
+    void rms_current(uint16_t milliAmpere) {}
+    void en_pwm_mode(bool enable) {}
+    void pwm_autoscale(bool enable) {}
+    void microsteps(uint16_t steps) {}
+    void intpol(bool enable) {}
+    void TPWMTHRS(uint32_t value) {}
+    void THIGH(uint32_t value) {}
+    void vhighfs(bool enable) {}
+    void vhighchm(bool enable) {}
+    void VDCMIN(uint32_t value) {}
+    void dc_time(uint16_t value) {}
+    void dc_sg(uint8_t value) {}
+
+    uint8_t test_connection() { return 0u; }
+    uint32_t DRV_STATUS() { return 0u; }
+    uint32_t LOST_STEPS() { return NativeArduino::currentBoard().driverLostSteps & 0xFFFFFu; }
+    uint32_t TSTEP() { return 0xFFFFFu; }
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Slaves that the master side of a TwoWire talks to, e.g. the virtual bus of the desk simulator.
+class I2cBus
+{
+public:
+    virtual ~I2cBus() = default;
+
+    // Returns 0 on success or the error code of endTransmission(), e.g. 2 if no slave acknowledged the address.
+    virtual uint8_t transmit(const uint16_t address, const uint8_t *data, const size_t size) = 0;
+    // Returns the number of bytes the slave replied.
+    virtual size_t request(const uint16_t address, uint8_t *data, const size_t size) = 0;
+    // Clock of the master, ignored unless the bus models it.
+    virtual void setClock(const uint32_t frequencyHz) {}
+};
+
+// Stand-in for the I2C slave of the gearbox and the master of the general controller. The benchmark plays the general
+// controller: receive() hands bytes to the onReceive callback and request() collects the reply of the onRequest
+// callback. The master side only reaches slaves if a bus is attached.
+class TwoWire : public Stream
+{
+private:
+    static constexpr size_t BUFFER_SIZE{128u};
+
+    uint8_t rxBuffer[BUFFER_SIZE]{};
+    size_t rxLength{0u};
+    size_t rxIndex{0u};
+    uint8_t txBuffer[BUFFER_SIZE]{};
+    size_t txLength{0u};
+    void (*receiveCallback)(int){nullptr};
+    void (*requestCallback)(){nullptr};
+    I2cBus *bus{nullptr};
+    uint16_t transmissionAddress{0u};
+
+public:
+    bool begin(uint8_t address, int sda, int scl, uint32_t frequency) { return true; }
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0u)
+    {
+        if (frequency > 0u)
+        {
+            setClock(frequency);
+        }
+        return true;
+    }
+    bool setClock(uint32_t frequency)
+    {
+        if (bus != nullptr)
+        {
+            bus->setClock(frequency);
+        }
+        return true;
+    }
+    bool end() { return true; }
+    void setTimeOut(uint16_t timeOutMS) {}
+    void onReceive(void (*callback)(int)) { receiveCallback = callback; }
+    void onRequest(void (*callback)()) { requestCallback = callback; }
+
+    int available() override { return static_cast<int>(rxLength - rxIndex); }
+    int read() override { return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1; }
+    size_t write(uint8_t value) override
+    {
+        if (txLength >= BUFFER_SIZE)
+        {
+            return 0u;
+        }
+        txBuffer[txLength++] = value;
+        return 1u;
+    }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        const size_t count = min(size, BUFFER_SIZE - txLength);
+        memcpy(&txBuffer[txLength], buffer, count);
+        txLength += count;
+        return count;
+    }
+    using Print::write;
+
+    void attachBus(I2cBus *const newBus) { bus = newBus; }
+
+    void beginTransmission(uint16_t address)
+    {
+        transmissionAddress = address;
+        txLength = 0u;
+    }
+    uint8_t endTransmission(bool sendStop = true)
+    {
+        const size_t length = txLength;
+        txLength = 0u;
+        return bus != nullptr ? bus->transmit(transmissionAddress, txBuffer, length) : 0u;
+    }
+    size_t requestFrom(uint16_t address, size_t size, bool sendStop = true)
+    {
+        rxIndex = 0u;
+        rxLength = bus != nullptr ? bus->request(address, rxBuffer, min(size, BUFFER_SIZE)) : 0u;
+        return rxLength;
+    }
+
+    // Emulates a write of the master.
+    void receive(const uint8_t *data, const size_t size)
+    {
+        rxLength = min(size, BUFFER_SIZE);
+        rxIndex = 0u;
+        memcpy(rxBuffer, data, rxLength);
+        if (receiveCallback != nullptr)
+        {
+            receiveCallback(static_cast<int>(size));
+        }
+    }
+
+    // Emulates a read of the master, returns the number of bytes the slave replied.
+    size_t request(uint8_t *data, const size_t size)
+    {
+        txLength = 0u;
+        if (requestCallback != nullptr)
+        {
+            requestCallback();
+        }
+        const size_t count = min(size, txLength);
+        memcpy(data, txBuffer, count);
+        return count;
+    }
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Stand-in for the RMT driver of the ESP-IDF, the channel is modelled by NativeArduino. Only channel 0 exists.
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef int gpio_num_t;
+typedef void *rmt_isr_handle_t;
+
+typedef enum
+{
+    RMT_CHANNEL_0,
+    RMT_CHANNEL_MAX
+} rmt_channel_t;
+
+typedef enum
+{
+    RMT_MODE_TX,
+    RMT_MODE_RX
+} rmt_mode_t;
+
+typedef enum
+{
+    RMT_IDLE_LEVEL_LOW,
+    RMT_IDLE_LEVEL_HIGH
+} rmt_idle_level_t;
+
+typedef struct
+{
+    union
+    {
+        struct
+        {
+            uint32_t duration0 : 15;
+            uint32_t level0 : 1;
+            uint32_t duration1 : 15;
+            uint32_t level1 : 1;
+        };
+        uint32_t val;
+    };
+} rmt_item32_t;
+
+typedef struct
+{
+    bool carrier_en;
+    bool loop_en;
+    rmt_idle_level_t idle_level;
+    bool idle_output_en;
+} rmt_tx_config_t;
+
+typedef struct
+{
+    rmt_mode_t rmt_mode;
+    rmt_channel_t channel;
+    gpio_num_t gpio_num;
+    uint8_t clk_div;
+    uint8_t mem_block_num;
+    rmt_tx_config_t tx_config;
+} rmt_config_t;
+
+inline rmt_config_t rmtDefaultConfigTx(const gpio_num_t gpio, const rmt_channel_t channel)
+{
+    return rmt_config_t{RMT_MODE_TX, channel, gpio, 80u, 1u, rmt_tx_config_t{false, false, RMT_IDLE_LEVEL_LOW, true}};
+}
+#define RMT_DEFAULT_CONFIG_TX(gpio, channel_id) rmtDefaultConfigTx(gpio, channel_id)
+
+esp_err_t rmt_config(const rmt_config_t *config);
+esp_err_t rmt_isr_register(void (*fn)(void *), void *arg, int intr_alloc_flags, rmt_isr_handle_t *handle);
+esp_err_t rmt_set_tx_thr_intr_en(rmt_channel_t channel, bool en, uint16_t evt_thresh);
+esp_err_t rmt_set_tx_intr_en(rmt_channel_t channel, bool en);
+esp_err_t rmt_fill_tx_items(rmt_channel_t channel, const rmt_item32_t *item, uint16_t item_num, uint16_t mem_offset);
+esp_err_t rmt_tx_start(rmt_channel_t channel, bool tx_idx_rst);
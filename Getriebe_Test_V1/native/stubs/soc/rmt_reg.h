@@ -0,0 +1,7 @@
+#pragma once
+
+// Interrupt bits of RMT channel 0 as on the ESP32.
+#define RMT_CH0_TX_END_INT_ST (1u << 0)
+#define RMT_CH0_TX_END_INT_CLR (1u << 0)
+#define RMT_CH0_TX_THR_EVENT_INT_ST (1u << 24)
+#define RMT_CH0_TX_THR_EVENT_INT_CLR (1u << 24)
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+// The registers of the RMT that the firmware accesses directly. The channel model of NativeArduino sets the interrupt
+// status before it calls the interrupt and takes the bits written to the clear register afterwards.
+typedef struct
+{
+    union
+    {
+        struct
+        {
+            uint32_t fifo_mask : 1;
+            uint32_t mem_tx_wrap_en : 1;
+            uint32_t reserved2 : 30;
+        };
+        uint32_t val;
+    } apb_conf;
+    union
+    {
+        uint32_t val;
+    } int_st;
+    union
+    {
+        uint32_t val;
+    } int_clr;
+} rmt_dev_t;
+
+extern rmt_dev_t RMT;
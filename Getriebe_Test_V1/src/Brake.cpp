@@ -2,6 +2,8 @@
 
 #include "Brake.hpp"
 #include "Lightgate.hpp"
+#include "LogMessages.hpp"
+#include <DeferredLog.hpp>
 
 Brake::Brake(const int8_t dir, const uint8_t lightgateOpenPin, const uint8_t lightgateClosedPin, const uint8_t brakePin1, const uint8_t brakePin2, const uint8_t brakePin3, const uint8_t brakePin4) : lightgateOpen(lightgateOpenPin), lightgateClosed(lightgateClosedPin), stepper(AccelStepper::HALF4WIRE, brakePin1, brakePin3, brakePin2, brakePin4), targetPositionOpen(STEPS_TO_GO * dir), targetPositionClosed(-STEPS_TO_GO * dir)
 {
@@ -35,18 +37,33 @@ BrakeState Brake::getBrakeState() const
 void Brake::openBrake()
 {
     stepper.moveTo(targetPositionOpen);
-    Serial.print("Open Brake, Target position: ");
-    Serial.println(stepper.targetPosition());
+    DeferredLog::write(GearboxLog::OPEN_BRAKE, stepper.targetPosition());
 }
 
 void Brake::closeBrake()
 {
     stepper.moveTo(targetPositionClosed);
-    Serial.print("Close Brake, Target position: ");
-    Serial.println(stepper.targetPosition());
+    DeferredLog::write(GearboxLog::CLOSE_BRAKE, stepper.targetPosition());
 }
 
-void Brake::step()
+uint32_t Brake::step()
 {
+    const long lastPosition = stepper.currentPosition();
     stepper.run();
+    const unsigned long currentTimeUS = micros();
+    if (stepper.currentPosition() != lastPosition)
+    {
+        lastStepUS = currentTimeUS;
+    }
+
+    const float currentSpeed = fabs(stepper.speed());
+    if (currentSpeed == 0.0f)
+    {
+        // Target position reached.
+        return NO_STEP_DUE;
+    }
+
+    const unsigned long stepIntervalUS = static_cast<unsigned long>(1000000.0f / currentSpeed);
+    const unsigned long timeSinceLastStepUS = currentTimeUS - lastStepUS;
+    return timeSinceLastStepUS >= stepIntervalUS ? 0u : stepIntervalUS - timeSinceLastStepUS;
 }
\ No newline at end of file
@@ -19,6 +19,8 @@ private:
     const Lightgate lightgateClosed;
     const long targetPositionOpen;
     const long targetPositionClosed;
+    // Time of the last step, used to tell how long it takes till the next step is due.
+    unsigned long lastStepUS{0};
 
 public:
     static constexpr BrakeState BRAKE_STATE_LOCKED = 0;
@@ -26,6 +28,9 @@ public:
     static constexpr BrakeState BRAKE_STATE_UNLOCKED = 3;
     static constexpr BrakeState BRAKE_STATE_ERROR = 2;
 
+    // Returned by step() if the brake has no further step to do.
+    static constexpr uint32_t NO_STEP_DUE{UINT32_MAX};
+
     Brake(const int8_t dir, const uint8_t lightgateOpenPin, const uint8_t lightgateClosedPin, const uint8_t brakePin1, const uint8_t brakePin2, const uint8_t brakePin3, const uint8_t brakePin4);
     ~Brake() = default;
 
@@ -34,5 +39,6 @@ public:
     void openBrake();
     void closeBrake();
 
-    void step();
+    // Executes a step if one is due. Returns the time in us till the next step is due or NO_STEP_DUE if the brake is idle.
+    uint32_t step();
 };
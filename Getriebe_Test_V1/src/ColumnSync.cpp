@@ -0,0 +1,37 @@
+#include "ColumnSync.hpp"
+
+int32_t ColumnSync::update(const float error, const uint32_t commandedSpeed, const unsigned long nowUS)
+{
+    const unsigned long intervalUS = nowUS - lastUpdateUS;
+    const bool isContinued = isRunning && (intervalUS > 0u) && (intervalUS <= MAX_UPDATE_INTERVAL_US);
+    const float intervalS = isContinued ? static_cast<float>(intervalUS) / 1000000.0f : 0.0f;
+    const float derivative = isContinued ? (error - lastError) / intervalS : 0.0f;
+    if (!isContinued)
+    {
+        integral = 0.0f;
+    }
+    lastError = error;
+    lastUpdateUS = nowUS;
+    isRunning = true;
+
+    // An ahead column (positive error) has to slow down.
+    const float maxSlowDown = static_cast<float>(commandedSpeed > MIN_SPEED ? commandedSpeed - MIN_SPEED : 0u);
+    const float trim = -((KP * error) + (KI * (integral + (error * intervalS))) + (KD * derivative));
+    const float limitedTrim = constrain(trim, -maxSlowDown, static_cast<float>(MAX_SPEED_UP));
+
+    // Stop integrating while the trim is limited in the direction the error pushes it, otherwise, it winds up.
+    const bool isWindingUp = (trim != limitedTrim) && ((trim > limitedTrim) == (error < 0.0f));
+    if (!isWindingUp)
+    {
+        integral += error * intervalS;
+    }
+
+    return static_cast<int32_t>(lroundf(limitedTrim));
+}
+
+void ColumnSync::reset()
+{
+    integral = 0.0f;
+    lastError = 0.0f;
+    isRunning = false;
+}
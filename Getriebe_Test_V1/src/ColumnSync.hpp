@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Keeps the column of this gearbox in step with the column of the other gearbox. A PID controller on the position error
+// trims the max speed of the motor, both gearboxes get the same commanded speed, which is the feed-forward of the loop.
+// The column that is ahead slows down and the one that lags speeds up a bit, thus, the columns stay close together
+// during the whole move instead of only being stopped once they are far apart.
+class ColumnSync
+{
+private:
+    // Gains per step of error, the proportional term reacts within the S-curve of the motor, the integral term removes
+    // the error that a constant load difference leaves behind.
+    static constexpr float KP{1.0f};  // (steps/s) / step
+    static constexpr float KI{0.1f};  // (steps/s) / (step * s)
+    static constexpr float KD{0.0f};  // (steps/s) / (step/s)
+    // The lagging column only gets a bit faster than the commanded speed, the leading one may slow down to a crawl.
+    static constexpr int32_t MAX_SPEED_UP{150};
+    static constexpr uint32_t MIN_SPEED{100u};
+    // Updates further apart belong to different moves, the controller starts over then.
+    static constexpr unsigned long MAX_UPDATE_INTERVAL_US{100000u};
+
+    float integral{0.0f};
+    float lastError{0.0f};
+    unsigned long lastUpdateUS{0u};
+    bool isRunning{false};
+
+public:
+    ColumnSync() = default;
+    ~ColumnSync() = default;
+
+    // Returns the trim in steps/s that is added to the commanded speed. The error is positive if this column is ahead
+    // of the other one in the direction of the move.
+    int32_t update(const float error, const uint32_t commandedSpeed, const unsigned long nowUS);
+    void reset();
+};
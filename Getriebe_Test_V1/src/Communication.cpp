@@ -2,6 +2,10 @@
 #include "Gearbox.hpp"
 #include "Pinout.hpp"
 #include "Brake.hpp"
+#include "MotorTimer.hpp"
+#include "LogMessages.hpp"
+#include "SyncedClock.hpp"
+#include <DeferredLog.hpp>
 
 Communication *Communication::instance;
 
@@ -20,6 +24,15 @@ Communication::Communication(float gearboxSensorHeight, float gearboxMathematica
                  { Communication::instance->genCtrlOnReceiveI2C(numBytes); });
   Wire.onRequest([]()
                  { Communication::instance->genCtrlOnRequestI2C(); });
+
+#ifdef GEARBOX_ATTENTION_LINE
+  digitalWrite(ATTENTION_LINE_PIN, HIGH);
+  pinMode(ATTENTION_LINE_PIN, OUTPUT);
+#endif
+  // Requests can arrive before the motor task is running.
+  publishStatus(readStatus(), gearbox.getDeskMotor()->getDriverStatus().hasFault());
+  // Leaves syncedMicros() at the local clock till the first time sync.
+  SyncedClock::publish(clockSync.getMapping());
 }
 
 void Communication::performMoveTo(const long targetPosition)
@@ -28,20 +41,23 @@ void Communication::performMoveTo(const long targetPosition)
   gearbox.startMotor();
 }
 
-void Communication::performMoveUp(uint32_t penalty)
+void Communication::performMoveUp()
 {
   gearbox.startMotor();
-  gearbox.moveUp(penalty);
+  gearbox.moveUp();
 }
 
-void Communication::performMoveDown(uint32_t penalty)
+void Communication::performMoveDown()
 {
   gearbox.startMotor();
-  gearbox.moveDown(penalty);
+  gearbox.moveDown();
 }
 
 void Communication::performEmergencyStop()
 {
+  endJog();
+  endSegment();
+  stopSynchronization();
   gearbox.stopMotor();
 }
 
@@ -55,300 +71,635 @@ void Communication::performFastenBrake()
   gearbox.fastenBrakes();
 }
 
-void Communication::performToggleMotorControl()
+void Communication::performToggleMotorControl(const bool enable)
 {
-  const bool enable = i2cData[5u] == 1;
-  Serial.print("Toggle motor control: ");
-  Serial.println(enable ? "true" : "false");
+  DeferredLog::write(GearboxLog::TOGGLE_MOTOR_CONTROL, enable);
   gearbox.toggleMotorControl(enable);
 }
 
-void Communication::performToggleMotorControlPower()
+void Communication::performToggleMotorControlPower(const bool enable)
 {
-  const bool enable = i2cData[5u] == 1;
-  Serial.print("Toggle motor control power: ");
-  Serial.println(enable ? "true" : "false");
+  DeferredLog::write(GearboxLog::TOGGLE_MOTOR_CONTROL_POWER, enable);
   gearbox.toggleMotorControlPower(enable);
 }
 
-bool Communication::checkForGearboxDeviation(uint32_t currentPosition)
+bool Communication::checkForGearboxDeviation(const float otherPosition)
 {
-  const bool tooHigh = currentPosition > (otherGearboxPosition + MAX_GEARBOX_DEVIATION);
-  const bool tooLow = otherGearboxPosition > (currentPosition + MAX_GEARBOX_DEVIATION);
-  if (tooHigh || tooLow)
+  const float deviation = static_cast<float>(currentPosition) - otherPosition;
+  if (fabsf(deviation) > static_cast<float>(MAX_GEARBOX_DEVIATION))
   {
+#ifdef EMERGENCY_STOP_LINE
+    emergencyStopLine.pull();
+#endif
     performEmergencyStop();
+    raiseEvents(GearboxProtocol::EVENT_DEVIATION_LIMIT);
     return false;
   }
 
   return true;
 }
 
-uint32_t Communication::calculateCorrection(uint32_t deviation)
+float Communication::estimateOtherGearboxPosition(const I2cCommand &command) const
+{
+  const GearboxProtocol::Motion &other = command.frame.peer;
+  // The command waited in the mailbox since it was received.
+  const float totalAgeS = static_cast<float>(other.ageUS + (micros() - command.receivedUS)) / 1000000.0f;
+  return static_cast<float>(other.position) + (static_cast<float>(other.speed) * totalAgeS);
+}
+
+void Communication::synchronizeColumns(const float otherPosition, const int8_t direction)
+{
+  const float error = (static_cast<float>(gearbox.getCurrentPosition()) - otherPosition) * direction;
+  const int32_t speedTrim = columnSync.update(error, gearbox.getCommandedSpeed(), micros());
+  gearbox.setSpeedTrim(speedTrim);
+
+  if (abs(speedTrim - lastLoggedSpeedTrim) >= SPEED_TRIM_LOG_STEP)
+  {
+    DeferredLog::write(GearboxLog::SPEED_TRIM, static_cast<int32_t>(lroundf(error)), speedTrim);
+    lastLoggedSpeedTrim = speedTrim;
+  }
+}
+
+bool Communication::isOtherGearboxReversing(const I2cCommand &command, const int8_t direction)
 {
-  const float correction = static_cast<float>(deviation - MAX_SOFT_GEARBOX_DEVIATION) / static_cast<float>(MAX_GEARBOX_DEVIATION - MAX_SOFT_GEARBOX_DEVIATION) * MAX_GEARBOX_DEVIATION;
-  const uint32_t iCorrection = static_cast<uint32_t>(round(correction));
-  return iCorrection;
+  return (gearbox.getCurrentSpeed() == 0) && ((command.frame.peer.speed * direction) < 0);
+}
+
+void Communication::stopSynchronization()
+{
+  columnSync.reset();
+  gearbox.setSpeedTrim(0);
+  lastLoggedSpeedTrim = 0;
 }
 
 void Communication::genCtrlOnReceiveI2C(int numBytes)
 {
-  readAllI2cData = false;
+  // Only decode the command, it is executed by the motor task. Broadcasts to both gearboxes arrive here as well.
+  I2cCommand command{};
+  command.receivedUS = micros();
+  uint8_t data[GearboxProtocol::MAX_COMMAND_LENGTH]{0u};
+  size_t length{0u};
+  while (Wire.available() > 0)
+  {
+    const int value = Wire.read();
+    // Bytes that do not fit into the buffer are only counted.
+    if (length < GearboxProtocol::MAX_COMMAND_LENGTH)
+    {
+      data[length] = static_cast<uint8_t>(value);
+    }
+    length++;
+  }
 
-  i2cDataLength = numBytes;
-  for (size_t index = 0u; index < numBytes; index++)
+  if (length == 0u)
   {
-    i2cData[index] = Wire.read();
+    return;
+  }
+
+  const GearboxProtocol::DecodeResult result = (length <= GearboxProtocol::MAX_COMMAND_LENGTH) ? GearboxProtocol::decodeCommand(data, length, command.frame, IS_LEFT_GEARBOX) : GearboxProtocol::DecodeResult::WrongLength;
+  if (result != GearboxProtocol::DecodeResult::Ok)
+  {
+    lastRejectReason = static_cast<uint8_t>(result);
+    rejectedFrames.fetch_add(1u);
+    isCommandLost = true;
+    return;
+  }
+  if (command.frame.code == GearboxProtocol::CMD_TIME_SYNC)
+  {
+    // Handled right here, the reply has to be ready for the read that follows.
+    receiveTimeSync(command);
+    return;
   }
 
-  readAllI2cData = true;
+  if (commandMailbox.push(command))
+  {
+    lastAcceptedSequence = command.frame.sequence;
+    MotorTimer::wake();
+  }
+  else
+  {
+    droppedCommands.fetch_add(1u);
+    isCommandLost = true;
+  }
 }
 
 void Communication::genCtrlOnRequestI2C()
 {
-  if (!readAllI2cData)
+  if (isTimeSyncReplyPending)
+  {
+    isTimeSyncReplyPending = false;
+    sendTimeSyncReply();
+    return;
+  }
+  sendDefaultReturnState();
+}
+
+void Communication::receiveTimeSync(const I2cCommand &command)
+{
+  // The command carries the times of the controller for the previous exchange, which completes it.
+  const GearboxProtocol::Command &frame = command.frame;
+  if (lastTimeSync.isReplied && (frame.previousSyncSequence == lastTimeSync.sequence))
+  {
+    const ClockSync::Sample sample{frame.previousSyncWrittenUS, lastTimeSync.receivedUS, lastTimeSync.repliedUS, frame.previousSyncReadUS};
+    timeSyncSamples.push(sample);
+    // The motor task feeds it into the estimate, it does not wake on its own while the desk is parked.
+    MotorTimer::wake();
+  }
+
+  lastTimeSync.sequence = frame.sequence;
+  lastTimeSync.receivedUS = static_cast<uint32_t>(command.receivedUS);
+  lastTimeSync.isReplied = false;
+  lastAcceptedSequence = frame.sequence;
+  isTimeSyncReplyPending = true;
+#ifdef GEARBOX_ATTENTION_LINE
+  // The read of the time sync usually started before the command arrived, the reply waits for the next one.
+  digitalWrite(ATTENTION_LINE_PIN, LOW);
+#endif
+}
+
+void Communication::sendTimeSyncReply()
+{
+  GearboxProtocol::TimeSyncReply reply{};
+  reply.sequence = lastTimeSync.sequence;
+  reply.receivedUS = lastTimeSync.receivedUS;
+  reply.repliedUS = static_cast<uint32_t>(micros());
+  lastTimeSync.repliedUS = reply.repliedUS;
+  lastTimeSync.isReplied = true;
+#ifdef GEARBOX_ATTENTION_LINE
+  digitalWrite(ATTENTION_LINE_PIN, HIGH);
+  if (pendingEvents.load() != 0u)
+  {
+    digitalWrite(ATTENTION_LINE_PIN, LOW);
+  }
+#endif
+
+  uint8_t data[GearboxProtocol::TIME_SYNC_REPLY_LENGTH]{0u};
+  GearboxProtocol::encodeTimeSyncReply(reply, data);
+  size_t bytesWritten{0u};
+  while (bytesWritten < GearboxProtocol::TIME_SYNC_REPLY_LENGTH)
+  {
+    bytesWritten += Wire.write(&(data[bytesWritten]), GearboxProtocol::TIME_SYNC_REPLY_LENGTH - bytesWritten);
+  }
+}
+
+void Communication::updateClockSync()
+{
+  ClockSync::Sample sample{};
+  bool isUpdated{false};
+  while (timeSyncSamples.pop(sample))
+  {
+    isUpdated |= clockSync.update(sample);
+  }
+  if (!isUpdated)
+  {
+    return;
+  }
+  const ClockSync::Mapping &mapping = clockSync.getMapping();
+  SyncedClock::publish(mapping);
+
+  const unsigned long currentTimeUS = micros();
+  if ((mapping.isSynchronized != wasClockSynchronized) || (currentTimeUS - lastClockSyncLogUS >= CLOCK_SYNC_LOG_INTERVAL_US))
+  {
+    DeferredLog::write(GearboxLog::CLOCK_SYNC, mapping.isSynchronized, clockSync.getLastErrorUS(), clockSync.getLastRoundTripUS(), mapping.driftPPM);
+    wasClockSynchronized = mapping.isSynchronized;
+    lastClockSyncLogUS = currentTimeUS;
+  }
+}
+
+uint32_t Communication::processCommands()
+{
+  const uint32_t dropped = droppedCommands.exchange(0u);
+  if (dropped > 0u)
+  {
+    DeferredLog::write(GearboxLog::MAILBOX_FULL, dropped);
+  }
+  const uint32_t rejected = rejectedFrames.exchange(0u);
+  if (rejected > 0u)
+  {
+    DeferredLog::write(GearboxLog::REJECTED_FRAMES, rejected, lastRejectReason.load());
+  }
+
+  I2cCommand command{};
+  bool executedCommand{false};
+  while (commandMailbox.pop(command))
+  {
+    executeCommand(command);
+    executedCommand = true;
+  }
+  uint32_t cycleDueUS = continueJog();
+  updateClockSync();
+#ifdef EMERGENCY_STOP_LINE
+  // Checked after the commands, such that none that waited in the mailbox moves the motor that the ISR stopped.
+  if (emergencyStopLine.takeTrigger())
+  {
+    DeferredLog::write(GearboxLog::EMERGENCY_STOP_LINE_PULLED);
+    performEmergencyStop();
+  }
+  emergencyStopLine.update();
+  if (emergencyStopLine.isPulled())
+  {
+    cycleDueUS = min(cycleDueUS, emergencyStopLine.getReleaseDelayUS());
+  }
+#endif
+
+  // A parked desk does not change its status, thus, the task does not have to wake for it.
+  const GearboxProtocol::Status status = readStatus();
+  const bool isDriverFaulty = gearbox.getDeskMotor()->getDriverStatus().hasFault();
+  const bool hasStatusChanged = (status.motion.position != lastPublishedStatus.motion.position) || (status.motion.speed != lastPublishedStatus.motion.speed) ||
+                                (status.brakeState != lastPublishedStatus.brakeState) || (status.skippedSteps != lastPublishedStatus.skippedSteps) ||
+                                (status.flags != lastPublishedStatus.flags) || (isDriverFaulty != wasDriverFaulty);
+  const unsigned long sincePublishUS = micros() - lastStatusPublishUS;
+  if (executedCommand || (hasStatusChanged && (sincePublishUS >= STATUS_PUBLISH_INTERVAL_US)))
+  {
+    lastStatusPublishUS = micros();
+    publishStatus(status, isDriverFaulty);
+  }
+  else if (hasStatusChanged)
+  {
+    cycleDueUS = min(cycleDueUS, static_cast<uint32_t>(STATUS_PUBLISH_INTERVAL_US - sincePublishUS));
+  }
+  return cycleDueUS;
+}
+
+GearboxProtocol::Status Communication::readStatus()
+{
+  // Current position, speed and brake state, the sequence and the age are added by the request handler.
+  GearboxProtocol::Status status{};
+  status.motion.position = gearbox.getCurrentPosition();
+  status.motion.speed = static_cast<int16_t>(constrain(gearbox.getCurrentSpeed(), INT16_MIN, INT16_MAX));
+  status.brakeState = gearbox.getCurrentBrakeState();
+  status.skippedSteps = static_cast<uint16_t>(gearbox.getSkippedSteps());
+  status.flags |= (status.motion.speed != 0) ? GearboxProtocol::FLAG_MOVING : 0u;
+  status.flags |= gearbox.isMotorControlEnabled() ? GearboxProtocol::FLAG_MOTOR_CONTROL : 0u;
+  status.flags |= gearbox.isMotorControlPowered() ? GearboxProtocol::FLAG_MOTOR_CONTROL_POWER : 0u;
+  status.flags |= SyncedClock::isSynchronized() ? GearboxProtocol::FLAG_CLOCK_SYNCHRONIZED : 0u;
+  status.flags |= (segmentDirection != 0) ? GearboxProtocol::FLAG_SEGMENT_ACTIVE : 0u;
+  return status;
+}
+
+void Communication::publishStatus(const GearboxProtocol::Status &status, const bool isDriverFaulty)
+{
+  StatusReply reply{};
+  reply.status = status;
+  reply.publishedUS = micros();
+  statusSnapshot.publish(reply);
+
+  const bool isMoving = (status.flags & GearboxProtocol::FLAG_MOVING) != 0u;
+  const bool wasMoving = (lastPublishedStatus.flags & GearboxProtocol::FLAG_MOVING) != 0u;
+  uint8_t events{0u};
+  events |= (isMoving && !wasMoving) ? GearboxProtocol::EVENT_MOTION_STARTED : 0u;
+  events |= (!isMoving && wasMoving) ? GearboxProtocol::EVENT_MOTION_STOPPED : 0u;
+  events |= (status.skippedSteps != lastPublishedStatus.skippedSteps) ? GearboxProtocol::EVENT_STALL : 0u;
+  events |= (status.brakeState != lastPublishedStatus.brakeState) ? GearboxProtocol::EVENT_BRAKE_CHANGED : 0u;
+  events |= (isDriverFaulty && !wasDriverFaulty) ? GearboxProtocol::EVENT_DRIVER_FAULT : 0u;
+  lastPublishedStatus = status;
+  wasDriverFaulty = isDriverFaulty;
+  raiseEvents(events);
+}
+
+void Communication::raiseEvents(const uint8_t events)
+{
+  if (events == 0u)
   {
-    Serial.println("Has not yet read all i2c data.");
     return;
   }
+  pendingEvents.fetch_or(events);
+#ifdef GEARBOX_ATTENTION_LINE
+  digitalWrite(ATTENTION_LINE_PIN, LOW);
+#endif
+}
+
+void Communication::executeCommand(const I2cCommand &command)
+{
+  // Any other command takes over from a jog, the motor stops within the last extension of its target.
+  if (command.frame.code != GearboxProtocol::CMD_JOG)
+  {
+    endJog();
+  }
+  // A segment runs on while the controller polls the status, any other command takes over from it.
+  if ((command.frame.code != GearboxProtocol::CMD_SEGMENT) && (command.frame.code != GearboxProtocol::CMD_GET_POSITION))
+  {
+    endSegment();
+  }
 
   // Handle commands.
-  switch (i2cData[0])
+  switch (command.frame.code)
   {
-  case CMD_MOVE_UP:
-    genCtrlMoveUp();
+  case GearboxProtocol::CMD_MOVE_UP:
+    genCtrlMoveUp(command);
+    break;
+  case GearboxProtocol::CMD_MOVE_DOWN:
+    genCtrlMoveDown(command);
+    break;
+  case GearboxProtocol::CMD_MOVE_TO:
+    genCtrlMoveTo(command);
     break;
-  case CMD_MOVE_DOWN:
-    genCtrlMoveDown();
+  case GearboxProtocol::CMD_JOG:
+    genCtrlJog(command);
     break;
-  case CMD_MOVE_TO:
-    genCtrlMoveTo();
+  case GearboxProtocol::CMD_SEGMENT:
+    genCtrlSegment(command);
     break;
-  case CMD_EMERGENCY_STOP:
-    genCtrlEmergencyStop();
+  case GearboxProtocol::CMD_EMERGENCY_STOP:
+    genCtrlEmergencyStop(command);
     break;
-  case CMD_GET_POSITION:
-    genCtrlGetPosition();
+  case GearboxProtocol::CMD_GET_POSITION:
+    genCtrlGetPosition(command);
     break;
-  case CMD_LOOSEN_BRAKE:
-    genCtrlLoosenBrake();
+  case GearboxProtocol::CMD_LOOSEN_BRAKE:
+    genCtrlLoosenBrake(command);
     break;
-  case CMD_FASTEN_BRAKE:
-    genCtrlFastenBrake();
+  case GearboxProtocol::CMD_FASTEN_BRAKE:
+    genCtrlFastenBrake(command);
     break;
-  case CMD_TOGGLE_MOTOR_CONTROL:
-    genCtrlToggleMotorControl();
+  case GearboxProtocol::CMD_TOGGLE_MOTOR_CONTROL:
+    genCtrlToggleMotorControl(command);
     break;
-  case CMD_TOGGLE_MOTOR_CONTROL_POWER:
-    genCtrlToggleMotorControlPower();
+  case GearboxProtocol::CMD_TOGGLE_MOTOR_CONTROL_POWER:
+    genCtrlToggleMotorControlPower(command);
     break;
   default:
-    Serial.println("Unknown i2c command");
+    DeferredLog::write(GearboxLog::UNKNOWN_COMMAND, command.frame.code);
     break;
   }
-
-  static uint32_t iteration{0u};
-  if (iteration % 200u == 0u)
-  {
-    Serial.print("Current skipped steps: ");
-    Serial.println(gearbox.getDeskMotor()->hwReadSkippedSteps());
-  }
-  iteration++;
-
-  // Serial.print("Brake State: ");
-  // // Print name of brake state.
-  // switch (gearbox.getCurrentBrakeState())
-  // {
-  // case Brake::BRAKE_STATE_LOCKED:
-  //   Serial.println("CLOSED");
-  //   break;
-  // case Brake::BRAKE_STATE_UNLOCKED:
-  //   Serial.println("OPEN");
-  //   break;
-  // case Brake::BRAKE_STATE_INTERMEDIARY:
-  //   Serial.println("INTERMEDIATE");
-  //   break;
-  // case Brake::BRAKE_STATE_ERROR:
-  //   Serial.println("ERROR");
-  //   break;
-  // default:
-  //   Serial.println("UNKNOWN");
-  //   break;
-  // }
 }
 
 void Communication::sendDefaultReturnState()
 {
-  constexpr size_t RESPONSE_LENGTH{5u};
-  // Send current position and brake state as response.
-  currentPosition = gearbox.getCurrentPosition();
-  uint8_t data[RESPONSE_LENGTH]{0u};
-  memcpy(&(data[0u]), &currentPosition, 4u);
-  data[4u] = gearbox.getCurrentBrakeState();
-
+  // Send the last published status as response, together with its age and the sequence of the last command.
+  StatusReply reply{};
+  statusSnapshot.read(reply);
+  GearboxProtocol::Status &status = reply.status;
+  status.motion.ageUS = static_cast<uint16_t>(min(micros() - reply.publishedUS, static_cast<unsigned long>(UINT16_MAX)));
+  status.sequence = lastAcceptedSequence.load();
+  status.flags |= isCommandLost.exchange(false) ? GearboxProtocol::FLAG_COMMAND_LOST : 0u;
+#ifdef GEARBOX_ATTENTION_LINE
+  // Released before the events are taken, an event that is raised in between pulls the line again.
+  digitalWrite(ATTENTION_LINE_PIN, HIGH);
+#endif
+  status.events = pendingEvents.exchange(0u);
+
+  uint8_t data[GearboxProtocol::STATUS_LENGTH]{0u};
+  GearboxProtocol::encodeStatus(status, data);
   size_t bytesWritten{0u};
-  while (bytesWritten < RESPONSE_LENGTH)
+  while (bytesWritten < GearboxProtocol::STATUS_LENGTH)
   {
-    bytesWritten += Wire.write(&(data[bytesWritten]), RESPONSE_LENGTH - bytesWritten);
+    bytesWritten += Wire.write(&(data[bytesWritten]), GearboxProtocol::STATUS_LENGTH - bytesWritten);
   }
 }
 
-void Communication::genCtrlMoveUp()
+void Communication::genCtrlMoveUp(const I2cCommand &command)
 {
-  sendDefaultReturnState();
+  currentPosition = gearbox.getCurrentPosition();
 
   // Get position of other gearbox from i2c data.
-  memcpy(&otherGearboxPosition, &(i2cData[1u]), 4u);
+  otherGearboxPosition = command.frame.peer.position;
+  const float otherPosition = estimateOtherGearboxPosition(command);
 
   // TODO DEBUGGING ONLY
   static int32_t lastDeviation{0u};
-  const int32_t deviation = static_cast<int32_t>(currentPosition) - static_cast<int32_t>(otherGearboxPosition);
+  const int32_t deviation = static_cast<int32_t>(lroundf(static_cast<float>(currentPosition) - otherPosition));
   if (lastDeviation != deviation)
   {
-    Serial.print("MoveUp: Deviation is ");
-    Serial.println(deviation);
+    DeferredLog::write(GearboxLog::MOVE_UP_DEVIATION, deviation);
     lastDeviation = deviation;
   }
 
-  // Compare this gearbox's current target position with the other gearbox's current target position.
+  // Compare this gearbox's current position with the position the other gearbox has at the same time.
   // If the deviation is larger than the hard limit, stop the movement.
-  if (!checkForGearboxDeviation(currentPosition))
+  if (!checkForGearboxDeviation(otherPosition))
   {
     // Deviation is too large, emergency stop applied.
-    Serial.println("MoveUp: Emergency stop applied due to deviation.");
+    DeferredLog::write(GearboxLog::MOVE_UP_EMERGENCY_STOP);
     return;
   }
 
-  // If the deviation is larger than the soft limit and this gearbox is ahead of the other, subtract the difference from the current target position.
-  if (currentPosition > (otherGearboxPosition + MAX_SOFT_GEARBOX_DEVIATION))
-  {
-    const uint32_t deviation = currentPosition - otherGearboxPosition;
-    const uint32_t correction = calculateCorrection(deviation);
-    Serial.print("MoveUp Soft Limit: Correction is ");
-    Serial.println(correction);
-    // Add argument to moveUp function specifying the distance to subtract from the current target position.
-    performMoveUp(correction);
-  }
-  else
+  if (isOtherGearboxReversing(command, 1))
   {
-    // Gearboxes are close enough to each other, continue normally.
-    performMoveUp(0u);
+    return;
   }
+  // Keep up with the other gearbox while moving.
+  synchronizeColumns(otherPosition, 1);
+  performMoveUp();
 }
 
-void Communication::genCtrlMoveDown()
+void Communication::genCtrlMoveDown(const I2cCommand &command)
 {
-  sendDefaultReturnState();
+  currentPosition = gearbox.getCurrentPosition();
 
   // Get position of other gearbox from i2c data.
-  memcpy(&otherGearboxPosition, &(i2cData[1u]), 4u);
+  otherGearboxPosition = command.frame.peer.position;
+  const float otherPosition = estimateOtherGearboxPosition(command);
 
-  // Compare this gearbox's current target position with the other gearbox's current target position.
+  // Compare this gearbox's current position with the position the other gearbox has at the same time.
   // If the deviation is larger than the hard limit, stop the movement.
-  if (!checkForGearboxDeviation(currentPosition))
+  if (!checkForGearboxDeviation(otherPosition))
   {
     // Deviation is too large, emergency stop applied.
-    Serial.println("MoveDown: Emergency stop applied due to deviation.");
+    DeferredLog::write(GearboxLog::MOVE_DOWN_EMERGENCY_STOP);
     return;
   }
-  // If the deviation is larger than the soft limit and this gearbox is ahead of the other, subtract the difference from the current target position.
-  if (otherGearboxPosition > (currentPosition + MAX_SOFT_GEARBOX_DEVIATION))
-  {
-    const uint32_t deviation = otherGearboxPosition - currentPosition;
-    const uint32_t correction = calculateCorrection(deviation);
-    // Add argument to moveDown function specifying the distance to subtract from the current target position.
-    Serial.print("MoveDown Soft Limit: Correction is ");
-    Serial.println(correction);
-    performMoveDown(correction);
-  }
-  else
+  if (isOtherGearboxReversing(command, -1))
   {
-    // Gearboxes are close enough to each other, continue normally.
-    performMoveDown(0u);
+    return;
   }
+  // Keep up with the other gearbox while moving.
+  synchronizeColumns(otherPosition, -1);
+  performMoveDown();
 }
 
-void Communication::genCtrlMoveTo()
+void Communication::genCtrlMoveTo(const I2cCommand &command)
 {
-  sendDefaultReturnState();
+  currentPosition = gearbox.getCurrentPosition();
 
   // Get position of other gearbox from i2c data.
-  memcpy(&otherGearboxPosition, &(i2cData[1u]), 4u);
-  uint32_t targetPosition{0u};
+  otherGearboxPosition = command.frame.peer.position;
   // Get target position from i2c data.
-  memcpy(&targetPosition, &(i2cData[5u]), 4u);
+  const uint32_t targetPosition = command.frame.targetPosition;
+  const float otherPosition = estimateOtherGearboxPosition(command);
 
   // TODO DEBUGGING ONLY
   static int32_t lastDeviation{0u};
-  const int32_t deviation = static_cast<int32_t>(currentPosition) - static_cast<int32_t>(otherGearboxPosition);
+  const int32_t deviation = static_cast<int32_t>(lroundf(static_cast<float>(currentPosition) - otherPosition));
   if (lastDeviation != deviation)
   {
-    Serial.print("MoveTo: Deviation is ");
-    Serial.println(deviation);
+    DeferredLog::write(GearboxLog::MOVE_TO_DEVIATION, deviation);
     lastDeviation = deviation;
   }
   // Check that current position is not too far away from current position of other gearbox.
-  // TODO If current position is ahead of other gearbox, try to throttle the movement a bit. (Probably not necessary, just stop if too far away.)
-  if ((currentPosition > (otherGearboxPosition + MAX_GEARBOX_DEVIATION)) || (otherGearboxPosition > (currentPosition + MAX_GEARBOX_DEVIATION)))
+  if (!checkForGearboxDeviation(otherPosition))
   {
-    Serial.println("I2C moveTo: Too far away from other gearbox, stopping.");
-    performEmergencyStop();
+    DeferredLog::write(GearboxLog::MOVE_TO_TOO_FAR);
   }
   else
   {
+    // Keep up with the other gearbox on the way to the target.
+    const int8_t direction = (targetPosition >= currentPosition) ? 1 : -1;
+    synchronizeColumns(otherPosition, direction);
     performMoveTo(targetPosition);
   }
 }
 
-void Communication::genCtrlEmergencyStop()
+void Communication::genCtrlJog(const I2cCommand &command)
 {
-  sendDefaultReturnState();
+  const int8_t direction = (command.frame.jogDirection >= 0) ? 1 : -1;
+  if (command.frame.leaseMS == 0u)
+  {
+    endJog();
+    return;
+  }
 
-  Serial.println("I2C emergencyStop");
-  performEmergencyStop();
+  currentPosition = gearbox.getCurrentPosition();
+  otherGearboxPosition = command.frame.peer.position;
+  const float otherPosition = estimateOtherGearboxPosition(command);
+  if (!checkForGearboxDeviation(otherPosition))
+  {
+    // Deviation is too large, emergency stop applied.
+    DeferredLog::write(direction > 0 ? GearboxLog::MOVE_UP_EMERGENCY_STOP : GearboxLog::MOVE_DOWN_EMERGENCY_STOP);
+    return;
+  }
+  if (isOtherGearboxReversing(command, direction))
+  {
+    return;
+  }
+
+  // The lease counts from the reception, the command may have waited in the mailbox.
+  jogDirection = direction;
+  jogLeaseEndUS = command.receivedUS + (1000u * static_cast<unsigned long>(command.frame.leaseMS));
+  gearbox.setSpeedLimit(command.frame.jogSpeed);
+  synchronizeColumns(otherPosition, direction);
+  lastJogExtensionUS = micros();
+  direction > 0 ? performMoveUp() : performMoveDown();
 }
 
-void Communication::genCtrlGetPosition()
+uint32_t Communication::continueJog()
 {
-  sendDefaultReturnState();
+  if (jogDirection == 0)
+  {
+    return MotorTimer::NO_CYCLE_DUE;
+  }
 
-  // Get position of other gearbox from i2c data.
-  memcpy(&otherGearboxPosition, &(i2cData[1]), 4u);
+  const unsigned long currentTimeUS = micros();
+  if (static_cast<long>(currentTimeUS - jogLeaseEndUS) >= 0)
+  {
+    DeferredLog::write(GearboxLog::JOG_LEASE_EXPIRED);
+    endJog();
+    return MotorTimer::NO_CYCLE_DUE;
+  }
+  // Only a command starts the motor, which checks that the other gearbox does not reverse anymore.
+  const bool isMovingInJogDirection = (gearbox.getCurrentSpeed() * jogDirection) > 0;
+  if (isMovingInJogDirection && (currentTimeUS - lastJogExtensionUS >= JOG_EXTENSION_INTERVAL_US))
+  {
+    lastJogExtensionUS = currentTimeUS;
+    jogDirection > 0 ? performMoveUp() : performMoveDown();
+  }
+  // Only a jog with a valid lease asks for a timed wake, for the next extension or the end of the lease.
+  const unsigned long sinceExtensionUS = currentTimeUS - lastJogExtensionUS;
+  const unsigned long nextExtensionUS = (sinceExtensionUS < JOG_EXTENSION_INTERVAL_US) ? (JOG_EXTENSION_INTERVAL_US - sinceExtensionUS) : JOG_EXTENSION_INTERVAL_US;
+  return static_cast<uint32_t>(min(nextExtensionUS, jogLeaseEndUS - currentTimeUS));
 }
 
-void Communication::genCtrlLoosenBrake()
+void Communication::endJog()
 {
-  sendDefaultReturnState();
+  if (jogDirection == 0)
+  {
+    return;
+  }
+  jogDirection = 0;
+  gearbox.setSpeedLimit(0u);
+}
 
-  // Get position of other gearbox from i2c data.
-  memcpy(&otherGearboxPosition, &(i2cData[1u]), 4u);
-  performLoosenBrake();
+void Communication::genCtrlSegment(const I2cCommand &command)
+{
+  currentPosition = gearbox.getCurrentPosition();
+  otherGearboxPosition = command.frame.peer.position;
+  const uint32_t targetPosition = command.frame.targetPosition;
+  const float otherPosition = estimateOtherGearboxPosition(command);
+  if (!checkForGearboxDeviation(otherPosition))
+  {
+    DeferredLog::write(GearboxLog::MOVE_TO_TOO_FAR);
+    return;
+  }
+
+  // Both gearboxes start at the same time on the clock of the controller and plan the same profile from it, thus, the
+  // columns follow the same position over time. Till both clocks are synchronized, the start counts from the reception,
+  // a broadcast reaches both gearboxes with the same bus edge.
+  const ClockSync::Mapping mapping = SyncedClock::getMapping();
+  const bool isStartSynchronized = command.frame.isStartSynchronized && mapping.isSynchronized;
+  const unsigned long startUS = isStartSynchronized ? mapping.toLocal(command.frame.startUS) : (command.receivedUS + command.frame.startDelayUS);
+  DeferredLog::write(GearboxLog::SEGMENT_RECEIVED, targetPosition, command.frame.segmentSpeed, static_cast<uint32_t>(startUS - micros()));
+  segmentDirection = (targetPosition >= currentPosition) ? 1 : -1;
+  gearbox.setSpeedLimit(command.frame.segmentSpeed);
+  gearbox.moveToPosition(targetPosition);
+  gearbox.startMotorAt(startUS);
 }
 
-void Communication::genCtrlFastenBrake()
+void Communication::followSegment(const I2cCommand &command)
 {
-  sendDefaultReturnState();
+  if (gearbox.isWaitingForStart())
+  {
+    return;
+  }
 
-  // Get position of other gearbox from i2c data.
-  memcpy(&otherGearboxPosition, &(i2cData[1u]), 4u);
-  performFastenBrake();
+  currentPosition = gearbox.getCurrentPosition();
+  const float otherPosition = estimateOtherGearboxPosition(command);
+  if (!checkForGearboxDeviation(otherPosition))
+  {
+    DeferredLog::write(GearboxLog::MOVE_TO_TOO_FAR);
+    return;
+  }
+  synchronizeColumns(otherPosition, segmentDirection);
 }
 
-void Communication::genCtrlToggleMotorControl()
+void Communication::endSegment()
 {
-  sendDefaultReturnState();
+  if (segmentDirection == 0)
+  {
+    return;
+  }
+  segmentDirection = 0;
+  gearbox.setSpeedLimit(0u);
+}
+
+void Communication::genCtrlEmergencyStop(const I2cCommand &command)
+{
+  DeferredLog::write(GearboxLog::EMERGENCY_STOP);
+  performEmergencyStop();
+}
 
+void Communication::genCtrlGetPosition(const I2cCommand &command)
+{
   // Get position of other gearbox from i2c data.
-  memcpy(&otherGearboxPosition, &(i2cData[1u]), 4u);
-  performToggleMotorControl();
+  otherGearboxPosition = command.frame.peer.position;
+  if (segmentDirection != 0)
+  {
+    followSegment(command);
+  }
 }
 
-void Communication::genCtrlToggleMotorControlPower()
+void Communication::genCtrlLoosenBrake(const I2cCommand &command)
 {
-  sendDefaultReturnState();
+  // Get position of other gearbox from i2c data.
+  otherGearboxPosition = command.frame.peer.position;
+  performLoosenBrake();
+}
 
+void Communication::genCtrlFastenBrake(const I2cCommand &command)
+{
   // Get position of other gearbox from i2c data.
-  memcpy(&otherGearboxPosition, &(i2cData[1u]), 4u);
+  otherGearboxPosition = command.frame.peer.position;
+  performFastenBrake();
+}
 
-  performToggleMotorControlPower();
+void Communication::genCtrlToggleMotorControl(const I2cCommand &command)
+{
+  // Get position of other gearbox from i2c data.
+  otherGearboxPosition = command.frame.peer.position;
+  performToggleMotorControl(command.frame.isEnabled);
+}
+
+void Communication::genCtrlToggleMotorControlPower(const I2cCommand &command)
+{
+  // Get position of other gearbox from i2c data.
+  otherGearboxPosition = command.frame.peer.position;
+  performToggleMotorControlPower(command.frame.isEnabled);
 }
@@ -5,7 +5,17 @@
 #include <Wire.h>
 #include "Pinout.hpp"
 #include <string>
+#include <atomic>
+#include <SpscRing.hpp>
+#include <SeqlockSnapshot.hpp>
+#include <GearboxProtocol.hpp>
+#include <ClockSync.hpp>
 #include "Gearbox.hpp"
+#include "ColumnSync.hpp"
+#include "MotorTimer.hpp"
+#ifdef EMERGENCY_STOP_LINE
+#include <EmergencyStopLine.hpp>
+#endif
 
 class Communication
 {
@@ -15,69 +25,160 @@ class Communication
 private:
     static Communication *instance;
 
-    // Command codes for communication with general controller.
-    static constexpr char CMD_MOVE_UP = 'u';
-    static constexpr char CMD_MOVE_DOWN = 'd';
-    static constexpr char CMD_MOVE_TO = 'm';
-    static constexpr char CMD_EMERGENCY_STOP = 'e';
-    static constexpr char CMD_GET_POSITION = 'p';
-    static constexpr char CMD_LOOSEN_BRAKE = 'l';
-    static constexpr char CMD_FASTEN_BRAKE = 'f';
-    static constexpr char CMD_TOGGLE_MOTOR_CONTROL = 'c';
-    static constexpr char CMD_TOGGLE_MOTOR_CONTROL_POWER = 't';
-
     // I2C settings for communication with general controller.
     static constexpr int I2C_SDA_PIN = 21;
     static constexpr int I2C_SCL_PIN = 22;
-    static constexpr uint32_t I2C_FREQ = 100000u;
+    // The slave follows the clock of the controller, which runs at up to Fast-mode Plus.
+    static constexpr uint32_t I2C_FREQ = 1000000u;
 #ifdef GEARBOX_LEFT
     static constexpr int8_t I2C_ADDRESS = 0x33;
     static constexpr const char *const GEARBOX_NAME = "left";
+    static constexpr bool IS_LEFT_GEARBOX = true;
 #else
     static constexpr int8_t I2C_ADDRESS = 0x88;
     static constexpr const char *const GEARBOX_NAME = "right";
+    static constexpr bool IS_LEFT_GEARBOX = false;
 #endif
 
     static constexpr uint32_t MAX_GEARBOX_DEVIATION = 1000u;
-    static constexpr uint32_t MAX_SOFT_GEARBOX_DEVIATION = 400u;
+    // The speed trim is only logged once it changed by this much (steps/s).
+    static constexpr int32_t SPEED_TRIM_LOG_STEP{25};
 
     uint32_t currentPosition{0u};
     Gearbox gearbox;
     std::string controlPanelMsgBuffer = "";
     uint8_t expectedMsgLength = 0;
 
-    // Variables for I2C communication with general controller.
-    static constexpr size_t MAX_EXPECTED_I2C_DATA_LENGTH = 16u;
-    bool readAllI2cData{false};
-    size_t i2cDataLength{0u};
-    uint8_t i2cData[MAX_EXPECTED_I2C_DATA_LENGTH]{0u};
+    // Variables for I2C communication with general controller, see GearboxProtocol for the frames.
+    struct I2cCommand
+    {
+        GearboxProtocol::Command frame{};
+        unsigned long receivedUS{0u};
+    };
+    // Commands are only decoded by the I2C callback and executed by the motor task, thus, they never race the stepping.
+    static constexpr size_t COMMAND_MAILBOX_CAPACITY{8u};
+    SpscRing<I2cCommand, COMMAND_MAILBOX_CAPACITY> commandMailbox;
+    // Number of commands that were received while the mailbox was full.
+    std::atomic<uint32_t> droppedCommands{0u};
+    // Number of frames that were corrupted or of another protocol version, and the reason for the last one.
+    std::atomic<uint32_t> rejectedFrames{0u};
+    std::atomic<uint8_t> lastRejectReason{0u};
+    // Sequence of the last accepted command and whether a command was lost since the last reply, for the status reply.
+    std::atomic<uint8_t> lastAcceptedSequence{0u};
+    std::atomic_bool isCommandLost{false};
+    // Events since the last status reply, see GearboxProtocol::EVENT_MOTION_STARTED. The motor task raises them, the
+    // request handler takes them. With GEARBOX_ATTENTION_LINE, the line is low while events or a time sync reply are
+    // pending, thus, the controller only reads the status of a resting gearbox once something happened.
+    std::atomic<uint8_t> pendingEvents{0u};
+    // Changes to the last published status raise events.
+    GearboxProtocol::Status lastPublishedStatus{};
+    bool wasDriverFaulty{false};
+
+    // The reply to every request is prepared by the motor task, the request handler only adds the age and encodes it.
+    struct StatusReply
+    {
+        GearboxProtocol::Status status{};
+        unsigned long publishedUS{0u};
+    };
+    // The status is published after every command and whenever it changed, at most once in this interval.
+    static constexpr unsigned long STATUS_PUBLISH_INTERVAL_US{1000u};
+    SeqlockSnapshot<StatusReply> statusSnapshot;
+    unsigned long lastStatusPublishUS{0u};
+
+    // Direction of the current jog, zero if there is none, and when its lease runs out. The motor task keeps extending
+    // the target of the jog till then, afterwards the motor ramps down within the last extension.
+    int8_t jogDirection{0};
+    unsigned long jogLeaseEndUS{0u};
+    unsigned long lastJogExtensionUS{0u};
+    // Interval at which a jog extends its target, well below the look ahead of DeskMotor::moveUp().
+    static constexpr unsigned long JOG_EXTENSION_INTERVAL_US{5000u};
+    // Direction of the current segment, zero if there is none. The controller only polls the status during a segment,
+    // each poll keeps the columns synchronized.
+    int8_t segmentDirection{0};
+
+    // Time sync with the general controller. The I2C callbacks pair the times of an exchange with the ones of the
+    // controller that the next CMD_TIME_SYNC carries, the motor task feeds the complete exchanges into the estimate.
+    struct TimeSyncExchange
+    {
+        uint8_t sequence{0u};
+        uint32_t receivedUS{0u};
+        uint32_t repliedUS{0u};
+        bool isReplied{false};
+    };
+    // Only used by the I2C callbacks.
+    TimeSyncExchange lastTimeSync;
+    bool isTimeSyncReplyPending{false};
+    static constexpr size_t TIME_SYNC_QUEUE_CAPACITY{4u};
+    SpscRing<ClockSync::Sample, TIME_SYNC_QUEUE_CAPACITY> timeSyncSamples;
+    // The reply is stamped when the read starts and the controller takes the transfer of the reply off its time, thus,
+    // the whole round trip is the delay of the write till onReceive ran.
+    static constexpr float CLOCK_SYNC_FORWARD_SHARE{1.0f};
+    ClockSync clockSync{CLOCK_SYNC_FORWARD_SHARE};
+    // The state of the estimate is logged at this interval and whenever it gets or loses the synchronization.
+    static constexpr unsigned long CLOCK_SYNC_LOG_INTERVAL_US{10000000u};
+    unsigned long lastClockSyncLogUS{0u};
+    bool wasClockSynchronized{false};
+
+#ifdef EMERGENCY_STOP_LINE
+    // The ISR stops the motor, the motor task ends jogs and segments afterwards. This gearbox pulls the line once the
+    // other one is too far away, thus, both columns stop at the same time.
+    EmergencyStopLine emergencyStopLine{EMERGENCY_STOP_LINE_PIN, &MotorTimer::stopFromISR};
+#endif
 
     uint32_t otherGearboxPosition{0u};
+    ColumnSync columnSync;
+    int32_t lastLoggedSpeedTrim{0};
 
     void sendDefaultReturnState();
-
-    // Checks if the two gearboxes deviate too far from each other and performs an emergency stop if they do. Returns true if the gearboxes are close enough to each other.bool checkForGearboxDeviation(uint32_t currentPosition)
-    bool checkForGearboxDeviation(uint32_t currentPosition);
-    uint32_t calculateCorrection(uint32_t deviation);
-    void genCtrlMoveUp();
-    void genCtrlMoveDown();
-    void genCtrlMoveTo();
-    void genCtrlEmergencyStop();
-    void genCtrlGetPosition();
-    void genCtrlLoosenBrake();
-    void genCtrlFastenBrake();
-    void genCtrlToggleMotorControl();
-    void genCtrlToggleMotorControlPower();
+    void receiveTimeSync(const I2cCommand &command);
+    void sendTimeSyncReply();
+    // Feeds the exchanges that arrived since the last call into the estimate and publishes it, see SyncedClock.
+    void updateClockSync();
+    // Position, speed, brake state and flags as of now.
+    GearboxProtocol::Status readStatus();
+    void publishStatus(const GearboxProtocol::Status &status, const bool isDriverFaulty);
+    void raiseEvents(const uint8_t events);
+    void executeCommand(const I2cCommand &command);
+
+    // Checks if the two gearboxes deviate too far from each other and performs an emergency stop if they do. Returns true if the gearboxes are close enough to each other.
+    // The position of the other gearbox has to be extrapolated to now, see estimateOtherGearboxPosition().
+    bool checkForGearboxDeviation(const float otherPosition);
+    // Position of the other gearbox at this moment, extrapolated from the position, speed and age in the command.
+    float estimateOtherGearboxPosition(const I2cCommand &command) const;
+    // Trims the speed of this gearbox such that it keeps up with the other one, direction is the one of the move.
+    void synchronizeColumns(const float otherPosition, const int8_t direction);
+    void stopSynchronization();
+    // True while this gearbox stands still and the other one still finishes its move against the direction. The column
+    // that stopped first would get a head start otherwise, which grows while both accelerate.
+    bool isOtherGearboxReversing(const I2cCommand &command, const int8_t direction);
+    void genCtrlMoveUp(const I2cCommand &command);
+    void genCtrlMoveDown(const I2cCommand &command);
+    void genCtrlMoveTo(const I2cCommand &command);
+    void genCtrlJog(const I2cCommand &command);
+    // Extends the target of the current jog while its lease is valid, called by the motor task in every cycle. Returns
+    // the time till the next extension or the end of the lease, MotorTimer::NO_CYCLE_DUE without a jog.
+    uint32_t continueJog();
+    void endJog();
+    void genCtrlSegment(const I2cCommand &command);
+    // Checks the deviation and trims the speed during a segment, the command carries the motion of the other gearbox.
+    void followSegment(const I2cCommand &command);
+    void endSegment();
+    void genCtrlEmergencyStop(const I2cCommand &command);
+    void genCtrlGetPosition(const I2cCommand &command);
+    void genCtrlLoosenBrake(const I2cCommand &command);
+    void genCtrlFastenBrake(const I2cCommand &command);
+    void genCtrlToggleMotorControl(const I2cCommand &command);
+    void genCtrlToggleMotorControlPower(const I2cCommand &command);
 
 public:
     void performMoveTo(const long targetPosition);
-    void performMoveUp(uint32_t penalty);
-    void performMoveDown(uint32_t penalty);
+    void performMoveUp();
+    void performMoveDown();
     void performEmergencyStop();
     void performLoosenBrake();
     void performFastenBrake();
-    void performToggleMotorControl();
-    void performToggleMotorControlPower();
+    void performToggleMotorControl(const bool enable);
+    void performToggleMotorControlPower(const bool enable);
 
     Communication(float gearboxSensorHeight, float gearboxMathematicalHeight);
     ~Communication() = default;
@@ -88,5 +189,9 @@ public:
     // OnRequest function for I2C communication with general controller.
     void genCtrlOnRequestI2C();
 
+    // Executes all commands that were received since the last call and refreshes the status reply. Called by the motor
+    // task at the start of its cycle, returns the time till it has to be called again, see MotorTimer::CycleCallback.
+    uint32_t processCommands();
+
     Gearbox *const getGearbox() { return &gearbox; }
 };
@@ -1,10 +1,6 @@
 #include "DeskMotor.hpp"
 
-#include <chrono>
-#include <thread>
-#include <esp_task_wdt.h>
-
-DeskMotor::DeskMotor(const float maxSpeed, const float maxAcceleration) : maxSpeed(maxSpeed), maxAcceleration(maxAcceleration)
+DeskMotor::DeskMotor(const uint32_t maxSpeed, const uint32_t maxAcceleration, const uint32_t maxJerk) : profile(maxSpeed, maxAcceleration, maxJerk), maxSpeed(maxSpeed), maxAcceleration(maxAcceleration), maxJerk(maxJerk)
 {
     SPI.begin(DESK_MOTOR_SPI_SCK, DESK_MOTOR_SPI_MISO, DESK_MOTOR_SPI_MOSI, DESK_MOTOR_SPI_SS);
 
@@ -17,92 +13,260 @@ DeskMotor::DeskMotor(const float maxSpeed, const float maxAcceleration) : maxSpe
     driver.pwm_autoscale(true);
     driver.microsteps(0); // We need to set zero microsteps for the step multiplier(each step translates to 256 microsteps) to work.
     driver.intpol(true);  // Enable interpolation for step multiplier
-    // TODO Enable 'dc step' (Enable us to get skipped steps)
+    // dcStep: above DCSTEP_MIN_SPEED the driver commutates the motor by its back EMF. A motor that cannot keep up slows
+    // down instead of losing its position unnoticed, the driver counts every step it skipped in LOST_STEPS. The DCEN
+    // input is tied high, see Pinout.hpp. dcStep runs in fullstep with spreadCycle, stealthChop is left below.
+    driver.TPWMTHRS(toTStep(DCSTEP_MIN_SPEED));
+    driver.THIGH(toTStep(DCSTEP_MIN_SPEED));
+    driver.vhighfs(true);
+    driver.vhighchm(true);
+    driver.VDCMIN(toVdcmin(DCSTEP_MIN_SPEED));
+    driver.dc_time(DCSTEP_TIME);
+    driver.dc_sg(DCSTEP_STALL_GUARD);
     // TODO Enable low energy usage when motor is not moving
 
-    deskMotor.setCurrentPosition(0);
-    deskMotor.setMaxSpeed(maxSpeed);
-    deskMotor.setAcceleration(maxAcceleration);
-    deskMotor.setEnablePin(DESK_MOTOR_EN_PIN);
-    deskMotor.setPinsInverted(false, false, true);
-    deskMotor.enableOutputs();
+#ifdef DESK_MOTOR_RMT_STEPS
+    pulseGenerator.begin();
+#else
+    pinMode(DESK_MOTOR_STEP_PIN, OUTPUT);
+    pinMode(DESK_MOTOR_DIR_PIN, OUTPUT);
+#endif
+    // The enable pin is active low.
+    pinMode(DESK_MOTOR_EN_PIN, OUTPUT);
+    digitalWrite(DESK_MOTOR_EN_PIN, LOW);
 
     Serial.printf("Main motor initialized\n");
 }
 
-void DeskMotor::step()
+uint32_t DeskMotor::step()
 {
-    if (isRunning)
+    const unsigned long currentTimeMS = millis();
+    if (currentTimeMS - lastSkippedStepsUpdateMS >= skippedStepsUpdateIntervalMS)
     {
-        deskMotor.run();
+        lastSkippedStepsUpdateMS = currentTimeMS;
+
+        // Subtract skipped steps from current position
+        const int skippedSteps = getMissingSteps();
+        profile.fixMissingSteps(skippedSteps);
+        // Fixing the position changes the distance to go, therefore, the target has to be handed to the profile again.
+        applyTargetPosition();
+    }
+    else if (targetPosition.load() != appliedTargetPosition)
+    {
+        applyTargetPosition();
     }
 
-    iterationCounter++;
-    if (iterationCounter >= skippedStepsUpdateIteration)
+    if (!isRunning)
     {
-        iterationCounter = 0;
+        haltProfile();
+#ifdef DESK_MOTOR_RMT_STEPS
+        // Steps that are queued already are still sent, keep track of the position till the last one is out.
+        pulseGenerator.transmit();
+        updateEmittedPosition();
+        if (pulseGenerator.isTransmitting())
+        {
+            return positionUpdateIntervalUS;
+        }
+#endif
+        return NO_STEP_DUE;
+    }
 
-        // Subtract skipped steps from current position
-        const int skippedSteps = getMissingSteps();
-        deskMotor.fixMissingSteps(skippedSteps);
+    if (isStartPending)
+    {
+        // The timer wakes the task right at the start, which times the first step from it.
+        const long timeToStartUS = static_cast<long>(startUS - micros());
+        if ((timeToStartUS > 0) && !profile.isMoving() && !hasPlannedStep)
+        {
+            return static_cast<uint32_t>(timeToStartUS);
+        }
+        isStartPending = false;
+    }
+
+#ifdef DESK_MOTOR_RMT_STEPS
+    return fillPulseTrain();
+#else
+    return stepPin();
+#endif
+}
+
+#ifdef DESK_MOTOR_RMT_STEPS
+uint32_t DeskMotor::fillPulseTrain()
+{
+    // Plan steps ahead till the queue of the pulse generator is topped up.
+    while (pulseGenerator.needsSteps())
+    {
+        if (!hasPlannedStep)
+        {
+            hasPlannedStep = profile.planStep(plannedStepIntervalNS, plannedStepDirection);
+            if (!hasPlannedStep)
+            {
+                // Target reached.
+                break;
+            }
+        }
+
+        if (!pulseGenerator.queueStep(plannedStepIntervalNS, plannedStepDirection))
+        {
+            // Direction changes, the step has to wait till the steps in the other direction are sent.
+            break;
+        }
+        hasPlannedStep = false;
+    }
+    pulseGenerator.transmit();
+    updateEmittedPosition();
+
+    if (!pulseGenerator.isTransmitting() && !pulseGenerator.hasPendingSteps() && !hasPlannedStep)
+    {
+        // Target reached and all steps are sent.
+        return NO_STEP_DUE;
+    }
+    return positionUpdateIntervalUS;
+}
+#else
+uint32_t DeskMotor::stepPin()
+{
+    if (!hasPlannedStep)
+    {
+        const bool isStarting = !profile.isMoving();
+        hasPlannedStep = profile.planStep(plannedStepIntervalNS, plannedStepDirection);
+        if (!hasPlannedStep)
+        {
+            // Target reached.
+            updateEmittedPosition();
+            return NO_STEP_DUE;
+        }
+        if (isStarting)
+        {
+            // Like a new RMT transmission, the first step from standstill is timed from now and not from the last step.
+            lastStepUS = micros();
+        }
+    }
+
+    const unsigned long currentTimeUS = micros();
+    const unsigned long stepIntervalUS = plannedStepIntervalNS / 1000u;
+    const unsigned long timeSinceLastStepUS = currentTimeUS - lastStepUS;
+    if (timeSinceLastStepUS < stepIntervalUS)
+    {
+        return stepIntervalUS - timeSinceLastStepUS;
+    }
+
+    // The driver steps on the rising edge, the direction is high for positive steps.
+    digitalWrite(DESK_MOTOR_DIR_PIN, plannedStepDirection > 0 ? HIGH : LOW);
+    digitalWrite(DESK_MOTOR_STEP_PIN, HIGH);
+    delayMicroseconds(1);
+    digitalWrite(DESK_MOTOR_STEP_PIN, LOW);
+    lastStepUS = currentTimeUS;
+    hasPlannedStep = false;
+    updateEmittedPosition();
+
+    // Plan the following step right away to know when it is due.
+    hasPlannedStep = profile.planStep(plannedStepIntervalNS, plannedStepDirection);
+    if (!hasPlannedStep)
+    {
+        // The profile halted with this step, the speed drops to zero.
+        updateEmittedPosition();
+        return NO_STEP_DUE;
+    }
+    return plannedStepIntervalNS / 1000u;
+}
+#endif
+
+void DeskMotor::haltProfile()
+{
+    if (!hasPlannedStep && !profile.isMoving())
+    {
+        return;
+    }
 
+    long unexecutedSteps = hasPlannedStep ? plannedStepDirection : 0;
+    hasPlannedStep = false;
+#ifdef DESK_MOTOR_RMT_STEPS
+    // Steps that are queued for the RMT already will still be executed.
+    unexecutedSteps += pulseGenerator.discardQueuedSteps();
+#endif
+    profile.setCurrentPosition(profile.getCurrentPosition() - unexecutedSteps);
+    applyTargetPosition();
+    updateEmittedPosition();
+}
+
+void DeskMotor::updateEmittedPosition()
+{
+    long pendingSteps = hasPlannedStep ? plannedStepDirection : 0;
+#ifdef DESK_MOTOR_RMT_STEPS
+    pendingSteps += pulseGenerator.pendingSteps();
+#endif
+    emittedPosition = profile.getCurrentPosition() - pendingSteps;
+    currentSpeed = profile.getSpeed();
+}
+
+void DeskMotor::applyTargetPosition()
+{
+    appliedTargetPosition = targetPosition.load();
 // Update to new target position
 #ifdef GEARBOX_LEFT
-        deskMotor.moveTo(targetPosition);
+    profile.setTargetPosition(appliedTargetPosition);
 #else
-        deskMotor.moveTo(-targetPosition);
+    profile.setTargetPosition(-appliedTargetPosition);
 #endif
-    }
 }
 
-void DeskMotor::setMaxAcceleration(const float newMaxAcceleration)
+void DeskMotor::setMaxAcceleration(const uint32_t newMaxAcceleration)
 {
     maxAcceleration = newMaxAcceleration;
-    deskMotor.setAcceleration(maxAcceleration);
+    profile.setAcceleration(maxAcceleration);
 }
 
-void DeskMotor::setMaxSpeed(const float newMaxSpeed)
+void DeskMotor::setMaxJerk(const uint32_t newMaxJerk)
+{
+    maxJerk = newMaxJerk;
+    profile.setJerk(maxJerk);
+}
+
+void DeskMotor::setMaxSpeed(const uint32_t newMaxSpeed)
 {
     maxSpeed = newMaxSpeed;
-    deskMotor.setMaxSpeed(maxSpeed);
+    setSpeedTrim(speedTrim);
+}
+
+void DeskMotor::setSpeedTrim(const int32_t trim)
+{
+    speedTrim = trim;
+    profile.setMaxSpeed(static_cast<uint32_t>(max(static_cast<int32_t>(maxSpeed) + speedTrim, 1)));
 }
 
 uint32_t DeskMotor::getCurrentPosition()
 {
 #ifdef GEARBOX_LEFT
-    return deskMotor.currentPosition();
+    return emittedPosition.load();
 #else
-    return -deskMotor.currentPosition();
+    return -emittedPosition.load();
 #endif
 }
 
 int32_t DeskMotor::getCurrentSpeed()
 {
 #ifdef GEARBOX_LEFT
-    return deskMotor.speed();
+    return currentSpeed.load();
 #else
-    return -deskMotor.speed();
+    return -currentSpeed.load();
 #endif
 }
 
+long DeskMotor::distanceToGo()
+{
+    return targetPosition.load() - static_cast<long>(getCurrentPosition());
+}
+
 bool DeskMotor::isMotorMovingUpwards()
 {
     // Explicitly not mark the motor as moving downwards if it is not moving at all.
-#ifdef GEARBOX_LEFT
-    return deskMotor.distanceToGo() > 0;
-#else
-    return deskMotor.distanceToGo() < 0;
-#endif
+    return distanceToGo() > 0;
 }
 
 bool DeskMotor::isMotorMovingDownwards()
 {
     // Explicitly not mark the motor as moving downwards if it is not moving at all.
-#ifdef GEARBOX_LEFT
-    return deskMotor.distanceToGo() < 0;
-#else
-    return deskMotor.distanceToGo() > 0;
-#endif
+    return distanceToGo() < 0;
 }
 
 void DeskMotor::setNewTargetPosition(const long newTargetPosition)
@@ -112,16 +276,25 @@ void DeskMotor::setNewTargetPosition(const long newTargetPosition)
 
 void DeskMotor::addToTargetPosition(const long stepsToAdd)
 {
-    targetPosition = constrain(targetPosition + stepsToAdd, minSteps, maxSteps);
+    targetPosition = constrain(targetPosition.load() + stepsToAdd, minSteps, maxSteps);
 }
 
 void DeskMotor::start()
 {
+    isStartPending = false;
     isRunning = true;
 }
 
-void DeskMotor::stop()
+void DeskMotor::startAt(const unsigned long newStartUS)
 {
+    startUS = newStartUS;
+    isStartPending = true;
+    isRunning = true;
+}
+
+void IRAM_ATTR DeskMotor::stop()
+{
+    isStartPending = false;
     isRunning = false;
 }
 
@@ -129,6 +302,7 @@ void DeskMotor::addSkippedSteps(const int stepsToAdd)
 {
     // Add the number of steps atomically as the motor might reset it to 0.
     skippedSteps.fetch_add(stepsToAdd);
+    totalSkippedSteps.fetch_add(static_cast<uint32_t>(abs(stepsToAdd)));
 }
 
 int DeskMotor::getMissingSteps()
@@ -140,13 +314,14 @@ int DeskMotor::getMissingSteps()
 void DeskMotor::setCurrentPosition(const long newPosition)
 {
 #ifdef GEARBOX_LEFT
-    deskMotor.setCurrentPosition(newPosition);
+    profile.setCurrentPosition(newPosition);
 #else
-    deskMotor.setCurrentPosition(-newPosition);
+    profile.setCurrentPosition(-newPosition);
 #endif
+    updateEmittedPosition();
 }
 
-void DeskMotor::moveUp(uint32_t penalty)
+void DeskMotor::moveUp()
 {
     if (isMotorMovingDownwards())
     {
@@ -154,18 +329,17 @@ void DeskMotor::moveUp(uint32_t penalty)
         return;
     }
 
-    const float currentSpeed = getCurrentSpeed();
+    const int32_t currentSpeed = getCurrentSpeed();
     const long currentPosition = getCurrentPosition();
     const long deltaSteps = calculateDeltaSteps(currentSpeed);
-    const long adjustedDeltaSteps = max(deltaSteps - static_cast<long>(penalty), 0L);
     // Add delta steps calculated for the given speed.
-    const long targetPosition = currentPosition + adjustedDeltaSteps;
+    const long targetPosition = currentPosition + deltaSteps;
 
     // Set target position.
     setNewTargetPosition(targetPosition);
 }
 
-void DeskMotor::moveDown(uint32_t penalty)
+void DeskMotor::moveDown()
 {
     if (isMotorMovingUpwards())
     {
@@ -174,71 +348,78 @@ void DeskMotor::moveDown(uint32_t penalty)
     }
 
     // Take the negative speed because then we can use the same calculation as for moving upwards.
-    const float currentSpeed = -getCurrentSpeed();
+    const int32_t currentSpeed = -getCurrentSpeed();
     const long currentPosition = getCurrentPosition();
     const long deltaSteps = calculateDeltaSteps(currentSpeed);
-    const long adjustedDeltaSteps = max(deltaSteps - static_cast<long>(penalty), 0L);
     // Subtract delta steps calculated for the given speed to account for the inverted speed.
-    const long targetPosition = currentPosition - adjustedDeltaSteps;
+    const long targetPosition = currentPosition - deltaSteps;
 
     // Set target position.
     setNewTargetPosition(targetPosition);
 }
 
-uint32_t DeskMotor::hwReadSkippedSteps()
+bool DeskMotor::pollDriverStatus()
 {
-    return driver.LOST_STEPS();
-}
-
-long DeskMotor::calculateDeltaSteps(float currentSpeed)
-{
-    const long currentPosition = getCurrentPosition();
+    const bool hadFault = getDriverStatus().hasFault();
+    bool hasLostSteps{false};
+    DriverStatus status{};
+    status.sampleTimeMS = millis();
+    status.isConnected = driver.test_connection() == 0u;
 
-    const float maxPotAcceleration = maxAcceleration * moveInputIntervalMS / 1000;
-    const float theoreticalEndSpeed = currentSpeed + maxPotAcceleration;
-
-    float actualEndSpeed;
-    float totalSteps = 0;
-
-    if (theoreticalEndSpeed > maxSpeed)
+    if (status.isConnected)
     {
-        // Speed is capped.
-        actualEndSpeed = maxSpeed;
-        // What percentage of time the acceleration was active for?
-        const float activeAccelerationPercentage = (theoreticalEndSpeed - actualEndSpeed) / maxPotAcceleration;
-
-        // Triangular rise till max speed (platoe).
-        const float actualAcceleration = maxPotAcceleration * activeAccelerationPercentage;
-        const float accelerationTime = moveInputIntervalMS * activeAccelerationPercentage / 1000;
-        const float triangleRiseSteps = 0.5 * actualAcceleration * accelerationTime;
-        // Rectangular plateau at max speed (platoe).
-        const float plateauTime = (moveInputIntervalMS / 1000.0f - accelerationTime);
-        const float rectangleSteps = actualAcceleration * plateauTime;
-
-        totalSteps = triangleRiseSteps + rectangleSteps;
+        status.drvStatus = driver.DRV_STATUS();
+        status.stallGuardResult = status.drvStatus & SG_RESULT_MASK;
+        status.lostSteps = driver.LOST_STEPS();
+        status.tStep = driver.TSTEP();
+
+        if (hasLostStepsReference)
+        {
+            // Sign extend the difference of the 20 bit counter, it carries the direction the steps were lost in. The
+            // profile may have stopped by the time they are noticed.
+            const int32_t lostStepsDelta = static_cast<int32_t>(((status.lostSteps - lastLostSteps) & LOST_STEPS_MASK) << 12u) >> 12;
+            if (lostStepsDelta != 0)
+            {
+                addSkippedSteps(lostStepsDelta);
+                hasLostSteps = true;
+            }
+        }
+        lastLostSteps = status.lostSteps;
+        hasLostStepsReference = true;
     }
     else
     {
-        // Speed is not capped.
-        actualEndSpeed = theoreticalEndSpeed;
-        const float activeAccelerationPercentage = 1;
-
-        // Triangular rise till.
-        const float triangleRiseSteps = 0.5 * maxPotAcceleration * moveInputIntervalMS / 1000;
-
-        totalSteps = triangleRiseSteps;
+        // The counter restarts with the driver, thus, the next answer is only used as new reference.
+        hasLostStepsReference = false;
     }
 
-    // Base rectangle.
-    const float baseRectangleSteps = currentSpeed * moveInputIntervalMS / 1000;
-
-    // Triangular decrease till halt.
-    const float decelerationTime = actualEndSpeed / maxAcceleration; // seconds
-    const float triangleFallSteps = 0.5 * actualEndSpeed * decelerationTime;
+    driverStatus.publish(status);
+    return hasLostSteps || (status.hasFault() != hadFault);
+}
 
-    totalSteps += baseRectangleSteps + triangleFallSteps;
-    const float bufferSteps = totalSteps * upDownStepBufferFactor;
-    const float deltaSteps = max(10.0f, ceil(totalSteps + bufferSteps));
+DeskMotor::DriverStatus DeskMotor::getDriverStatus() const
+{
+    DriverStatus status{};
+    driverStatus.read(status);
+    return status;
+}
 
-    return deltaSteps;
-}
\ No newline at end of file
+long DeskMotor::calculateDeltaSteps(const int32_t currentSpeed)
+{
+    // Assume the motor accelerates for the whole interval, but not beyond the max speed. The speed trim is taken out of
+    // the current speed, such that both columns look equally far ahead and stop at the same height.
+    const uint32_t startSpeed = constrain(currentSpeed - speedTrim, 0, static_cast<int32_t>(maxSpeed));
+    const uint32_t endSpeed = min(startSpeed + (maxAcceleration * moveInputIntervalMS / 1000u), maxSpeed);
+    const uint32_t accelerationTimeMS = (endSpeed - startSpeed) * 1000u / maxAcceleration;
+
+    // Steps while accelerating, steps while keeping the end speed for the rest of the interval, and steps to stop from the end speed.
+    const uint32_t accelerationSteps = profile.stoppingDistance(endSpeed) - profile.stoppingDistance(startSpeed);
+    const uint32_t plateauSteps = endSpeed * (moveInputIntervalMS - min(accelerationTimeMS, moveInputIntervalMS)) / 1000u;
+    // With a jerk limit the motor also has to release its acceleration before it brakes, which the profile knows best.
+    // At the max speed the profile only follows the speed trim, thus, the stop is planned from cruising.
+    const uint32_t decelerationSteps = (endSpeed >= maxSpeed) ? profile.stoppingDistance(maxSpeed) : max(profile.stoppingDistance(endSpeed), profile.stoppingDistanceAfter(moveInputIntervalMS, maxSpeed));
+
+    const uint32_t totalSteps = accelerationSteps + plateauSteps + decelerationSteps;
+    const uint32_t bufferSteps = totalSteps * upDownStepBufferPercent / 100u;
+    return max(10L, static_cast<long>(totalSteps + bufferSteps + 1u));
+}
@@ -3,41 +3,136 @@
 #include <Arduino.h>
 #include "Pinout.hpp"
 #include <TMCStepper.h>
-#include <AccelStepper.h>
 #include <atomic>
+#include <SeqlockSnapshot.hpp>
+#include "MotionProfile.hpp"
+#include "StepPulseGenerator.hpp"
 
 class DeskMotor
 {
     friend class DebugControls;
     friend class MainLogUtil;
 
+public:
+    // Diagnostic registers of the TMC2130, read in one batch.
+    struct DriverStatus
+    {
+        // Overtemperature and short to ground of either coil in DRV_STATUS, the driver switched itself off.
+        static constexpr uint32_t FAULT_MASK{(1u << 25u) | (1u << 27u) | (1u << 28u)};
+
+        uint32_t drvStatus{0u};
+        uint32_t lostSteps{0u};
+        uint16_t stallGuardResult{0u};
+        uint32_t tStep{0u};
+        unsigned long sampleTimeMS{0u};
+        // False if the driver did not answer, e.g. because its power is switched off. The registers are invalid then.
+        bool isConnected{false};
+
+        bool hasFault() const { return isConnected && ((drvStatus & FAULT_MASK) != 0u); }
+    };
+
 private:
     TMC2130Stepper driver = TMC2130Stepper(DESK_MOTOR_CS_PIN, DESK_MOTOR_R_SENSE); // Hardware SPI
-    AccelStepper deskMotor = AccelStepper(deskMotor.DRIVER, DESK_MOTOR_STEP_PIN, DESK_MOTOR_DIR_PIN);
+    // Positions of the profile are in motor steps, which are inverted for the right gearbox.
+    MotionProfile profile;
+#ifdef DESK_MOTOR_RMT_STEPS
+    StepPulseGenerator pulseGenerator{DESK_MOTOR_STEP_PIN, DESK_MOTOR_DIR_PIN};
+    // Time between two cycles while steps are sent. They update the emitted position and top up the queue of the pulse
+    // generator, which lasts longer.
+    static constexpr uint32_t positionUpdateIntervalUS{1000u};
+#endif
 
-    float maxSpeed{}; // max speed of main motor
-    float maxAcceleration{};
-    /*volatile*/ long targetPosition{0}; // current target position of the motor
-    bool isRunning{false};
+    uint32_t maxSpeed{}; // max speed of main motor (steps/s)
+    int32_t speedTrim{0}; // steps/s
+    uint32_t maxAcceleration{}; // steps/s^2
+    uint32_t maxJerk{}; // steps/s^3, zero for a trapezoidal profile
+    std::atomic_long targetPosition{0}; // current target position of the motor
+    // Target position that was last handed to the profile.
+    long appliedTargetPosition{0};
+    std::atomic_bool isRunning{false};
+    // A move from standstill waits till this time, see startAt().
+    std::atomic_bool isStartPending{false};
+    unsigned long startUS{0u};
     std::atomic_int skippedSteps{0};
+    // All skipped steps since start, for the status of the gearbox.
+    std::atomic<uint32_t> totalSkippedSteps{0u};
+
+    // Nominal frequency of the internal clock of the TMC2130, the time base of its velocity thresholds.
+    static constexpr uint32_t DRIVER_CLOCK_HZ{12000000u};
+    // Every step of the step input is interpolated to 256 microsteps.
+    static constexpr uint32_t MICROSTEPS_PER_STEP{256u};
+    // dcStep takes over above this speed (steps/s), below it the motor runs with stealthChop as before.
+    static constexpr uint32_t DCSTEP_MIN_SPEED{200u};
+    // Upper limit of the PWM on time during commutation, slightly above the blank time of 24 clocks (clocks).
+    static constexpr uint16_t DCSTEP_TIME{30u};
+    // Stall detection threshold of dcStep, about DCSTEP_TIME / 16.
+    static constexpr uint8_t DCSTEP_STALL_GUARD{2u};
+    // TPWMTHRS and THIGH compare with TSTEP, the time between two microsteps in clocks.
+    static constexpr uint32_t toTStep(const uint32_t stepsPerSecond)
+    {
+        return DRIVER_CLOCK_HZ / (stepsPerSecond * MICROSTEPS_PER_STEP);
+    }
+    // VDCMIN is a velocity in microsteps per 2^24 clocks.
+    static constexpr uint32_t toVdcmin(const uint32_t stepsPerSecond)
+    {
+        return static_cast<uint32_t>(((static_cast<uint64_t>(stepsPerSecond) * MICROSTEPS_PER_STEP) << 24u) /
+                                     DRIVER_CLOCK_HZ);
+    }
+    // LOST_STEPS is a 20 bit counter that counts up or down with the direction of the lost steps.
+    static constexpr uint32_t LOST_STEPS_MASK{0xFFFFFu};
+    static constexpr uint32_t SG_RESULT_MASK{0x3FFu};
+    // Cached result of the last poll, written by the driver monitor task only.
+    SeqlockSnapshot<DriverStatus> driverStatus;
+    uint32_t lastLostSteps{0u};
+    bool hasLostStepsReference{false};
+
+    // Step that was planned by the profile but not yet executed.
+    bool hasPlannedStep{false};
+    uint32_t plannedStepIntervalNS{0u};
+    int8_t plannedStepDirection{0};
+    // Position and speed of the steps that were actually executed, in motor steps.
+    std::atomic_long emittedPosition{0};
+    std::atomic<int32_t> currentSpeed{0};
 
     int getMissingSteps();
     // Calculates the number of steps for the given speed and the given time frame.
-    long calculateDeltaSteps(float currentSpeed);
-    long moveInputIntervalMS{20};
+    long calculateDeltaSteps(const int32_t currentSpeed);
+    uint32_t moveInputIntervalMS{20};
 
-    float upDownStepBufferFactor{0.1f};
-    // The number of step iterations after which the skipped steps are updated.
-    static constexpr const long skippedStepsUpdateIteration{1000};
-    // Current iteration counter.
-    long iterationCounter{0};
+    uint32_t upDownStepBufferPercent{10};
+    // The interval in which the skipped steps are updated.
+    static constexpr const unsigned long skippedStepsUpdateIntervalMS{10};
+    unsigned long lastSkippedStepsUpdateMS{0};
+    // Time of the last step, used to tell how long it takes till the next step is due.
+    unsigned long lastStepUS{0};
+
+    void applyTargetPosition();
+    // Discards everything that was planned but not executed yet and brings the profile to a halt.
+    void haltProfile();
+    void updateEmittedPosition();
+    long distanceToGo();
+#ifdef DESK_MOTOR_RMT_STEPS
+    uint32_t fillPulseTrain();
+#else
+    uint32_t stepPin();
+#endif
 
 public:
-    DeskMotor(const float maxSpeed, const float maxAcceleration);
+    // Returned by step() if the motor has no further step to do.
+    static constexpr uint32_t NO_STEP_DUE{UINT32_MAX};
+
+    DeskMotor(const uint32_t maxSpeed, const uint32_t maxAcceleration, const uint32_t maxJerk);
     ~DeskMotor() = default;
 
-    void setMaxSpeed(const float newSpeed);
-    void setMaxAcceleration(const float newAcceleration);
+    void setMaxSpeed(const uint32_t newSpeed);
+    uint32_t getMaxSpeed() const { return maxSpeed; }
+    // Adds the trim of the column synchronization to the max speed of the profile, zero runs at the max speed again.
+    void setSpeedTrim(const int32_t trim);
+    void setMaxAcceleration(const uint32_t newAcceleration);
+    uint32_t getMaxAcceleration() const { return maxAcceleration; }
+    // Limits the change of the acceleration, which makes the profile an S-curve. Zero selects the trapezoidal profile.
+    void setMaxJerk(const uint32_t newJerk);
+    uint32_t getMaxJerk() const { return maxJerk; }
     uint32_t getCurrentPosition();
     int32_t getCurrentSpeed();
     bool isMotorMovingUpwards();
@@ -46,15 +141,31 @@ public:
     void addToTargetPosition(const long stepsToAdd);
     void setCurrentPosition(const long newPosition);
 
-    void step();
+    // Executes a step if one is due. Returns the time in us till the next step is due or NO_STEP_DUE if the motor is idle.
+    uint32_t step();
 
     void start();
+    // Like start(), but a motor at standstill holds its first step till the given time. Both gearboxes start a
+    // synchronized move this way. A motor that already moves keeps going.
+    void startAt(const unsigned long newStartUS);
+    bool isWaitingForStart() const { return isStartPending.load(); }
+    // Only clears flags, thus, it may be called from an ISR, see MotorTimer::stopFromISR().
     void stop();
 
+    // Skipped steps are signed by the direction of the motor when the driver skipped them.
     void addSkippedSteps(const int stepsToAdd);
+    uint32_t getTotalSkippedSteps() const { return totalSkippedSteps.load(); }
 
-    void moveUp(uint32_t penalty);
-    void moveDown(uint32_t penalty);
+    void moveUp();
+    void moveDown();
 
-    uint32_t hwReadSkippedSteps();
+    // Reads the diagnostic registers over SPI and feeds new lost steps into the skipped steps. Blocks for the SPI
+    // transfers, therefore, it is only called by the driver monitor task. Returns true if it found lost steps or the
+    // fault state changed, which changes the status reply.
+    bool pollDriverStatus();
+    // Result of the last poll, never blocks.
+    DriverStatus getDriverStatus() const;
+#ifdef DESK_MOTOR_RMT_STEPS
+    const StepPulseGenerator &getPulseGenerator() const { return pulseGenerator; }
+#endif
 };
@@ -0,0 +1,44 @@
+#include "DriverMonitor.hpp"
+#include "MotorTimer.hpp"
+
+DriverMonitor *DriverMonitor::instance;
+TaskHandle_t DriverMonitor::taskHandle;
+DeskMotor *DriverMonitor::deskMotor;
+uint32_t DriverMonitor::pollIntervalMS;
+
+DriverMonitor::DriverMonitor(DeskMotor *const deskMotor, const uint32_t pollIntervalMS)
+{
+    instance = this;
+
+    this->deskMotor = deskMotor;
+    this->pollIntervalMS = pollIntervalMS;
+
+    startTask();
+}
+
+void DriverMonitor::runTask()
+{
+    TickType_t lastWakeTime = xTaskGetTickCount();
+    while (true)
+    {
+        if (deskMotor->pollDriverStatus())
+        {
+            // The motor task publishes the change, it does not wake on its own while the desk is parked.
+            MotorTimer::wake();
+        }
+        vTaskDelayUntil(&lastWakeTime, pdMS_TO_TICKS(pollIntervalMS));
+    }
+}
+
+void DriverMonitor::startTask()
+{
+    xTaskCreatePinnedToCore(
+        [](void *param)
+        { DriverMonitor::instance->runTask(); },
+        "DriverMonitorTask",        // Task name
+        4096,                       // Stack size (bytes)
+        NULL,                       // Parameter
+        1,                          // Task priority
+        &DriverMonitor::taskHandle, // Task handle
+        1);                         // Core where the task should run
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "DeskMotor.hpp"
+
+// Polls the diagnostic registers of the desk motor driver at a fixed rate in a low priority task. The SPI transfers
+// block, doing them here keeps them out of the motor task and the I2C callbacks, which only read the cached result.
+class DriverMonitor
+{
+    static TaskHandle_t taskHandle;
+
+    static DeskMotor *deskMotor;
+    static uint32_t pollIntervalMS;
+
+public:
+    static DriverMonitor *instance;
+
+    DriverMonitor(DeskMotor *const deskMotor, const uint32_t pollIntervalMS);
+    ~DriverMonitor() = default;
+
+    void startTask();
+    void runTask();
+};
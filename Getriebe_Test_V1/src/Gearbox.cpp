@@ -1,5 +1,6 @@
 #include "Gearbox.hpp"
 #include "DeskMotor.hpp"
+#include "MotorTimer.hpp"
 
 Gearbox::Gearbox(std::string gearboxName, float sensorHeight, float mathematicalHeight)
 {
@@ -13,30 +14,41 @@ Gearbox::~Gearbox()
 void Gearbox::startMotor()
 {
     deskMotor.start();
+    MotorTimer::wake();
+}
+
+void Gearbox::startMotorAt(const unsigned long startUS)
+{
+    deskMotor.startAt(startUS);
+    MotorTimer::wake();
 }
 
 void Gearbox::stopMotor()
 {
     deskMotor.stop();
+    MotorTimer::wake();
 }
 
-void Gearbox::moveUp(uint32_t penalty)
+void Gearbox::moveUp()
 {
     // Calculate target position based on current position and speed.
     // Set target position.
-    deskMotor.moveUp(penalty);
+    deskMotor.moveUp();
+    MotorTimer::wake();
 }
 
-void Gearbox::moveDown(uint32_t penalty)
+void Gearbox::moveDown()
 {
     // Calculate target position based on current position and speed.
     // Set target position.
-    deskMotor.moveDown(penalty);
+    deskMotor.moveDown();
+    MotorTimer::wake();
 }
 
 void Gearbox::moveToPosition(long targetPosition)
 {
     deskMotor.setNewTargetPosition(targetPosition);
+    MotorTimer::wake();
 }
 
 uint32_t Gearbox::getCurrentPosition()
@@ -44,6 +56,35 @@ uint32_t Gearbox::getCurrentPosition()
     return deskMotor.getCurrentPosition();
 }
 
+int32_t Gearbox::getCurrentSpeed()
+{
+    return deskMotor.getCurrentSpeed();
+}
+
+uint32_t Gearbox::getCommandedSpeed() const
+{
+    return deskMotor.getMaxSpeed();
+}
+
+void Gearbox::setSpeedTrim(const int32_t trim)
+{
+    deskMotor.setSpeedTrim(trim);
+}
+
+void Gearbox::setSpeedLimit(const uint32_t limit)
+{
+    const uint32_t newMaxSpeed = ((limit == 0u) || (limit > maxDeskMotorSpeed)) ? maxDeskMotorSpeed : limit;
+    if (newMaxSpeed != deskMotor.getMaxSpeed())
+    {
+        deskMotor.setMaxSpeed(newMaxSpeed);
+    }
+}
+
+uint32_t Gearbox::getSkippedSteps() const
+{
+    return deskMotor.getTotalSkippedSteps();
+}
+
 BrakeState Gearbox::getCurrentBrakeState() const
 {  
     if(largeBrake.getBrakeState() == Brake::BRAKE_STATE_UNLOCKED){
@@ -68,15 +109,18 @@ Brake *const Gearbox::getLargeBrake()
 void Gearbox::loosenBrakes()
 {
     largeBrake.openBrake();
+    MotorTimer::wake();
 }
 
 void Gearbox::fastenBrakes()
 {
     largeBrake.closeBrake();
+    MotorTimer::wake();
 }
 
 void Gearbox::toggleMotorControlPower(const bool enable)
 {
+    isMotorControlPowerOn = enable;
     if (enable)
     {
         digitalWrite(RELAY_3V, HIGH);
@@ -89,6 +133,7 @@ void Gearbox::toggleMotorControlPower(const bool enable)
 
 void Gearbox::toggleMotorControl(const bool enable)
 {
+    isMotorControlOn = enable;
     if (enable)
     {
         digitalWrite(DESK_MOTOR_EN_PIN, LOW);
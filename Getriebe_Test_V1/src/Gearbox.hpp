@@ -27,27 +27,50 @@ class Gearbox
     };
 
 private:
-    static constexpr float maxDeskMotorSpeed{1500.f};       // max speed of main motor
-    static constexpr float maxDeskMotorAcceleration{100.f}; // max acceleration of main motor
+#ifdef DESK_MOTOR_RMT_STEPS
+    // Step pulses are generated by the RMT peripheral, thus, the speed is not limited by the motor task anymore.
+    static constexpr uint32_t maxDeskMotorSpeed{3000u};        // max speed of main motor (steps/s)
+#else
+    static constexpr uint32_t maxDeskMotorSpeed{1500u};        // max speed of main motor (steps/s)
+#endif
+    // The jerk limit smooths the start and end of the acceleration, which allows for a higher acceleration without jolting the desk.
+    static constexpr uint32_t maxDeskMotorAcceleration{400u};  // max acceleration of main motor (steps/s^2)
+    static constexpr uint32_t maxDeskMotorJerk{800u};          // max jerk of main motor (steps/s^3)
 
-    DeskMotor deskMotor{maxDeskMotorSpeed, maxDeskMotorAcceleration};
+    DeskMotor deskMotor{maxDeskMotorSpeed, maxDeskMotorAcceleration, maxDeskMotorJerk};
 
     Brake largeBrake{-BRAKE_MOVE_DIRECTION, LIGHTGATE_LARGE_BRAKE_OPEN, LIGHTGATE_LARGE_BRAKE_CLOSED, LARGE_BRAKE_1, LARGE_BRAKE_2, LARGE_BRAKE_3, LARGE_BRAKE_4};
 
+    // The desk motor enables its driver when it starts, the power relay is off.
+    bool isMotorControlOn{true};
+    bool isMotorControlPowerOn{false};
+
 public:
     Gearbox(std::string gearboxName, float sensorHeight, float mathematicalHeight);
     ~Gearbox();
 
     void startMotor();
+    // Starts the motor at the given time of micros(), see DeskMotor::startAt().
+    void startMotorAt(const unsigned long startUS);
+    bool isWaitingForStart() const { return deskMotor.isWaitingForStart(); }
     void stopMotor();
 
-    void moveUp(uint32_t penalty);
-    void moveDown(uint32_t penalty);
+    void moveUp();
+    void moveDown();
     void moveToPosition(long targetPosition);
     void loosenBrakes();
     void fastenBrakes();
 
     uint32_t getCurrentPosition();
+    // Signed speed in steps/s, positive upwards.
+    int32_t getCurrentSpeed();
+    // Speed that moves are commanded with, the column synchronization trims it.
+    uint32_t getCommandedSpeed() const;
+    void setSpeedTrim(const int32_t trim);
+    // Limits the speed of moves (steps/s), zero or anything above the max speed removes the limit.
+    void setSpeedLimit(const uint32_t limit);
+    // Steps the driver lost since start.
+    uint32_t getSkippedSteps() const;
     BrakeState getCurrentBrakeState() const;
 
     DeskMotor *const getDeskMotor();
@@ -55,4 +78,6 @@ public:
 
     void toggleMotorControl(const bool enable);
     void toggleMotorControlPower(const bool enable);
+    bool isMotorControlEnabled() const { return isMotorControlOn; }
+    bool isMotorControlPowered() const { return isMotorControlPowerOn; }
 };
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <DeferredLogFormat.hpp>
+
+// Messages of the gearbox for the deferred logger. New messages are only appended, otherwise, the decoder shows wrong
+// texts for captures of older firmwares.
+#define GEARBOX_LOG_MESSAGES(X)                                                                     \
+    X(MAILBOX_FULL, "I2C command mailbox full, dropped commands: %u")                               \
+    X(UNKNOWN_COMMAND, "Unknown i2c command: %u")                                                   \
+    X(TOGGLE_MOTOR_CONTROL, "Toggle motor control: %{false|true}")                                  \
+    X(TOGGLE_MOTOR_CONTROL_POWER, "Toggle motor control power: %{false|true}")                      \
+    X(MOVE_UP_DEVIATION, "MoveUp: Deviation is %d")                                                 \
+    X(MOVE_UP_EMERGENCY_STOP, "MoveUp: Emergency stop applied due to deviation.")                   \
+    X(MOVE_UP_SOFT_LIMIT, "MoveUp Soft Limit: Correction is %u")                                    \
+    X(MOVE_DOWN_EMERGENCY_STOP, "MoveDown: Emergency stop applied due to deviation.")               \
+    X(MOVE_DOWN_SOFT_LIMIT, "MoveDown Soft Limit: Correction is %u")                                \
+    X(MOVE_TO_DEVIATION, "MoveTo: Deviation is %d")                                                 \
+    X(MOVE_TO_TOO_FAR, "I2C moveTo: Too far away from other gearbox, stopping.")                    \
+    X(EMERGENCY_STOP, "I2C emergencyStop")                                                          \
+    X(OPEN_BRAKE, "Open Brake, Target position: %d")                                                \
+    X(CLOSE_BRAKE, "Close Brake, Target position: %d")                                              \
+    X(ROTARY_CORRECTED_ANGLE, "corrected angle: %f")                                                \
+    X(ROTARY_HEIGHT, "Sensorhöhe: %f")                                                              \
+    X(ROTARY_UNCORRECTED_ANGLE, "uncorrected angle: %f")                                            \
+    X(SPEED_TRIM, "Sync: Deviation is %d, speed trim %d")                                          \
+    X(REJECTED_FRAMES, "Rejected I2C frames: %u, last reason: %{Ok|TooShort|WrongVersion|"          \
+                       "WrongLength|WrongCrc}")                                                     \
+    X(JOG_LEASE_EXPIRED, "Jog lease expired, ramping down")                                         \
+    X(SEGMENT_RECEIVED, "Segment to %u at speed %u, starts in %u us")                               \
+    X(CLOCK_SYNC, "Clock sync: synchronized %{false|true}, error %d us, round trip %u us, "         \
+               "drift %f ppm")                                                                      \
+    X(EMERGENCY_STOP_LINE_PULLED, "Emergency stop line pulled by another board")
+
+DEFERRED_LOG_CATALOG(GearboxLog, GEARBOX_LOG_MESSAGES);
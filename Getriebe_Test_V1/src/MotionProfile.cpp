@@ -0,0 +1,445 @@
+#include "MotionProfile.hpp"
+
+// Integer square root, only used when the acceleration is configured.
+static uint64_t integerSqrt(uint64_t value)
+{
+    uint64_t result = 0u;
+    uint64_t bit = 1ull << 62u;
+    while (bit > value)
+    {
+        bit >>= 2u;
+    }
+    while (bit != 0u)
+    {
+        if (value >= result + bit)
+        {
+            value -= result + bit;
+            result = (result >> 1u) + bit;
+        }
+        else
+        {
+            result >>= 1u;
+        }
+        bit >>= 2u;
+    }
+    return result;
+}
+
+// Integer cube root, only used when the jerk is configured.
+static uint64_t integerCbrt(const uint64_t value)
+{
+    uint64_t low = 0u;
+    uint64_t high = 1ull << 21u;
+    while (low < high)
+    {
+        const uint64_t middle = (low + high + 1u) / 2u;
+        if (middle * middle * middle <= value)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1u;
+        }
+    }
+    return low;
+}
+
+MotionProfile::MotionProfile(const uint32_t maxSpeed, const uint32_t acceleration, const uint32_t jerk)
+{
+    setMaxSpeed(maxSpeed);
+    setAcceleration(acceleration);
+    setJerk(jerk);
+}
+
+void MotionProfile::setMaxSpeed(const uint32_t newMaxSpeed)
+{
+    maxSpeed = max(newMaxSpeed, 1u);
+    minStepInterval = static_cast<uint32_t>(INTERVAL_ONE_SECOND / maxSpeed);
+}
+
+void MotionProfile::setAcceleration(const uint32_t newAcceleration)
+{
+    if (newAcceleration == 0u)
+    {
+        return;
+    }
+
+    if (acceleration != 0u)
+    {
+        // Keep the current speed, the number of ramp steps scales inversely with the acceleration (Equation 16).
+        rampStep = static_cast<uint32_t>(min((static_cast<uint64_t>(rampStep) * acceleration) / newAcceleration, static_cast<uint64_t>(MAX_RAMP_STEPS)));
+    }
+    acceleration = newAcceleration;
+
+    // Equation 15 with the correction factor of Equation 7: c0 = 0.676 * sqrt(2 / a) * 1s.
+    // The square root is taken of the acceleration shifted by 16 bits, which keeps 8 fractional bits of precision.
+    constexpr uint64_t scaledFactor{static_cast<uint64_t>(0.676 * 1.41421356 * 1000000.0 * (1u << INTERVAL_FRACTION_BITS)) << 8u};
+    initialStepInterval = static_cast<uint32_t>(scaledFactor / integerSqrt(static_cast<uint64_t>(acceleration) << 16u));
+
+    // The S-curve must not keep an acceleration above the new limit.
+    const int32_t maxRampAcceleration = static_cast<int32_t>(acceleration << SPEED_FRACTION_BITS);
+    rampAcceleration = constrain(rampAcceleration, -maxRampAcceleration, maxRampAcceleration);
+}
+
+void MotionProfile::setJerk(const uint32_t newJerk)
+{
+    if (direction != 0 && jerk == 0u && newJerk != 0u)
+    {
+        // Continue the move with the current speed as S-curve.
+        rampSpeed = static_cast<uint32_t>((INTERVAL_ONE_SECOND << SPEED_FRACTION_BITS) / stepInterval);
+        rampAcceleration = 0;
+    }
+    else if (direction != 0 && jerk != 0u && newJerk == 0u)
+    {
+        // Continue the move with the current speed as trapezoid, the ramp step follows from Equation 16.
+        const uint32_t speed = rampSpeed >> SPEED_FRACTION_BITS;
+        rampStep = static_cast<uint32_t>(min((static_cast<uint64_t>(speed) * speed) / (2u * static_cast<uint64_t>(acceleration)), static_cast<uint64_t>(MAX_RAMP_STEPS)));
+        intervalRemainder = 0u;
+    }
+    jerk = newJerk;
+
+    if (jerk == 0u)
+    {
+        return;
+    }
+
+    // With constant jerk the first step takes t = cbrt(6 / j), afterwards the speed is j * t^2 / 2 and the acceleration j * t.
+    const uint64_t startTimeUS = integerCbrt(6000000000000000000ull / jerk);
+    jerkStartStepInterval = static_cast<uint32_t>(startTimeUS << INTERVAL_FRACTION_BITS);
+    jerkStartAcceleration = static_cast<uint32_t>(min((static_cast<uint64_t>(jerk) * startTimeUS << SPEED_FRACTION_BITS) / 1000000u, static_cast<uint64_t>(INT32_MAX)));
+    jerkStartSpeed = static_cast<uint32_t>((static_cast<uint64_t>(jerkStartAcceleration) * startTimeUS) / 2000000u);
+}
+
+void MotionProfile::setCurrentPosition(const long newPosition)
+{
+    currentPosition = newPosition;
+    targetPosition = newPosition;
+    halt();
+}
+
+int32_t MotionProfile::getSpeed() const
+{
+    if (direction == 0)
+    {
+        return 0;
+    }
+    return direction * static_cast<int32_t>(INTERVAL_ONE_SECOND / stepInterval);
+}
+
+uint32_t MotionProfile::stepsToStop() const
+{
+    if (jerk != 0u)
+    {
+        return jerkLimitedStoppingDistance(rampSpeed, rampAcceleration);
+    }
+    return rampStep;
+}
+
+uint32_t MotionProfile::stoppingDistance(const uint32_t speed) const
+{
+    if (jerk != 0u)
+    {
+        return jerkLimitedStoppingDistance(speed << SPEED_FRACTION_BITS, 0);
+    }
+
+    // v^2 / (2 * a)
+    return static_cast<uint32_t>((static_cast<uint64_t>(speed) * speed) / (2u * static_cast<uint64_t>(acceleration)));
+}
+
+uint32_t MotionProfile::stoppingDistanceAfter(const uint32_t durationMS, const uint32_t speedLimit) const
+{
+    const uint32_t speed = static_cast<uint32_t>(abs(getSpeed()));
+    if (jerk == 0u)
+    {
+        return stoppingDistance(min(speed + (acceleration * durationMS / 1000u), speedLimit));
+    }
+
+    // The profile only revises its decision once per step, thus, the step in progress adds to the duration. A motor at
+    // standstill starts with the state after its first step.
+    const uint64_t stepTimeUS = (static_cast<uint64_t>(isMoving() ? stepInterval : jerkStartStepInterval) >> INTERVAL_FRACTION_BITS);
+    const int64_t durationUS = (1000 * static_cast<int64_t>(durationMS)) + static_cast<int64_t>(stepTimeUS);
+    const int64_t maxAcceleration = static_cast<int64_t>(acceleration) << SPEED_FRACTION_BITS;
+    const int64_t maxRampSpeed = static_cast<int64_t>(speedLimit) << SPEED_FRACTION_BITS;
+    const int64_t startSpeed = isMoving() ? rampSpeed : jerkStartSpeed;
+    const int64_t startAcceleration = isMoving() ? max(rampAcceleration, 0) : static_cast<int32_t>(jerkStartAcceleration);
+    const int64_t endAcceleration = min(startAcceleration + ((static_cast<int64_t>(jerk) * durationUS) << SPEED_FRACTION_BITS) / 1000000, maxAcceleration);
+    const int64_t endSpeed = startSpeed + ((startAcceleration + endAcceleration) / 2) * durationUS / 1000000;
+    if (endSpeed >= maxRampSpeed)
+    {
+        return jerkLimitedStoppingDistance(static_cast<uint32_t>(maxRampSpeed), 0);
+    }
+    return jerkLimitedStoppingDistance(static_cast<uint32_t>(endSpeed), static_cast<int32_t>(endAcceleration));
+}
+
+void MotionProfile::fixMissingSteps(const long missedSteps)
+{
+    // Missed steps carry the direction they were planned in, which is gone once the profile stopped.
+    currentPosition -= missedSteps;
+}
+
+void MotionProfile::halt()
+{
+    direction = 0;
+    rampStep = 0u;
+    stepInterval = 0u;
+    intervalRemainder = 0u;
+    rampSpeed = 0u;
+    rampAcceleration = 0;
+}
+
+void MotionProfile::accelerate()
+{
+    if (rampStep == 0u)
+    {
+        // Start of a new ramp.
+        stepInterval = max(initialStepInterval, minStepInterval);
+        intervalRemainder = 0u;
+        rampStep = 1u;
+        return;
+    }
+
+    if (rampStep >= MAX_RAMP_STEPS)
+    {
+        // The speed hardly changes any more this far into the ramp, cruise.
+        return;
+    }
+
+    // Equation 13: c_n = c_(n-1) - 2 * c_(n-1) / (4n + 1), with n being the number of ramp steps so far.
+    const uint32_t divisor = (4u * rampStep) + 1u;
+    const uint32_t dividend = (2u * stepInterval) + intervalRemainder;
+    const uint32_t quotient = dividend / divisor;
+    const uint32_t nextStepInterval = stepInterval - quotient;
+
+    if (nextStepInterval <= minStepInterval)
+    {
+        // Max speed reached, cruise.
+        stepInterval = minStepInterval;
+        intervalRemainder = 0u;
+        return;
+    }
+
+    stepInterval = nextStepInterval;
+    intervalRemainder = dividend - (quotient * divisor);
+    rampStep++;
+}
+
+void MotionProfile::decelerate()
+{
+    if (rampStep <= 1u)
+    {
+        // Last step of the ramp, keep the interval of the first step.
+        rampStep = 0u;
+        return;
+    }
+
+    // Inverse of Equation 13: c_(n-2) = c_(n-1) + 2 * c_(n-1) / (4n - 5), with n being the number of ramp steps so far.
+    const uint32_t divisor = (4u * rampStep) - 5u;
+    const uint32_t dividend = (2u * stepInterval) + intervalRemainder;
+    const uint32_t quotient = dividend / divisor;
+    stepInterval += quotient;
+    intervalRemainder = dividend - (quotient * divisor);
+    rampStep--;
+}
+
+bool MotionProfile::planStep(uint32_t &intervalNS, int8_t &stepDirection)
+{
+    const long distanceTo = distanceToGo();
+
+    if (direction == 0)
+    {
+        if (distanceTo == 0)
+        {
+            return false;
+        }
+
+        // First step from standstill.
+        direction = (distanceTo > 0) ? 1 : -1;
+        if (jerk != 0u)
+        {
+            startJerkLimitedRamp();
+        }
+        else
+        {
+            accelerate();
+        }
+    }
+    else if (jerk != 0u)
+    {
+        const long remainingSteps = distanceTo * direction;
+        // Short moves cannot brake before the acceleration of the first step is released, which already brings the motor
+        // to twice the start speed. The motor is still slow enough to stop right away at that speed (plus some margin).
+        if (remainingSteps <= 0 && rampSpeed <= 3u * jerkStartSpeed)
+        {
+            // Slow enough to stop right away, start again from standstill if the target is behind.
+            halt();
+            return planStep(intervalNS, stepDirection);
+        }
+        planJerkLimitedStep(remainingSteps);
+    }
+    else
+    {
+        // Steps left till the target in the current direction, negative if the target is behind.
+        const long remainingSteps = distanceTo * direction;
+        if (remainingSteps <= 0 && rampStep <= 1u)
+        {
+            // Slow enough to stop right away, start again from standstill if the target is behind.
+            halt();
+            return planStep(intervalNS, stepDirection);
+        }
+
+        if ((remainingSteps <= static_cast<long>(rampStep)) || (stepInterval < minStepInterval))
+        {
+            // Target would be overshot or max speed was lowered.
+            decelerate();
+        }
+        else if (stepInterval > minStepInterval)
+        {
+            accelerate();
+        }
+    }
+
+    intervalNS = static_cast<uint32_t>((static_cast<uint64_t>(stepInterval) * 1000u) >> INTERVAL_FRACTION_BITS);
+    stepDirection = direction;
+    currentPosition += direction;
+    return true;
+}
+
+void MotionProfile::startJerkLimitedRamp()
+{
+    rampAcceleration = static_cast<int32_t>(min(jerkStartAcceleration, acceleration << SPEED_FRACTION_BITS));
+    rampSpeed = min(jerkStartSpeed, maxSpeed << SPEED_FRACTION_BITS);
+    stepInterval = max(jerkStartStepInterval, minStepInterval);
+    intervalRemainder = 0u;
+    lastStoppingDistance = 0u;
+    stoppingDistanceGrowth = 0u;
+    isBraking = false;
+}
+
+void MotionProfile::planJerkLimitedStep(const long remainingSteps)
+{
+    const int64_t speed = rampSpeed;
+    const int64_t acceleration = rampAcceleration;
+    const int64_t maxAcceleration = static_cast<int64_t>(this->acceleration) << SPEED_FRACTION_BITS;
+
+    // Brake down to the start speed once the stopping distance reaches the target, otherwise go for max speed. While
+    // accelerating the stopping distance grows by several steps per step, thus, this growth is kept as margin. It is
+    // not updated while braking, otherwise the decision would flip back and forth between two steps.
+    const uint32_t stoppingDistance = jerkLimitedStoppingDistance(rampSpeed, rampAcceleration);
+    if (!isBraking)
+    {
+        stoppingDistanceGrowth = (stoppingDistance > lastStoppingDistance) ? stoppingDistance - lastStoppingDistance : 0u;
+    }
+    lastStoppingDistance = stoppingDistance;
+    isBraking = static_cast<long>(stoppingDistance + stoppingDistanceGrowth) >= remainingSteps;
+    const int64_t targetSpeed = isBraking ? jerkStartSpeed : static_cast<int64_t>(maxSpeed) << SPEED_FRACTION_BITS;
+
+    // Choose the jerk such that the target speed is reached just when the acceleration is back at zero.
+    int8_t jerkDirection = 0;
+    bool isReleasing = false;
+    const int64_t speedError = targetSpeed - speed;
+    if (speedError == 0)
+    {
+        jerkDirection = (acceleration > 0) ? -1 : ((acceleration < 0) ? 1 : 0);
+        isReleasing = true;
+    }
+    else
+    {
+        const int8_t errorDirection = (speedError > 0) ? 1 : -1;
+        const int64_t towardsTarget = acceleration * errorDirection;
+        // Releasing the acceleration a with jerk j still changes the speed by a^2 / (2j).
+        const int64_t releaseSpeedChange = towardsTarget * towardsTarget;
+        if (towardsTarget < 0)
+        {
+            jerkDirection = errorDirection;
+        }
+        else if (2 * static_cast<int64_t>(jerk) * (speedError * errorDirection) * (1 << SPEED_FRACTION_BITS) <= releaseSpeedChange)
+        {
+            jerkDirection = -errorDirection;
+            isReleasing = true;
+        }
+        else if (towardsTarget < maxAcceleration)
+        {
+            jerkDirection = errorDirection;
+        }
+    }
+
+    // The interval follows from the speed in the middle of the step.
+    constexpr uint64_t speedToInterval{INTERVAL_ONE_SECOND << SPEED_FRACTION_BITS};
+    const int64_t estimatedInterval = static_cast<int64_t>(speedToInterval / static_cast<uint64_t>(max(speed, static_cast<int64_t>(1))));
+    const int64_t middleSpeed = speed + (acceleration * estimatedInterval) / static_cast<int64_t>(2u * INTERVAL_ONE_SECOND);
+    stepInterval = static_cast<uint32_t>(speedToInterval / static_cast<uint64_t>(max(middleSpeed, static_cast<int64_t>(max(jerkStartSpeed, 1u)))));
+
+    // Advance speed and acceleration to the end of the step.
+    const int64_t accelerationChange = (static_cast<int64_t>(jerk) * stepInterval * (1 << (SPEED_FRACTION_BITS - INTERVAL_FRACTION_BITS))) / 1000000;
+    int64_t nextAcceleration = acceleration + jerkDirection * accelerationChange;
+    if (isReleasing && (nextAcceleration * acceleration <= 0))
+    {
+        nextAcceleration = 0;
+    }
+    nextAcceleration = constrain(nextAcceleration, -maxAcceleration, maxAcceleration);
+
+    int64_t nextSpeed = speed + (((acceleration + nextAcceleration) / 2) * stepInterval) / static_cast<int64_t>(INTERVAL_ONE_SECOND);
+    if (isReleasing && nextAcceleration == 0)
+    {
+        // Rounding errors would otherwise keep the speed slightly off the target.
+        nextSpeed = targetSpeed;
+    }
+
+    rampSpeed = static_cast<uint32_t>(max(nextSpeed, static_cast<int64_t>(jerkStartSpeed)));
+    rampAcceleration = static_cast<int32_t>(nextAcceleration);
+}
+
+uint32_t MotionProfile::jerkLimitedStoppingDistance(const uint32_t speed, const int32_t acceleration) const
+{
+    // The motor stops at the start speed, so the braking is planned down to it.
+    constexpr int64_t ONE_SECOND_US{1000000};
+    constexpr int64_t SPEED_ONE{1 << SPEED_FRACTION_BITS};
+    const int64_t startSpeed = jerkStartSpeed;
+    const int64_t relativeSpeed = static_cast<int64_t>(speed) - startSpeed;
+    const int64_t deceleration = -static_cast<int64_t>(acceleration);
+    if (relativeSpeed <= 0 && deceleration >= 0)
+    {
+        return 0u;
+    }
+
+    // Distance in Q16.16 steps * us.
+    int64_t distance = 0;
+    const int64_t twoJerkSpeed = 2 * static_cast<int64_t>(jerk) * relativeSpeed * SPEED_ONE;
+    if (deceleration > 0 && twoJerkSpeed <= deceleration * deceleration)
+    {
+        // Releasing the deceleration right away still reaches the start speed before the deceleration is zero. The time
+        // follows from v - d * t + j * t^2 / 2 = 0.
+        const int64_t root = static_cast<int64_t>(integerSqrt(static_cast<uint64_t>(deceleration * deceleration - twoJerkSpeed)));
+        const int64_t releaseTimeUS = ((deceleration - root) * ONE_SECOND_US) / (static_cast<int64_t>(jerk) * SPEED_ONE);
+        distance = releaseTimeUS * (relativeSpeed - ((2 * deceleration + root) * releaseTimeUS) / (6 * ONE_SECOND_US));
+        distance += startSpeed * releaseTimeUS;
+    }
+    else
+    {
+        // Ramp the deceleration up to its peak (t1), hold it (t2) and release it (t3). The peak follows from the speed
+        // that has to be removed: v = (2p^2 - d^2) / (2j), it is capped by the max acceleration.
+        const int64_t maxAcceleration = static_cast<int64_t>(this->acceleration) << SPEED_FRACTION_BITS;
+        const int64_t peakSquared = max((twoJerkSpeed + deceleration * deceleration) / 2, static_cast<int64_t>(0));
+        const int64_t peak = min(static_cast<int64_t>(integerSqrt(static_cast<uint64_t>(peakSquared))), maxAcceleration);
+        const int64_t jerkSpeed = static_cast<int64_t>(jerk) * SPEED_ONE;
+
+        const int64_t rampUpTimeUS = ((peak - deceleration) * ONE_SECOND_US) / jerkSpeed;
+        const int64_t speedAfterRampUp = relativeSpeed - ((peak * peak - deceleration * deceleration) / (2 * static_cast<int64_t>(jerk))) / SPEED_ONE;
+        const int64_t releaseSpeedChange = ((peak * peak) / (2 * static_cast<int64_t>(jerk))) / SPEED_ONE;
+        const int64_t holdTimeUS = (peak > 0) ? (max(speedAfterRampUp - releaseSpeedChange, static_cast<int64_t>(0)) * ONE_SECOND_US) / peak : 0;
+        const int64_t releaseTimeUS = (peak * ONE_SECOND_US) / jerkSpeed;
+
+        distance = rampUpTimeUS * (relativeSpeed - ((2 * deceleration + peak) * rampUpTimeUS) / (6 * ONE_SECOND_US));
+        distance += holdTimeUS * ((speedAfterRampUp + releaseSpeedChange) / 2);
+        distance += (releaseSpeedChange * releaseTimeUS) / 3;
+        distance += startSpeed * (rampUpTimeUS + holdTimeUS + releaseTimeUS);
+    }
+
+    if (distance <= 0)
+    {
+        return 0u;
+    }
+    constexpr int64_t ONE_STEP{SPEED_ONE * ONE_SECOND_US};
+    return static_cast<uint32_t>((distance + ONE_STEP - 1) / ONE_STEP);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Trapezoidal ramp generator for the desk motor. Steps are planned one at a time, which allows to either execute them
+// directly or to compute them ahead of time and hand them to a pulse peripheral. The ramp follows D. Austin, "Generate
+// stepper-motor speed profiles in real time", but only uses integer arithmetic: step intervals are Q24.8 fixed point
+// numbers in us and the remainder of every division is carried over to the next step. Planning a step of the trapezoid
+// costs a single 32 bit division, the remainder is taken from its quotient, independent of the target changing in the
+// middle of a move.
+// If a jerk limit is set, the profile is an S-curve instead: the acceleration ramps up and down with the jerk limit,
+// which results in the seven segments jerk up, constant acceleration, jerk down, cruise and the same mirrored for braking.
+// Speed and acceleration are Q16.16 fixed point numbers in that case and braking starts once the jerk limited stopping
+// distance reaches the remaining distance.
+class MotionProfile
+{
+public:
+    // Number of fractional bits of the step intervals.
+    static constexpr uint8_t INTERVAL_FRACTION_BITS{8u};
+
+private:
+    static constexpr uint32_t INTERVAL_ONE_US{1u << INTERVAL_FRACTION_BITS};
+    // One second in Q24.8 us.
+    static constexpr uint64_t INTERVAL_ONE_SECOND{1000000ull << INTERVAL_FRACTION_BITS};
+    // Number of fractional bits of speed and acceleration of the S-curve.
+    static constexpr uint8_t SPEED_FRACTION_BITS{16u};
+    // Max speed and acceleration are at least 1, thus, the step intervals stay below 2^28 and the remainder below the
+    // divisor. A ramp of at most this many steps keeps the dividend of a ramp step within 32 bits.
+    static constexpr uint32_t MAX_RAMP_STEPS{1u << 29u};
+
+    uint32_t maxSpeed{};     // steps/s
+    uint32_t acceleration{}; // steps/s^2
+    uint32_t jerk{0u};       // steps/s^3, zero for a trapezoidal profile
+    // Interval of the first step from standstill and interval at max speed.
+    uint32_t initialStepInterval{};
+    uint32_t minStepInterval{};
+
+    long currentPosition{0};
+    long targetPosition{0};
+    // Number of ramp steps that lead from standstill to the current speed, which is also the number of steps it takes to stop.
+    uint32_t rampStep{0u};
+    uint32_t stepInterval{0u};
+    // Remainder of the last interval division, keeps the rounding errors from adding up.
+    uint32_t intervalRemainder{0u};
+    int8_t direction{0};
+
+    // State of the S-curve, speed and acceleration are signed in the direction of the move.
+    uint32_t rampSpeed{0u};      // Q16.16 steps/s
+    int32_t rampAcceleration{0}; // Q16.16 steps/s^2
+    uint32_t lastStoppingDistance{0u};
+    uint32_t stoppingDistanceGrowth{0u};
+    bool isBraking{false};
+    // The first step from standstill is done with constant jerk, the motor is able to stop right away at its speed.
+    uint32_t jerkStartStepInterval{0u};
+    uint32_t jerkStartSpeed{0u};
+    uint32_t jerkStartAcceleration{0u};
+
+    void accelerate();
+    void decelerate();
+    void halt();
+
+    void startJerkLimitedRamp();
+    void planJerkLimitedStep(const long remainingSteps);
+    // Steps it takes to come to a halt from the given S-curve state, the acceleration is negative while braking.
+    uint32_t jerkLimitedStoppingDistance(const uint32_t speed, const int32_t acceleration) const;
+
+public:
+    MotionProfile(const uint32_t maxSpeed, const uint32_t acceleration, const uint32_t jerk);
+    ~MotionProfile() = default;
+
+    // Both can be changed during a move, if the motor is faster than the new max speed it decelerates to it.
+    void setMaxSpeed(const uint32_t newMaxSpeed);
+    void setAcceleration(const uint32_t newAcceleration);
+    uint32_t getMaxSpeed() const { return maxSpeed; }
+    uint32_t getAcceleration() const { return acceleration; }
+    // Zero selects the trapezoidal profile. Can be changed during a move as well.
+    void setJerk(const uint32_t newJerk);
+    uint32_t getJerk() const { return jerk; }
+
+    void setTargetPosition(const long newTargetPosition) { targetPosition = newTargetPosition; }
+    long getTargetPosition() const { return targetPosition; }
+    // Sets the position without moving, stops the ramp.
+    void setCurrentPosition(const long newPosition);
+    long getCurrentPosition() const { return currentPosition; }
+    long distanceToGo() const { return targetPosition - currentPosition; }
+    // Signed speed in steps/s, zero while standing still.
+    int32_t getSpeed() const;
+    bool isMoving() const { return direction != 0; }
+
+    // Number of steps it takes to stop from the current speed.
+    uint32_t stepsToStop() const;
+    // Number of steps it takes to stop from the given speed (steps/s) with the configured acceleration and jerk.
+    uint32_t stoppingDistance(const uint32_t speed) const;
+    // Number of steps it takes to stop after accelerating from the current state for the given time, but not beyond the
+    // speed limit (steps/s). Unlike stoppingDistance() it covers the acceleration that an S-curve has to release before
+    // it brakes.
+    uint32_t stoppingDistanceAfter(const uint32_t durationMS, const uint32_t speedLimit) const;
+
+    // Corrects the position for steps that the driver did not execute, signed by their direction. Applies at standstill
+    // as well, the profile then moves the missed steps again.
+    void fixMissingSteps(const long missedSteps);
+
+    // Plans the next step. Returns false if the target is reached and the motor stands still. Otherwise, advances the
+    // position by one step and returns the time since the previous step in intervalNS and the direction of the step.
+    bool planStep(uint32_t &intervalNS, int8_t &stepDirection);
+};
@@ -1,47 +1,154 @@
 #include "MotorTimer.hpp"
-#include <esp_task_wdt.h>
+
+static_assert(DeskMotor::NO_STEP_DUE == Brake::NO_STEP_DUE, "Steppers have to agree on the idle marker.");
 
 MotorTimer *MotorTimer::instance;
 hw_timer_t *MotorTimer::timerHandle;
+TaskHandle_t MotorTimer::taskHandle;
 DeskMotor *MotorTimer::deskMotor;
 Brake *MotorTimer::brake2;
+MotorTimer::CycleCallback MotorTimer::cycleCallback;
 
-void IRAM_ATTR onMotorTimer()
+void IRAM_ATTR MotorTimer::onTimerAlarm()
 {
-    MotorTimer::instance->dueTaskIterations.fetch_add(1);
+    // Only wake the task. The brake still steps with AccelStepper, whose floating point math is not allowed inside an ISR,
+    // and the cycle callback that takes over commands and publishes the status runs in the same cycle.
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(taskHandle, &higherPriorityTaskWoken);
+    if (higherPriorityTaskWoken == pdTRUE)
+    {
+        portYIELD_FROM_ISR();
+    }
 }
 
-MotorTimer::MotorTimer(DeskMotor *const deskMotor, Brake *const brake2)
+MotorTimer::MotorTimer(DeskMotor *const deskMotor, Brake *const brake2, const CycleCallback cycleCallback)
 {
     instance = this;
-    dueTaskIterations.store(0);
 
     this->deskMotor = deskMotor;
     this->brake2 = brake2;
+    this->cycleCallback = cycleCallback;
 
     startTimer();
 }
 
+void MotorTimer::wake()
+{
+    if (instance == nullptr || taskHandle == nullptr)
+    {
+        // Task is not running yet, it services both steppers once it starts.
+        return;
+    }
+
+    instance->wakeRequested.store(true);
+    xTaskNotifyGive(taskHandle);
+}
+
+void IRAM_ATTR MotorTimer::stopFromISR()
+{
+    if (instance == nullptr || taskHandle == nullptr)
+    {
+        return;
+    }
+
+    deskMotor->stop();
+    instance->wakeRequested.store(true);
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(taskHandle, &higherPriorityTaskWoken);
+    if (higherPriorityTaskWoken == pdTRUE)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+uint64_t MotorTimer::toDueTime(const uint64_t now, const uint32_t timeToNextStepUS)
+{
+    if (timeToNextStepUS == DeskMotor::NO_STEP_DUE)
+    {
+        return NOT_DUE;
+    }
+    return now + timeToNextStepUS;
+}
+
 void MotorTimer::runTask()
 {
     Serial.println("RunTask started");
 
-    esp_task_wdt_init(UINT32_MAX, false);
-    esp_task_wdt_delete(NULL);
+    // The steppers have to be serviced once in the beginning as they might have received work before the task existed.
+    wakeRequested.store(true);
+
+    while (true)
+    {
+        const uint32_t cycleDueUS = runCycle();
+
+        // Sleep until the timer fires for the next step, a command wakes the task, or the cycle callback is due again.
+        const TickType_t ticksToWait = (cycleDueUS == NO_CYCLE_DUE) ? portMAX_DELAY : pdMS_TO_TICKS((cycleDueUS + 999u) / 1000u);
+        ulTaskNotifyTake(pdTRUE, ticksToWait);
+    }
+}
 
-    Serial.println("WDT diabled on core " + String(xPortGetCoreID()));
+uint32_t MotorTimer::runCycle()
+{
+    if (cycleCallback == nullptr)
+    {
+        serviceSteppers();
+        return NO_CYCLE_DUE;
+    }
+
+    // Work that has to be synchronized with the steppers, e.g. new commands, is done before they are serviced.
+    uint32_t cycleDueUS = cycleCallback();
+    const bool wasStepping = isStepping();
+    serviceSteppers();
+    if (wasStepping && !isStepping())
+    {
+        // The last step was just done, the callback publishes the final state before the task sleeps for good.
+        cycleDueUS = cycleCallback();
+    }
+    return cycleDueUS;
+}
+
+void MotorTimer::serviceSteppers()
+{
+    bool serviceAll = wakeRequested.exchange(false);
 
     while (true)
     {
-        if (dueTaskIterations.load() > 0)
+        const uint64_t now = timerRead(timerHandle);
+
+        if (serviceAll || (now + minAlarmLeadUS >= deskMotorDueUS))
         {
-            dueTaskIterations.fetch_sub(1);
-            deskMotor->step();
-            brake2->step();
+            deskMotorDueUS = toDueTime(now, deskMotor->step());
         }
+        if (serviceAll || (now + minAlarmLeadUS >= brakeDueUS))
+        {
+            brakeDueUS = toDueTime(now, brake2->step());
+        }
+        serviceAll = false;
+
+        const uint64_t nextDueUS = min(deskMotorDueUS, brakeDueUS);
+        if (nextDueUS == NOT_DUE)
+        {
+            // Both steppers are idle, no interrupts until the next command arrives.
+            timerAlarmDisable(timerHandle);
+            return;
+        }
+
+        if (nextDueUS > timerRead(timerHandle) + minAlarmLeadUS)
+        {
+            armTimer(nextDueUS);
+            return;
+        }
+        // Next step is due too soon to arm the timer for it, execute it right away.
     }
 }
 
+void MotorTimer::armTimer(const uint64_t dueUS)
+{
+    // The timer counts up continuously, therefore, the alarm is set to the absolute time of the next step without autoreload.
+    timerAlarmWrite(timerHandle, dueUS, false);
+    timerAlarmEnable(timerHandle);
+}
+
 void MotorTimer::startTimer()
 {
     Serial.begin(115200);
@@ -55,17 +162,15 @@ void MotorTimer::startTimer()
 
             // The prescaler is used to divide the base clock frequency of the ESP32’s timer. The ESP32’s timer uses the APB clock (APB_CLK) as its base clock, which is normally 80 MHz. By setting the prescaler to 80, we are dividing the base clock frequency by 80, resulting in a timer tick frequency of 1 MHz (80 MHz / 80 = 1 MHz).
             MotorTimer::timerHandle = timerBegin(0, 80, true);
-            timerAttachInterrupt(MotorTimer::timerHandle, &onMotorTimer, true);
-            timerAlarmWrite(MotorTimer::timerHandle, iterationIntervalUS, true);
-            timerAlarmEnable(MotorTimer::timerHandle);
+            timerAttachInterrupt(MotorTimer::timerHandle, &MotorTimer::onTimerAlarm, true);
             Serial.println("Just started timer.");
 
             MotorTimer::instance->runTask();
         },
-        "MotorTimerTask",     // Task name
-        10000,                // Stack size (bytes)
-        NULL,                 // Parameter
-        configMAX_PRIORITIES, // Task priority
-        NULL,                 // Task handle
-        0);                   // Core where the task should run
-}
\ No newline at end of file
+        "MotorTimerTask",         // Task name
+        10000,                    // Stack size (bytes)
+        NULL,                     // Parameter
+        configMAX_PRIORITIES - 1, // Task priority
+        &MotorTimer::taskHandle,  // Task handle
+        0);                       // Core where the task should run
+}
@@ -6,21 +6,57 @@
 #include "DeskMotor.hpp"
 #include "Brake.hpp"
 
+// Schedules the steps of the desk motor and the brake. The hardware timer is armed one-shot for the next step edge of
+// whichever stepper is due first and the task sleeps in between. While the desk is parked it only wakes for a command
+// or when the cycle callback asked for it.
 class MotorTimer
 {
+    friend class MotorLoopBenchmark;
+    friend class DeskSimulatorGearbox;
+
+public:
+    // Returns the time (in us) till it has to run again, NO_CYCLE_DUE if only a command or a step has to wake the task.
+    using CycleCallback = uint32_t (*)();
+    static constexpr uint32_t NO_CYCLE_DUE{UINT32_MAX};
+
+private:
     static hw_timer_t *timerHandle;
-    static constexpr long iterationIntervalUS{10};
+    static TaskHandle_t taskHandle;
+    // Steps that are due within this time are executed right away instead of arming the timer for them.
+    static constexpr uint64_t minAlarmLeadUS{5u};
 
     static DeskMotor *deskMotor;
     static Brake *brake2;
+    // Runs at the start of every cycle of the motor task, before the steppers are serviced.
+    static CycleCallback cycleCallback;
+
+    // Absolute timer values (in us) at which the steppers are due next.
+    uint64_t deskMotorDueUS{NOT_DUE};
+    uint64_t brakeDueUS{NOT_DUE};
+    // Set if the steppers need to be serviced independent of their due time, e.g. after a new target was set.
+    std::atomic_bool wakeRequested{false};
+
+    static void IRAM_ATTR onTimerAlarm();
+    static uint64_t toDueTime(const uint64_t now, const uint32_t timeToNextStepUS);
+
+    // Runs the cycle callback and services the steppers, returns the time till the callback is due again.
+    uint32_t runCycle();
+    void serviceSteppers();
+    bool isStepping() const { return min(deskMotorDueUS, brakeDueUS) != NOT_DUE; }
+    void armTimer(const uint64_t dueUS);
 
 public:
+    static constexpr uint64_t NOT_DUE{UINT64_MAX};
     static MotorTimer *instance;
-    std::atomic_int dueTaskIterations;
 
-    MotorTimer(DeskMotor *const deskMotor, Brake *const brake2);
+    MotorTimer(DeskMotor *const deskMotor, Brake *const brake2, const CycleCallback cycleCallback);
     ~MotorTimer() = default;
 
     void startTimer();
     void runTask();
-};
\ No newline at end of file
+
+    // Wakes the motor task such that both steppers are serviced immediately. Has to be called whenever a stepper gets new work.
+    static void wake();
+    // Stops the desk motor and wakes the task, which halts the profile right away. Called by the emergency stop line.
+    static void IRAM_ATTR stopFromISR();
+};
@@ -46,6 +46,8 @@
 #define DESK_MOTOR_SPI_MISO 12
 #define DESK_MOTOR_SPI_SCK 14
 #define DESK_MOTOR_SPI_SS 15
+// The dcStep enable input of the TMC2130 (DCEN, CFG4 in SPI mode) is tied to 3.3 V, no GPIO is left for it. dcStep
+// only takes over above the speed that DeskMotor sets in VDCMIN.
 
 // Lightgates
 #define LIGHTGATE_LARGE_BRAKE_OPEN 39
@@ -56,6 +58,12 @@
 // Relay
 #define RELAY_3V 2 // for turning the motor control board on and off
 
+// Emergency stop line shared with the general controller and the other gearbox (EMERGENCY_STOP_LINE)
+#define EMERGENCY_STOP_LINE_PIN 4
+// Attention line to the general controller, low while events are pending (GEARBOX_ATTENTION_LINE). GPIO 0 is a
+// strapping pin, only this gearbox drives it, thus, the pull-up of the controller keeps it high while it boots.
+#define ATTENTION_LINE_PIN 0
+
 // Rotary Sensor
 #define ROTARY_SDA -1
 #define ROTARY_SCL -1
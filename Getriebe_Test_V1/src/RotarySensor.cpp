@@ -1,6 +1,8 @@
 #include "RotarySensor.hpp"
 #include "AS5600.h"
 #include "Wire.h"
+#include "LogMessages.hpp"
+#include <DeferredLog.hpp>
 
 AS5600 as5600; //  use default Wire
 
@@ -21,7 +23,7 @@ float RotarySensor::read() // returns corrected value (degrees?)
     float uncorrected = readRaw();
     // float corrected = Hysteresekurve ausgleichen + Startpunkt setzen (damit 0 Grad ganz unten, 360 Grad ganz oben)
     float corrected = uncorrected;  // for debugging purposes only
-    Serial.printf("corrected angle: %f\n", corrected);
+    DeferredLog::write(GearboxLog::ROTARY_CORRECTED_ANGLE, corrected);
     return corrected;
 }
 
@@ -29,7 +31,7 @@ float RotarySensor::readLinear() // returns corrected height in mm
 {
     corrected = read();                             // Drehwinkel in Grad
     linear = (corrected / 360) * maxTravelDistance; // aktuelle Höhe in mm
-    Serial.printf("Sensorhöhe: %f\n", linear);
+    DeferredLog::write(GearboxLog::ROTARY_HEIGHT, linear);
     return linear;
 }
 
@@ -40,6 +42,6 @@ float RotarySensor::readRaw() // returns uncorrected value
         setup();
     }
     rawValue = as5600.readAngle();
-    Serial.printf("uncorrected angle: %f\n", rawValue);
+    DeferredLog::write(GearboxLog::ROTARY_UNCORRECTED_ANGLE, rawValue);
     return rawValue;
 }
@@ -0,0 +1,210 @@
+#include "StepPulseGenerator.hpp"
+
+#ifdef DESK_MOTOR_RMT_STEPS
+
+#include <soc/rmt_reg.h>
+#include <soc/rmt_struct.h>
+
+StepPulseGenerator::StepPulseGenerator(const uint8_t stepPin, const uint8_t dirPin) : stepPin(stepPin), dirPin(dirPin)
+{
+}
+
+void StepPulseGenerator::begin()
+{
+    pinMode(dirPin, OUTPUT);
+
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX(static_cast<gpio_num_t>(stepPin), RMT_CHANNEL);
+    config.clk_div = RMT_CLOCK_DIVIDER;
+    config.tx_config.carrier_en = false;
+    config.tx_config.loop_en = false;
+    config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+    config.tx_config.idle_output_en = true;
+    rmt_config(&config);
+    // The output wraps around at the end of the channel RAM and goes on with the half that was refilled meanwhile.
+    RMT.apb_conf.mem_tx_wrap_en = 1u;
+    // Without the RMT driver, its interrupt would end the transmission once the items it was handed are sent.
+    rmt_isr_register(&StepPulseGenerator::onInterrupt, this, 0, nullptr);
+    rmt_set_tx_thr_intr_en(RMT_CHANNEL, true, HALF_ITEMS);
+    rmt_set_tx_intr_en(RMT_CHANNEL, true);
+
+    Serial.println("Step pulse generator initialized");
+}
+
+bool StepPulseGenerator::queueStep(const uint32_t intervalNS, const int8_t direction)
+{
+    if (hasPartialStep || (stepEdgeCount >= STEP_QUEUE_CAPACITY))
+    {
+        return false;
+    }
+    if (direction != queuedDirection)
+    {
+        // The direction pin may only change once the last step in the old direction is sent.
+        if (isRunning.load() || !items.isEmpty())
+        {
+            return false;
+        }
+        queuedDirection = direction;
+    }
+
+    // The interval is measured from rising edge to rising edge, every step starts low and ends with its high pulse.
+    const uint32_t intervalTicks = max(intervalNS / NS_PER_TICK, PULSE_WIDTH_TICKS + 1u);
+    partialLowTicks = intervalTicks - PULSE_WIDTH_TICKS;
+    hasPartialStep = true;
+    queuePartialStep();
+    return true;
+}
+
+void StepPulseGenerator::queuePartialStep()
+{
+    while (hasPartialStep && (items.size() < QUEUED_ITEMS))
+    {
+        if (partialLowTicks <= MAX_ITEM_TICKS)
+        {
+            const uint32_t edgeTicks = queuedTicks + partialLowTicks;
+            if (!pushItem(partialLowTicks, PULSE_WIDTH_TICKS))
+            {
+                return;
+            }
+            stepEdges[(firstStepEdge + stepEdgeCount) % STEP_QUEUE_CAPACITY] = edgeTicks;
+            stepEdgeCount++;
+            hasPartialStep = false;
+            return;
+        }
+
+        // Low time that does not fit into the item of the step is sent by items that are low for both halves. The last
+        // two share the rest, thus, no item is shorter than half of the max.
+        const uint32_t paddingTicks = (partialLowTicks > 2u * MAX_ITEM_TICKS) ? MAX_ITEM_TICKS : partialLowTicks / 2u;
+        if (!pushItem(paddingTicks, 0u))
+        {
+            return;
+        }
+        partialLowTicks -= paddingTicks;
+    }
+}
+
+bool StepPulseGenerator::pushItem(const uint32_t lowTicks, const uint32_t highTicks)
+{
+    rmt_item32_t item{};
+    item.level0 = 0u;
+    item.level1 = (highTicks > 0u) ? 1u : 0u;
+    item.duration0 = (highTicks > 0u) ? lowTicks : (lowTicks + 1u) / 2u;
+    item.duration1 = (highTicks > 0u) ? highTicks : lowTicks / 2u;
+    if (!items.push(item))
+    {
+        return false;
+    }
+    queuedTicks += lowTicks + highTicks;
+    return true;
+}
+
+void StepPulseGenerator::transmit()
+{
+    queuePartialStep();
+    if (isRunning.load() || items.isEmpty())
+    {
+        return;
+    }
+
+    if (queuedDirection != outputDirection)
+    {
+        digitalWrite(dirPin, queuedDirection > 0 ? HIGH : LOW);
+        outputDirection = queuedDirection;
+    }
+
+    // The interrupt only runs during a transmission, till then the motor task is the one that takes items from the
+    // queue.
+    isEnding = false;
+    refillOffset = 0u;
+    transmissionStartTicks = readTicks.load();
+    refillHalf(0u);
+    if (!isEnding)
+    {
+        refillHalf(HALF_ITEMS);
+    }
+    transmissions++;
+    isRunning.store(true);
+    transmissionStartUS = micros();
+    rmt_tx_start(RMT_CHANNEL, true);
+}
+
+void StepPulseGenerator::refillHalf(const size_t offset)
+{
+    rmt_item32_t half[HALF_ITEMS];
+    size_t count{0u};
+    uint32_t ticks{0u};
+    while ((count < HALF_ITEMS) && items.pop(half[count]))
+    {
+        ticks += half[count].duration0 + half[count].duration1;
+        count++;
+    }
+    if (count < HALF_ITEMS)
+    {
+        // An item with a zero duration ends the transmission once the output reaches it.
+        half[count].val = 0u;
+        count++;
+        isEnding = true;
+    }
+    rmt_fill_tx_items(RMT_CHANNEL, half, count, offset);
+    readTicks.store(readTicks.load() + ticks);
+}
+
+void StepPulseGenerator::onInterrupt(void *argument)
+{
+    StepPulseGenerator *const generator = static_cast<StepPulseGenerator *>(argument);
+    const uint32_t status = RMT.int_st.val;
+    if ((status & RMT_CH0_TX_THR_EVENT_INT_ST) != 0u)
+    {
+        RMT.int_clr.val = RMT_CH0_TX_THR_EVENT_INT_CLR;
+        // A half was sent, it is refilled while the other one is sent. Once the end marker is written, the rest of the
+        // transmission is in the channel RAM already.
+        if (!generator->isEnding)
+        {
+            generator->refillHalf(generator->refillOffset);
+            generator->refillOffset = (generator->refillOffset == 0u) ? HALF_ITEMS : 0u;
+            generator->refills.fetch_add(1u);
+        }
+    }
+    if ((status & RMT_CH0_TX_END_INT_ST) != 0u)
+    {
+        RMT.int_clr.val = RMT_CH0_TX_END_INT_CLR;
+        generator->isRunning.store(false);
+    }
+}
+
+uint32_t StepPulseGenerator::emittedTicks() const
+{
+    const uint32_t read = readTicks.load();
+    if (!isRunning.load())
+    {
+        return read;
+    }
+    // Items reach the channel RAM ahead of the output.
+    const uint32_t sentTicks = transmissionStartTicks + (micros() - transmissionStartUS) * TICKS_PER_US;
+    return (static_cast<int32_t>(sentTicks - read) < 0) ? sentTicks : read;
+}
+
+long StepPulseGenerator::pendingSteps()
+{
+    // Every step whose rising edge was sent is emitted.
+    const uint32_t emitted = emittedTicks();
+    while ((stepEdgeCount > 0u) && (static_cast<int32_t>(stepEdges[firstStepEdge] - emitted) <= 0))
+    {
+        firstStepEdge = (firstStepEdge + 1u) % STEP_QUEUE_CAPACITY;
+        stepEdgeCount--;
+    }
+    const size_t steps = stepEdgeCount + (hasPartialStep ? 1u : 0u);
+    return static_cast<long>(steps) * queuedDirection;
+}
+
+long StepPulseGenerator::discardQueuedSteps()
+{
+    if (!hasPartialStep)
+    {
+        return 0;
+    }
+    // The low items it queued already only delay the end of the transmission.
+    hasPartialStep = false;
+    return queuedDirection;
+}
+
+#endif
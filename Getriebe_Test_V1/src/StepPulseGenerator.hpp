@@ -0,0 +1,108 @@
+#pragma once
+
+#ifdef DESK_MOTOR_RMT_STEPS
+
+#include <Arduino.h>
+#include <atomic>
+#include <driver/rmt.h>
+#include <SpscRing.hpp>
+
+// Generates the step pulses of the desk motor with the RMT peripheral. Steps are queued as RMT items ahead of time and
+// sent in one transmission that runs as long as steps keep coming: the channel RAM is split into two halves, the
+// threshold interrupt refills the half that was just sent from the queue while the other half is sent. Thus, every step
+// keeps its interval, there is no restart between two batches of steps. The transmission only ends once the queue ran
+// dry, e.g. at the target or before a change of the direction.
+class StepPulseGenerator
+{
+private:
+    static constexpr rmt_channel_t RMT_CHANNEL{RMT_CHANNEL_0};
+    // The 80 MHz APB clock divided by 8 results in a resolution of 100 ns.
+    static constexpr uint8_t RMT_CLOCK_DIVIDER{8u};
+    static constexpr uint32_t NS_PER_TICK{100u};
+    static constexpr uint32_t TICKS_PER_US{1000u / NS_PER_TICK};
+    // Width of the high pulse, the TMC2130 requires at least 100 ns.
+    static constexpr uint32_t PULSE_WIDTH_TICKS{20u};
+    // Items of the channel RAM, one block, and of each of its halves.
+    static constexpr size_t CHANNEL_ITEMS{64u};
+    static constexpr size_t HALF_ITEMS{CHANNEL_ITEMS / 2u};
+    // Low times of slow steps are split into items of 50 to 100 us, which bounds how far the channel RAM and the queue
+    // reach ahead to 12.8 ms, independent of the speed.
+    static constexpr uint32_t MAX_ITEM_TICKS{1000u};
+    // The queue is topped up to this many items. Every refill takes a half of them, thus, the motor task may be late by
+    // the other half, 32 items of at least 50 us.
+    static constexpr size_t QUEUED_ITEMS{2u * HALF_ITEMS};
+    static constexpr size_t ITEM_QUEUE_CAPACITY{128u};
+    // Steps that are queued or in the channel RAM, at most one per item.
+    static constexpr size_t STEP_QUEUE_CAPACITY{256u};
+
+    const uint8_t stepPin;
+    const uint8_t dirPin;
+
+    // Filled by the motor task, emptied by the interrupt. While no transmission runs, the motor task starts the next
+    // one and fills the channel RAM itself.
+    SpscRing<rmt_item32_t, ITEM_QUEUE_CAPACITY> items;
+    // Sum of the durations of all items handed to the channel RAM, in ticks since the start. Wraps around.
+    std::atomic<uint32_t> readTicks{0u};
+    std::atomic<bool> isRunning{false};
+    // Only used by the interrupt while a transmission runs.
+    bool isEnding{false};
+    size_t refillOffset{0u};
+    std::atomic<uint32_t> refills{0u};
+
+    // Only used by the motor task.
+    // Sum of the durations of all queued items, in ticks since the start. Wraps around like readTicks.
+    uint32_t queuedTicks{0u};
+    // Rising edge of every step that was not yet emitted, in ticks since the start, oldest first.
+    uint32_t stepEdges[STEP_QUEUE_CAPACITY]{};
+    size_t firstStepEdge{0u};
+    size_t stepEdgeCount{0u};
+    int8_t queuedDirection{0};
+    int8_t outputDirection{0};
+    // Step whose items are not all queued yet, long low times take several items.
+    bool hasPartialStep{false};
+    uint32_t partialLowTicks{0u};
+    // Ticks since the start at which the running or last transmission started and the local time of its start.
+    uint32_t transmissionStartTicks{0u};
+    unsigned long transmissionStartUS{0u};
+    uint32_t transmissions{0u};
+
+    // Queues the items of the partial step as far as the queue has room.
+    void queuePartialStep();
+    bool pushItem(const uint32_t lowTicks, const uint32_t highTicks);
+    // Copies a half of the channel RAM worth of items from the queue to the channel RAM at the offset. An end marker
+    // follows the last item once the queue ran dry, the transmission stops there.
+    void refillHalf(const size_t offset);
+    // Ticks since the start up to which the output is sent.
+    uint32_t emittedTicks() const;
+    static void onInterrupt(void *argument);
+
+public:
+    StepPulseGenerator(const uint8_t stepPin, const uint8_t dirPin);
+    ~StepPulseGenerator() = default;
+
+    void begin();
+
+    // Whether the queue takes another step. It holds a few ms of steps, which bounds how far the motion is planned.
+    bool needsSteps() const { return !hasPartialStep && (items.size() < QUEUED_ITEMS); }
+    // Queues a step. Fails if the transmission still sends steps in the other direction, the step has to wait till it
+    // ended then.
+    bool queueStep(const uint32_t intervalNS, const int8_t direction);
+    // Tops up the queue with the rest of a slow step and starts a transmission if none runs. Called by every cycle of
+    // the motor task, at least every ms while steps are queued.
+    void transmit();
+    bool isTransmitting() const { return isRunning.load(); }
+    // Whether steps are queued that were not emitted yet.
+    bool hasPendingSteps() { return pendingSteps() != 0; }
+
+    // Steps that were queued but not yet emitted, signed by their direction.
+    long pendingSteps();
+    // Discards the step whose items are not all queued, the queued ones are still sent. Returns the number of discarded
+    // steps, signed by their direction.
+    long discardQueuedSteps();
+
+    // Statistics of the channel, e.g. for the benchmark.
+    uint32_t getTransmissions() const { return transmissions; }
+    uint32_t getRefills() const { return refills.load(); }
+};
+
+#endif
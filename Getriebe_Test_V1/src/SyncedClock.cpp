@@ -0,0 +1,26 @@
+#include "SyncedClock.hpp"
+
+SeqlockSnapshot<ClockSync::Mapping> SyncedClock::mapping;
+
+void SyncedClock::publish(const ClockSync::Mapping &newMapping)
+{
+    mapping.publish(newMapping);
+}
+
+ClockSync::Mapping SyncedClock::getMapping()
+{
+    ClockSync::Mapping currentMapping{};
+    mapping.read(currentMapping);
+    return currentMapping;
+}
+
+bool SyncedClock::isSynchronized()
+{
+    return getMapping().isSynchronized;
+}
+
+unsigned long syncedMicros()
+{
+    // The mapping starts at zero without drift, which leaves the local clock as it is.
+    return SyncedClock::getMapping().toReference(static_cast<uint32_t>(micros()));
+}
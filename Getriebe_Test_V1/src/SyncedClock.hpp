@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SeqlockSnapshot.hpp>
+#include <ClockSync.hpp>
+
+// Clock of the general controller as estimated from the time sync exchanges. The motor task publishes the mapping
+// after every exchange, any task or ISR converts with the last one without blocking.
+class SyncedClock
+{
+private:
+    static SeqlockSnapshot<ClockSync::Mapping> mapping;
+
+public:
+    static void publish(const ClockSync::Mapping &newMapping);
+    static ClockSync::Mapping getMapping();
+    static bool isSynchronized();
+};
+
+// micros() of the general controller, the local micros() till the first time sync arrived.
+unsigned long syncedMicros();
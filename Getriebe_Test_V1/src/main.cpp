@@ -5,24 +5,32 @@
 #include "Gearbox.hpp"
 #include "Pinout.hpp"
 #include "Communication.hpp"
-#include <esp_task_wdt.h>
-#include <chrono>
-#include <thread>
 #include "Pinout.hpp"
 #include "MotorTimer.hpp"
+#include "DriverMonitor.hpp"
+#include "LogMessages.hpp"
+#include <DeferredLog.hpp>
 
 static constexpr float gearboxSensorHeight = 0.0f;
 static constexpr float gearboxMathematicalHeight = 0.0f;
+// Rate at which the diagnostic registers of the desk motor driver are read.
+static constexpr uint32_t driverPollIntervalMS = 20u;
+// Rate at which buffered log records are sent over the serial port.
+static constexpr uint32_t logDrainIntervalMS = 50u;
 
 Communication communication{gearboxSensorHeight, gearboxMathematicalHeight};
-MotorTimer motorTimer{communication.getGearbox()->getDeskMotor(), communication.getGearbox()->getLargeBrake()};
+// Received I2C commands are executed by the motor task, thus, they never interrupt a step.
+MotorTimer motorTimer{communication.getGearbox()->getDeskMotor(), communication.getGearbox()->getLargeBrake(), []()
+                      { return communication.processCommands(); }};
+DriverMonitor driverMonitor{communication.getGearbox()->getDeskMotor(), driverPollIntervalMS};
 
 void setup()
 {
   Serial.begin(115200);
-  esp_task_wdt_init(UINT32_MAX, false);
-  esp_task_wdt_delete(NULL);
-
+#ifdef DEFERRED_LOG_TEXT
+  DeferredLog::setTextFormats(GearboxLogFormats);
+#endif
+  DeferredLog::startDrainTask(Serial, logDrainIntervalMS);
 
   // Initialize lightgate sensors.
   // pinMode(LIGHTGATE_LARGE_BRAKE_OPEN, INPUT_PULLUP);
@@ -31,8 +39,6 @@ void setup()
   Serial.print("Task1 is running on core ");
   Serial.println(xPortGetCoreID());
 
-  Serial.println("WDT diabled on core 0");
-
   // Initialize an i2c bus.
 }
 
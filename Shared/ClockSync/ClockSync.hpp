@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+
+// Estimates the clock of a reference, e.g. the general controller, from two-way exchanges in the style of PTP (IEEE
+// 1588): the reference sends at t1, this side receives at t2 and answers at t3, the reference has the answer at t4.
+// With the share of the round trip that the way here takes, the reference clock read t1 + share * round trip at the
+// local time t2. PTP assumes a symmetric link, i.e. a share of 0.5. Exchanges that took much longer than the fastest
+// recent one are dropped, their delays were most likely off the usual share. A PI servo
+// filters the offset and learns the drift of the local clock, thus, the mapping stays close between two exchanges.
+// Times are 32 bit us counters that wrap around, like micros() of the ESP32. Nothing in here depends on Arduino.
+class ClockSync
+{
+public:
+    // Times of one exchange, t1 and t4 on the clock of the reference, t2 and t3 on the local clock.
+    struct Sample
+    {
+        uint32_t t1;
+        uint32_t t2;
+        uint32_t t3;
+        uint32_t t4;
+    };
+
+    // Converts between local and reference time, valid for about half an hour around its anchor.
+    struct Mapping
+    {
+        uint32_t localUS;
+        uint32_t referenceUS;
+        // Rate of the reference clock relative to the local one, in ppm.
+        float driftPPM;
+        bool isSynchronized;
+
+        uint32_t toReference(const uint32_t local) const
+        {
+            const int32_t elapsedUS = static_cast<int32_t>(local - localUS);
+            return referenceUS + static_cast<uint32_t>(elapsedUS + static_cast<int32_t>(static_cast<float>(elapsedUS) * driftPPM * 1e-6f));
+        }
+
+        uint32_t toLocal(const uint32_t reference) const
+        {
+            const int32_t elapsedUS = static_cast<int32_t>(reference - referenceUS);
+            return localUS + static_cast<uint32_t>(elapsedUS - static_cast<int32_t>(static_cast<float>(elapsedUS) * driftPPM * 1e-6f));
+        }
+    };
+
+private:
+    // Larger errors are not filtered but stepped, e.g. at the first exchange or after the reference restarted.
+    static constexpr int32_t STEP_THRESHOLD_US{1000};
+    // Gains of the servo, the proportional part removes half of the error at every exchange.
+    static constexpr float KP{0.5f};
+    static constexpr float KI{0.1f};
+    // Crystals of the ESP32 boards are within tens of ppm, anything beyond is noise of the measurement.
+    static constexpr float MAX_DRIFT_PPM{200.0f};
+    // Exchanges whose round trip exceeds the fastest recent one by more than this are dropped.
+    static constexpr uint32_t MAX_ROUND_TRIP_SPREAD_US{100u};
+    // The fastest round trip creeps towards slower ones by this fraction (as shift), e.g. after the bus clock dropped.
+    static constexpr uint8_t ROUND_TRIP_AGING_SHIFT{4u};
+    // Accepted exchanges after a step till the mapping counts as synchronized.
+    static constexpr uint8_t SYNCHRONIZED_EXCHANGES{4u};
+
+    const float forwardShare;
+    Mapping mapping{0u, 0u, 0.0f, false};
+    bool hasMapping{false};
+    uint32_t minRoundTripUS{UINT32_MAX};
+    uint8_t acceptedExchanges{0u};
+    int32_t lastErrorUS{0};
+    uint32_t lastRoundTripUS{0u};
+    uint32_t droppedExchanges{0u};
+
+public:
+    explicit ClockSync(const float forwardShare = 0.5f) : forwardShare(forwardShare) {}
+    ~ClockSync() = default;
+
+    // Feeds one exchange into the estimate, returns false if it was dropped.
+    bool update(const Sample &sample)
+    {
+        const uint32_t roundTripUS = (sample.t4 - sample.t1) - (sample.t3 - sample.t2);
+        lastRoundTripUS = roundTripUS;
+        if (static_cast<int32_t>(roundTripUS) < 0)
+        {
+            // The answer took less time than the reference waited for it, the times do not belong together.
+            droppedExchanges++;
+            return false;
+        }
+        const bool isDelayed = (minRoundTripUS != UINT32_MAX) && (roundTripUS > minRoundTripUS + MAX_ROUND_TRIP_SPREAD_US);
+        minRoundTripUS = (roundTripUS < minRoundTripUS) ? roundTripUS : minRoundTripUS + ((roundTripUS - minRoundTripUS) >> ROUND_TRIP_AGING_SHIFT);
+        if (isDelayed)
+        {
+            droppedExchanges++;
+            return false;
+        }
+
+        const uint32_t referenceAtT2 = sample.t1 + static_cast<uint32_t>(forwardShare * static_cast<float>(roundTripUS));
+        const uint32_t estimateAtT2 = mapping.toReference(sample.t2);
+        lastErrorUS = static_cast<int32_t>(referenceAtT2 - estimateAtT2);
+        if (!hasMapping || (lastErrorUS > STEP_THRESHOLD_US) || (lastErrorUS < -STEP_THRESHOLD_US))
+        {
+            mapping.referenceUS = referenceAtT2;
+            mapping.localUS = sample.t2;
+            mapping.isSynchronized = false;
+            hasMapping = true;
+            acceptedExchanges = 1u;
+            return true;
+        }
+
+        // Right after a step, the error is the drift since the step, thus, it is taken over as a whole.
+        const bool isFirstAfterStep = acceptedExchanges == 1u;
+        const float ki = isFirstAfterStep ? 1.0f : KI;
+        const float kp = isFirstAfterStep ? 1.0f : KP;
+        const float intervalS = static_cast<float>(sample.t2 - mapping.localUS) * 1e-6f;
+        const float driftPPM = mapping.driftPPM + ((intervalS > 0.0f) ? ki * static_cast<float>(lastErrorUS) / intervalS : 0.0f);
+        mapping.driftPPM = (driftPPM > MAX_DRIFT_PPM) ? MAX_DRIFT_PPM : (driftPPM < -MAX_DRIFT_PPM) ? -MAX_DRIFT_PPM : driftPPM;
+        mapping.referenceUS = estimateAtT2 + static_cast<uint32_t>(static_cast<int32_t>(kp * static_cast<float>(lastErrorUS)));
+        mapping.localUS = sample.t2;
+        acceptedExchanges = (acceptedExchanges < SYNCHRONIZED_EXCHANGES) ? acceptedExchanges + 1u : acceptedExchanges;
+        mapping.isSynchronized = acceptedExchanges >= SYNCHRONIZED_EXCHANGES;
+        return true;
+    }
+
+    const Mapping &getMapping() const { return mapping; }
+    // Difference of the last accepted exchange to the estimate before it, positive if the local estimate was behind.
+    int32_t getLastErrorUS() const { return lastErrorUS; }
+    uint32_t getLastRoundTripUS() const { return lastRoundTripUS; }
+    uint32_t getDroppedExchanges() const { return droppedExchanges; }
+};
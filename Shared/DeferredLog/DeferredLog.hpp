@@ -0,0 +1,144 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <cstring>
+#include <MpscRing.hpp>
+#include "DeferredLogFormat.hpp"
+
+// Number of records the logger buffers until they are drained, has to be a power of two.
+#ifndef DEFERRED_LOG_CAPACITY
+#define DEFERRED_LOG_CAPACITY 64
+#endif
+
+// Logger that keeps the formatting and the serial output off the time critical code. Writing a message only stores its
+// id, a timestamp and up to four 32 bit arguments in a lock-free ring buffer, which takes about a microsecond and is
+// safe from any task. A low priority context drains the buffer and sends binary frames, that the host side decoder in
+// Tools/DeferredLogDecoder turns back into text. If the ring buffer is full, records are dropped and their number is
+// reported with the next drain.
+// Each firmware declares its messages with DEFERRED_LOG_CATALOG, see DeferredLogFormat.hpp. With setTextFormats the
+// drain prints text instead, which is handy while no decoder is at hand.
+class DeferredLog
+{
+public:
+    using Record = DeferredLogFormat::Record;
+
+private:
+    struct State
+    {
+        MpscRing<Record, DEFERRED_LOG_CAPACITY> records;
+        std::atomic<uint32_t> droppedRecords{0u};
+        const char *const *textFormats{nullptr};
+        size_t textFormatCount{0u};
+        Print *output{nullptr};
+        uint32_t drainIntervalMS{0u};
+    };
+
+    static State &state()
+    {
+        static State instance;
+        return instance;
+    }
+
+    template <typename T>
+    static uint32_t toArgument(const T argument) { return static_cast<uint32_t>(argument); }
+    static uint32_t toArgument(const float argument)
+    {
+        uint32_t bits;
+        memcpy(&bits, &argument, sizeof(bits));
+        return bits;
+    }
+    static uint32_t toArgument(const double argument) { return toArgument(static_cast<float>(argument)); }
+
+    static void emit(Print &output, const Record &record)
+    {
+        if (state().textFormats != nullptr)
+        {
+            char line[128u];
+            const size_t length =
+                DeferredLogFormat::formatLine(line, sizeof(line), record, state().textFormats, state().textFormatCount);
+            output.write(reinterpret_cast<const uint8_t *>(line), length);
+            output.write(reinterpret_cast<const uint8_t *>("\r\n"), 2u);
+        }
+        else
+        {
+            uint8_t frame[DeferredLogFormat::MAX_FRAME_SIZE];
+            output.write(frame, DeferredLogFormat::encodeFrame(record, frame));
+        }
+    }
+
+#ifdef ESP32
+    static void runDrainTask(void *)
+    {
+        while (true)
+        {
+            drain(*state().output, SIZE_MAX);
+            vTaskDelay(pdMS_TO_TICKS(state().drainIntervalMS));
+        }
+    }
+#endif
+
+public:
+    DeferredLog() = delete;
+
+    // Stores a message with up to four integer, enum or float arguments. Never blocks.
+    template <typename Id, typename... Args>
+    static void write(const Id id, const Args... arguments)
+    {
+        static_assert(sizeof...(Args) <= DeferredLogFormat::MAX_ARGUMENTS, "A record holds at most four arguments.");
+        const uint32_t packedArguments[] = {toArgument(arguments)..., 0u};
+
+        Record record;
+        record.timestampUS = micros();
+        record.formatId = static_cast<uint16_t>(id);
+        record.argumentCount = sizeof...(Args);
+        memcpy(record.arguments, packedArguments, sizeof(uint32_t) * sizeof...(Args));
+        if (!state().records.push(record))
+        {
+            state().droppedRecords.fetch_add(1u, std::memory_order_relaxed);
+        }
+    }
+
+    // Prints the records as text with the format strings of the catalog instead of sending binary frames.
+    template <size_t Count>
+    static void setTextFormats(const char *const (&formats)[Count])
+    {
+        state().textFormats = formats;
+        state().textFormatCount = Count;
+    }
+
+    // Sends up to maxRecords buffered records to the output. Must only be called from one context at a time.
+    // Returns the number of sent records.
+    static size_t drain(Print &output, const size_t maxRecords)
+    {
+        size_t sentRecords = 0u;
+        const uint32_t dropped = state().droppedRecords.exchange(0u, std::memory_order_relaxed);
+        if (dropped > 0u)
+        {
+            Record record;
+            record.timestampUS = micros();
+            record.formatId = DeferredLogFormat::DROPPED_RECORDS_ID;
+            record.argumentCount = 1u;
+            record.arguments[0u] = dropped;
+            emit(output, record);
+        }
+
+        Record record;
+        while (sentRecords < maxRecords && state().records.pop(record))
+        {
+            emit(output, record);
+            sentRecords++;
+        }
+        return sentRecords;
+    }
+
+#ifdef ESP32
+    // Starts a low priority task that drains the buffer to the output every drainIntervalMS.
+    static void startDrainTask(Print &output, const uint32_t drainIntervalMS)
+    {
+        state().output = &output;
+        state().drainIntervalMS = drainIntervalMS;
+        xTaskCreatePinnedToCore(runDrainTask, "DeferredLogTask", 4096, nullptr, 1, nullptr, 1);
+    }
+#endif
+};
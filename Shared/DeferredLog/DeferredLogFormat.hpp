@@ -0,0 +1,283 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// Parts of the deferred logger that the firmwares and the host decoder share: the message catalogs, the binary frame of
+// a record and the formatting of a record into text. Nothing in here depends on Arduino.
+
+// Declares the messages of a firmware. LIST is an X-macro that is called with X(ID, "format") for every message, which
+// results in the enum class Name with the message ids and the array NameFormats with the format strings. Id zero is
+// reserved for the number of records that the logger dropped. The format strings support the printf conversions
+// d, i, u, x, X, o, c, e, f and g (length modifiers are ignored, every argument is 32 bit) and %{Zero|One|...}, which
+// prints the name with the index of the argument, e.g. for enums.
+#define DEFERRED_LOG_ENUM_ENTRY(id, format) id,
+#define DEFERRED_LOG_FORMAT_ENTRY(id, format) format,
+#define DEFERRED_LOG_CATALOG(Name, LIST)                                                        \
+    enum class Name : uint16_t                                                                   \
+    {                                                                                            \
+        DROPPED_RECORDS,                                                                         \
+        LIST(DEFERRED_LOG_ENUM_ENTRY) Count                                                      \
+    };                                                                                           \
+    static constexpr const char *const Name##Formats[] = {                                      \
+        "Log buffer full, dropped records: %u",                                                  \
+        LIST(DEFERRED_LOG_FORMAT_ENTRY)};                                                        \
+    static_assert(sizeof(Name##Formats) / sizeof(Name##Formats[0]) == static_cast<size_t>(Name::Count), \
+                  "Every message needs a format string.")
+
+namespace DeferredLogFormat
+{
+    static constexpr uint8_t MAX_ARGUMENTS{4u};
+    static constexpr uint16_t DROPPED_RECORDS_ID{0u};
+
+    struct Record
+    {
+        uint32_t timestampUS{0u};
+        uint16_t formatId{0u};
+        uint8_t argumentCount{0u};
+        uint32_t arguments[MAX_ARGUMENTS]{};
+    };
+
+    // A frame is the magic bytes, the little endian record and a checksum, which lets the decoder find the start of a
+    // record in the middle of a stream that also contains plain text.
+    static constexpr uint8_t FRAME_MAGIC[2u]{0xA5u, 0x5Au};
+    static constexpr size_t FRAME_HEADER_SIZE{2u + 4u + 2u + 1u};
+    static constexpr size_t MAX_FRAME_SIZE{FRAME_HEADER_SIZE + 4u * MAX_ARGUMENTS + 1u};
+
+    inline size_t frameSize(const uint8_t argumentCount)
+    {
+        return FRAME_HEADER_SIZE + 4u * argumentCount + 1u;
+    }
+
+    inline void writeUint32(uint8_t *buffer, const uint32_t value)
+    {
+        buffer[0u] = static_cast<uint8_t>(value);
+        buffer[1u] = static_cast<uint8_t>(value >> 8u);
+        buffer[2u] = static_cast<uint8_t>(value >> 16u);
+        buffer[3u] = static_cast<uint8_t>(value >> 24u);
+    }
+
+    inline uint32_t readUint32(const uint8_t *buffer)
+    {
+        return static_cast<uint32_t>(buffer[0u]) | (static_cast<uint32_t>(buffer[1u]) << 8u) |
+               (static_cast<uint32_t>(buffer[2u]) << 16u) | (static_cast<uint32_t>(buffer[3u]) << 24u);
+    }
+
+    inline uint8_t checksum(const uint8_t *buffer, const size_t size)
+    {
+        uint8_t result = 0u;
+        for (size_t i = 0u; i < size; i++)
+        {
+            result ^= buffer[i];
+        }
+        return result;
+    }
+
+    // Writes the frame of the record into the buffer, which has to hold MAX_FRAME_SIZE bytes. Returns the frame size.
+    inline size_t encodeFrame(const Record &record, uint8_t *buffer)
+    {
+        const uint8_t argumentCount = record.argumentCount <= MAX_ARGUMENTS ? record.argumentCount : MAX_ARGUMENTS;
+        buffer[0u] = FRAME_MAGIC[0u];
+        buffer[1u] = FRAME_MAGIC[1u];
+        writeUint32(&buffer[2u], record.timestampUS);
+        buffer[6u] = static_cast<uint8_t>(record.formatId);
+        buffer[7u] = static_cast<uint8_t>(record.formatId >> 8u);
+        buffer[8u] = argumentCount;
+        for (uint8_t i = 0u; i < argumentCount; i++)
+        {
+            writeUint32(&buffer[FRAME_HEADER_SIZE + 4u * i], record.arguments[i]);
+        }
+        const size_t size = frameSize(argumentCount);
+        buffer[size - 1u] = checksum(&buffer[2u], size - 3u);
+        return size;
+    }
+
+    // Reads the frame at the start of the buffer. Returns the frame size or zero if the bytes are no valid frame, which
+    // includes frames that are not complete yet.
+    inline size_t decodeFrame(const uint8_t *buffer, const size_t size, Record &record)
+    {
+        if (size < FRAME_HEADER_SIZE || buffer[0u] != FRAME_MAGIC[0u] || buffer[1u] != FRAME_MAGIC[1u] ||
+            buffer[8u] > MAX_ARGUMENTS)
+        {
+            return 0u;
+        }
+        const size_t recordFrameSize = frameSize(buffer[8u]);
+        if (size < recordFrameSize || checksum(&buffer[2u], recordFrameSize - 3u) != buffer[recordFrameSize - 1u])
+        {
+            return 0u;
+        }
+
+        record.timestampUS = readUint32(&buffer[2u]);
+        record.formatId = static_cast<uint16_t>(buffer[6u] | (buffer[7u] << 8u));
+        record.argumentCount = buffer[8u];
+        for (uint8_t i = 0u; i < record.argumentCount; i++)
+        {
+            record.arguments[i] = readUint32(&buffer[FRAME_HEADER_SIZE + 4u * i]);
+        }
+        return recordFrameSize;
+    }
+
+    // Appends the name with the given index of a %{Zero|One|...} conversion, or the index itself if there is no such name.
+    // Returns the position after the closing brace.
+    inline const char *formatName(const char *names, const uint32_t index, char *&output, const char *const end)
+    {
+        uint32_t currentIndex = 0u;
+        bool isFound = false;
+        const char *position = names;
+        for (; *position != '\0' && *position != '}'; position++)
+        {
+            if (*position == '|')
+            {
+                currentIndex++;
+            }
+            else if (currentIndex == index)
+            {
+                isFound = true;
+                if (output < end)
+                {
+                    *output++ = *position;
+                }
+            }
+        }
+
+        if (!isFound)
+        {
+            const size_t remaining = end - output + 1u;
+            const int written = snprintf(output, remaining, "%lu", static_cast<unsigned long>(index));
+            if (written > 0)
+            {
+                output += static_cast<size_t>(written) < remaining ? static_cast<size_t>(written) : remaining - 1u;
+            }
+        }
+        return *position == '}' ? position + 1 : position;
+    }
+
+    // Formats the arguments of a record with its format string. Returns the length of the text, which is truncated to
+    // fit into the buffer including the terminating null.
+    inline size_t format(char *buffer, const size_t size, const char *formatString, const uint32_t *arguments,
+                         const uint8_t argumentCount)
+    {
+        if (size == 0u)
+        {
+            return 0u;
+        }
+        char *output = buffer;
+        const char *const end = buffer + size - 1u;
+        uint8_t argumentIndex = 0u;
+        const char *position = formatString;
+
+        while (*position != '\0' && output < end)
+        {
+            if (*position != '%')
+            {
+                *output++ = *position++;
+                continue;
+            }
+            position++;
+            if (*position == '%')
+            {
+                *output++ = *position++;
+                continue;
+            }
+
+            const uint32_t argument = argumentIndex < argumentCount ? arguments[argumentIndex] : 0u;
+            argumentIndex++;
+            if (*position == '{')
+            {
+                position = formatName(position + 1, argument, output, end);
+                continue;
+            }
+
+            // Copy flags, width and precision, skip length modifiers, the argument size is fixed.
+            char specification[16u]{'%'};
+            size_t specificationLength = 1u;
+            while (*position != '\0' && strchr("-+ #0123456789.", *position) != nullptr)
+            {
+                if (specificationLength < sizeof(specification) - 3u)
+                {
+                    specification[specificationLength++] = *position;
+                }
+                position++;
+            }
+            while (*position != '\0' && strchr("hlLqjzt", *position) != nullptr)
+            {
+                position++;
+            }
+            const char conversion = *position;
+            if (conversion == '\0')
+            {
+                break;
+            }
+            position++;
+
+            int written = 0;
+            const size_t remaining = end - output + 1u;
+            switch (conversion)
+            {
+            case 'd':
+            case 'i':
+                specification[specificationLength++] = 'l';
+                specification[specificationLength++] = 'd';
+                written = snprintf(output, remaining, specification, static_cast<long>(static_cast<int32_t>(argument)));
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                specification[specificationLength++] = 'l';
+                specification[specificationLength++] = conversion;
+                written = snprintf(output, remaining, specification, static_cast<unsigned long>(argument));
+                break;
+            case 'c':
+                specification[specificationLength++] = 'c';
+                written = snprintf(output, remaining, specification, static_cast<int>(argument & 0xFFu));
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            {
+                float value;
+                memcpy(&value, &argument, sizeof(value));
+                specification[specificationLength++] = conversion;
+                written = snprintf(output, remaining, specification, static_cast<double>(value));
+                break;
+            }
+            default:
+                // Strings and pointers cannot be deferred.
+                written = snprintf(output, remaining, "<%%%c>", conversion);
+                break;
+            }
+            if (written > 0)
+            {
+                output += static_cast<size_t>(written) < remaining ? static_cast<size_t>(written) : remaining - 1u;
+            }
+        }
+
+        *output = '\0';
+        return static_cast<size_t>(output - buffer);
+    }
+
+    // Formats a whole log line "[seconds.micros] message" without line break. Records with an id that is not part of
+    // the catalog are printed with their raw arguments.
+    inline size_t formatLine(char *buffer, const size_t size, const Record &record, const char *const *formats,
+                             const size_t formatCount)
+    {
+        const int prefixLength = snprintf(buffer, size, "[%5lu.%06lu] ",
+                                          static_cast<unsigned long>(record.timestampUS / 1000000u),
+                                          static_cast<unsigned long>(record.timestampUS % 1000000u));
+        if (prefixLength < 0 || static_cast<size_t>(prefixLength) >= size)
+        {
+            return size > 0u ? strlen(buffer) : 0u;
+        }
+
+        const char *formatString = record.formatId < formatCount ? formats[record.formatId]
+                                                                   : "Unknown message, arguments: %x %x %x %x";
+        return prefixLength + format(buffer + prefixLength, size - prefixLength, formatString, record.arguments,
+                                     record.argumentCount);
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// Open-drain emergency stop line between the general controller and the gearboxes, active low with a pull-up. Any
+// board pulls it low for a moment, the others see the falling edge in their ISR right away, long before a command
+// could arrive over I2C. A board never drives the line high, thus, boards never fight over it.
+class EmergencyStopLine
+{
+public:
+    // Called by the ISR, it may only touch atomics and wake tasks.
+    using Handler = void (*)();
+
+private:
+    // The line stays low at least this long, such that every board sees the edge.
+    static constexpr unsigned long PULL_DURATION_US{1000u};
+
+    const uint8_t pin;
+    const Handler handler;
+    std::atomic_bool isPulling{false};
+    std::atomic_bool isTriggered{false};
+    unsigned long pulledUS{0u};
+
+    static void IRAM_ATTR onFallingEdge(void *argument)
+    {
+        EmergencyStopLine *const line = static_cast<EmergencyStopLine *>(argument);
+        if (line->isPulling)
+        {
+            // This board pulled the line itself.
+            return;
+        }
+        line->isTriggered = true;
+        if (line->handler != nullptr)
+        {
+            line->handler();
+        }
+    }
+
+public:
+    explicit EmergencyStopLine(const uint8_t pin, const Handler handler = nullptr) : pin(pin), handler(handler)
+    {
+        digitalWrite(pin, HIGH);
+        pinMode(pin, OUTPUT_OPEN_DRAIN | PULLUP);
+        attachInterruptArg(digitalPinToInterrupt(pin), &EmergencyStopLine::onFallingEdge, this, FALLING);
+    }
+    ~EmergencyStopLine() { detachInterrupt(digitalPinToInterrupt(pin)); }
+
+    // Pulls the line low, update() releases it again.
+    void pull()
+    {
+        if (isPulling)
+        {
+            return;
+        }
+        pulledUS = micros();
+        isPulling = true;
+        digitalWrite(pin, LOW);
+    }
+
+    // Releases the line once it was low long enough, called regularly by the task that pulls it.
+    void update()
+    {
+        if (isPulling && (micros() - pulledUS >= PULL_DURATION_US))
+        {
+            digitalWrite(pin, HIGH);
+            isPulling = false;
+        }
+    }
+
+    bool isPulled() const { return isPulling; }
+    // Time till update() releases the line, only valid while it is pulled.
+    unsigned long getReleaseDelayUS() const
+    {
+        const unsigned long pulledForUS = micros() - pulledUS;
+        return (pulledForUS < PULL_DURATION_US) ? (PULL_DURATION_US - pulledForUS) : 0u;
+    }
+
+    // Returns true once after another board pulled the line.
+    bool takeTrigger() { return isTriggered.exchange(false); }
+};
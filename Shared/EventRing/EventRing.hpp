@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <SpscRing.hpp>
+
+// Fixed-capacity ring of events from one producer to one consumer, e.g. button events from the task that reads the
+// control panel to the control task. The events are copied into the ring, thus, neither side allocates. The producer
+// never waits for the consumer, an event that does not fit is dropped and counted, such that the consumer can report
+// the loss.
+template <typename T, size_t Capacity>
+class EventRing
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Events are copied into the ring, they may not own resources.");
+
+private:
+    SpscRing<T, Capacity> events;
+    // Only written by the producer.
+    std::atomic<uint32_t> overflows{0u};
+
+public:
+    EventRing() = default;
+    ~EventRing() = default;
+    EventRing(const EventRing &) = delete;
+    EventRing &operator=(const EventRing &) = delete;
+
+    // Producer side. Returns false and counts the event as an overflow if the ring is full.
+    bool push(const T &event)
+    {
+        if (!events.push(event))
+        {
+            overflows.fetch_add(1u, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // Consumer side. Returns false if the ring is empty.
+    bool pop(T &event) { return events.pop(event); }
+
+    // Events dropped since the start.
+    uint32_t getOverflows() const { return overflows.load(std::memory_order_relaxed); }
+    // Only a snapshot, the other side might change it right after.
+    size_t size() const { return events.size(); }
+    bool isEmpty() const { return events.isEmpty(); }
+    static constexpr size_t capacity() { return Capacity; }
+};
@@ -0,0 +1,421 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Frames between the general controller and the gearboxes, shared by both firmwares. Nothing in here depends on
+// Arduino, all values are little endian.
+//
+// Command (controller to gearbox):
+//   version | sequence | command | payload length | payload | CRC-8
+// The payload starts with the motion of the other gearbox (position, speed, age of both), followed by the arguments of
+// the command. A gearbox ignores payload bytes it does not know, thus, newer controllers may append arguments.
+// Broadcasts go to the general call address and reach both gearboxes with the same bus edge. Their command code has
+// BROADCAST_FLAG set and the payload starts with the motion of the left gearbox, followed by the one of the right one.
+// They are not answered, the controller reads the status of each gearbox afterwards.
+//
+// Status (gearbox to controller, the reply to every read):
+//   version | sequence | flags | position | speed | brake state | skipped steps | age | events | CRC-8
+// The sequence is the one of the last command that the gearbox accepted, which tells the controller whether its command
+// arrived. The events are latched by the gearbox till a status reply carried them, see EVENT_MOTION_STARTED. The CRC-8
+// (polynomial 0x07, the SMBus PEC) covers everything before it.
+//
+// Time sync reply (gearbox to controller, answers the first read after CMD_TIME_SYNC instead of the status):
+//   version with TIME_SYNC_REPLY_FLAG | sequence | receive time | reply time | reserved | CRC-8
+// Both times are micros() of the gearbox. The reply has the length of a status, thus, it answers any read, also one that
+// the controller started before the gearbox handled the command. The next CMD_TIME_SYNC carries the times of the
+// controller for the exchange, the gearbox estimates the clock of the controller from all four, see ClockSync.
+namespace GearboxProtocol
+{
+    static constexpr uint8_t VERSION{3u};
+
+    // Command codes, the letters of the first protocol version.
+    static constexpr uint8_t CMD_MOVE_UP{'u'};
+    static constexpr uint8_t CMD_MOVE_DOWN{'d'};
+    static constexpr uint8_t CMD_MOVE_TO{'m'};
+    static constexpr uint8_t CMD_EMERGENCY_STOP{'e'};
+    static constexpr uint8_t CMD_GET_POSITION{'p'};
+    static constexpr uint8_t CMD_LOOSEN_BRAKE{'l'};
+    static constexpr uint8_t CMD_FASTEN_BRAKE{'f'};
+    static constexpr uint8_t CMD_TOGGLE_MOTOR_CONTROL{'c'};
+    static constexpr uint8_t CMD_TOGGLE_MOTOR_CONTROL_POWER{'t'};
+    // Moves at a speed till the lease runs out, each jog renews it. A lease of zero ends the jog.
+    static constexpr uint8_t CMD_JOG{'j'};
+    // Moves to the target like CMD_MOVE_TO, but only starts at the start time on the clock of the controller if both
+    // gearboxes reported a synchronized clock, otherwise once the delay since the reception is over. Broadcast to both
+    // gearboxes, they start at the same time and follow the same profile.
+    static constexpr uint8_t CMD_SEGMENT{'s'};
+    // Exchange of time stamps, the next read returns a time sync reply instead of the status.
+    static constexpr uint8_t CMD_TIME_SYNC{'k'};
+    // Set in the command code of a broadcast, the codes above are ASCII letters.
+    static constexpr uint8_t BROADCAST_FLAG{0x80u};
+    // I2C general call address, acknowledged by all slaves that accept general calls.
+    static constexpr uint8_t BROADCAST_ADDRESS{0x00u};
+    // Set in the version byte of a time sync reply, which tells it apart from a status.
+    static constexpr uint8_t TIME_SYNC_REPLY_FLAG{0x80u};
+
+    // Bits of the status flags.
+    static constexpr uint8_t FLAG_MOVING{1u << 0u};
+    static constexpr uint8_t FLAG_MOTOR_CONTROL{1u << 1u};
+    static constexpr uint8_t FLAG_MOTOR_CONTROL_POWER{1u << 2u};
+    // A command since the last read was dropped, because it was corrupted or did not fit into the mailbox.
+    static constexpr uint8_t FLAG_COMMAND_LOST{1u << 3u};
+    // The gearbox estimates the clock of the controller, see ClockSync.
+    static constexpr uint8_t FLAG_CLOCK_SYNCHRONIZED{1u << 4u};
+    // The gearbox holds a segment, it waits for its start or follows it. Cleared by any other motion command and by an
+    // emergency stop.
+    static constexpr uint8_t FLAG_SEGMENT_ACTIVE{1u << 5u};
+
+    // Bits of the status events, each one is reported once.
+    static constexpr uint8_t EVENT_MOTION_STARTED{1u << 0u};
+    // Also raised once the motor reached its target.
+    static constexpr uint8_t EVENT_MOTION_STOPPED{1u << 1u};
+    // The driver lost steps.
+    static constexpr uint8_t EVENT_STALL{1u << 2u};
+    static constexpr uint8_t EVENT_BRAKE_CHANGED{1u << 3u};
+    // The other gearbox was too far away, the gearbox stopped.
+    static constexpr uint8_t EVENT_DEVIATION_LIMIT{1u << 4u};
+    // The driver reported overtemperature or a short to ground.
+    static constexpr uint8_t EVENT_DRIVER_FAULT{1u << 5u};
+
+    static constexpr size_t COMMAND_HEADER_LENGTH{4u};
+    static constexpr size_t CRC_LENGTH{1u};
+    static constexpr size_t MOTION_LENGTH{8u};
+    static constexpr size_t MAX_ARGUMENTS_LENGTH{13u};
+    static constexpr size_t MAX_COMMAND_LENGTH{COMMAND_HEADER_LENGTH + (2u * MOTION_LENGTH) + MAX_ARGUMENTS_LENGTH + CRC_LENGTH};
+    static constexpr size_t STATUS_LENGTH{3u + 4u + 2u + 1u + 2u + 2u + 1u + CRC_LENGTH};
+    static constexpr size_t TIME_SYNC_REPLY_LENGTH{STATUS_LENGTH};
+
+    // Position and speed (steps/s) of a gearbox, and how long ago they were sampled.
+    struct Motion
+    {
+        uint32_t position;
+        int16_t speed;
+        uint16_t ageUS;
+    };
+
+    struct Command
+    {
+        uint8_t sequence;
+        uint8_t code;
+        // Motion of the other gearbox.
+        Motion peer;
+        // Only used by CMD_MOVE_TO and CMD_SEGMENT.
+        uint32_t targetPosition;
+        // Only used by the toggle commands.
+        bool isEnabled;
+        // Only used by CMD_JOG: 1 moves up and -1 down, the speed in steps/s (zero for the max speed) and the lease.
+        int8_t jogDirection;
+        uint16_t jogSpeed;
+        uint16_t leaseMS;
+        // Only used by CMD_SEGMENT: the speed in steps/s (zero for the max speed), the delay of the start after the
+        // reception and the start in us of the controller, which is only valid if the start is synchronized.
+        uint16_t segmentSpeed;
+        uint16_t startDelayUS;
+        uint32_t startUS;
+        bool isStartSynchronized;
+        // Only used by CMD_TIME_SYNC: sequence of the previous time sync with the gearbox, the time the controller
+        // finished its write and the time the reply arrived, in us of the controller.
+        uint8_t previousSyncSequence;
+        uint32_t previousSyncWrittenUS;
+        uint32_t previousSyncReadUS;
+    };
+
+    struct Status
+    {
+        uint8_t sequence;
+        uint8_t flags;
+        Motion motion;
+        uint8_t brakeState;
+        // Steps the driver lost since start, wraps around.
+        uint16_t skippedSteps;
+        // Events since the last reply, see EVENT_MOTION_STARTED.
+        uint8_t events;
+    };
+
+    struct TimeSyncReply
+    {
+        uint8_t sequence;
+        // micros() of the gearbox when the command arrived and when the read started.
+        uint32_t receivedUS;
+        uint32_t repliedUS;
+    };
+
+    enum class DecodeResult : uint8_t
+    {
+        Ok,
+        TooShort,
+        WrongVersion,
+        WrongLength,
+        WrongCrc,
+    };
+
+    // CRC of every nibble, the request handler computes a CRC for every read.
+    static constexpr uint8_t CRC_NIBBLE_TABLE[16u]{0x00u, 0x07u, 0x0Eu, 0x09u, 0x1Cu, 0x1Bu, 0x12u, 0x15u,
+                                                   0x38u, 0x3Fu, 0x36u, 0x31u, 0x24u, 0x23u, 0x2Au, 0x2Du};
+
+    constexpr uint8_t crc8Nibble(const uint8_t crc, const uint8_t nibble)
+    {
+        return static_cast<uint8_t>((crc << 4u) ^ CRC_NIBBLE_TABLE[((crc >> 4u) ^ nibble) & 0x0Fu]);
+    }
+
+    constexpr uint8_t crc8(const uint8_t *data, const size_t length, const uint8_t crc = 0u)
+    {
+        return length == 0u ? crc : crc8(data + 1, length - 1u, crc8Nibble(crc8Nibble(crc, *data >> 4u), *data & 0x0Fu));
+    }
+
+    static constexpr uint8_t CRC_CHECK_INPUT[]{'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    static_assert(crc8(CRC_CHECK_INPUT, sizeof(CRC_CHECK_INPUT)) == 0xF4u, "CRC-8 has to match the SMBus PEC.");
+
+    // Length of the arguments that follow the motion of the other gearbox.
+    constexpr size_t argumentsLength(const uint8_t code)
+    {
+        return code == CMD_MOVE_TO ? 4u : code == CMD_JOG ? 5u : code == CMD_SEGMENT ? 13u : code == CMD_TIME_SYNC ? 9u : ((code == CMD_TOGGLE_MOTOR_CONTROL) || (code == CMD_TOGGLE_MOTOR_CONTROL_POWER)) ? 1u : 0u;
+    }
+
+    constexpr size_t commandLength(const uint8_t code)
+    {
+        return COMMAND_HEADER_LENGTH + MOTION_LENGTH + argumentsLength(code) + CRC_LENGTH;
+    }
+
+    inline void writeUint16(uint8_t *buffer, const uint16_t value)
+    {
+        buffer[0u] = static_cast<uint8_t>(value);
+        buffer[1u] = static_cast<uint8_t>(value >> 8u);
+    }
+
+    inline void writeUint32(uint8_t *buffer, const uint32_t value)
+    {
+        writeUint16(buffer, static_cast<uint16_t>(value));
+        writeUint16(buffer + 2, static_cast<uint16_t>(value >> 16u));
+    }
+
+    inline uint16_t readUint16(const uint8_t *buffer)
+    {
+        return static_cast<uint16_t>(buffer[0u] | (buffer[1u] << 8u));
+    }
+
+    inline uint32_t readUint32(const uint8_t *buffer)
+    {
+        return static_cast<uint32_t>(readUint16(buffer)) | (static_cast<uint32_t>(readUint16(buffer + 2)) << 16u);
+    }
+
+    inline void writeMotion(uint8_t *buffer, const Motion &motion)
+    {
+        writeUint32(buffer, motion.position);
+        writeUint16(buffer + 4, static_cast<uint16_t>(motion.speed));
+        writeUint16(buffer + 6, motion.ageUS);
+    }
+
+    inline Motion readMotion(const uint8_t *buffer)
+    {
+        Motion motion{};
+        motion.position = readUint32(buffer);
+        motion.speed = static_cast<int16_t>(readUint16(buffer + 4));
+        motion.ageUS = readUint16(buffer + 6);
+        return motion;
+    }
+
+    // Writes header, motions, arguments and CRC of a command frame, returns the length.
+    inline size_t encodeFrame(const Command &command, const uint8_t code, const Motion *motions, const size_t motionCount, uint8_t *buffer)
+    {
+        const size_t motionsSize = motionCount * MOTION_LENGTH;
+        const size_t argumentsSize = argumentsLength(command.code);
+        buffer[0u] = VERSION;
+        buffer[1u] = command.sequence;
+        buffer[2u] = code;
+        buffer[3u] = static_cast<uint8_t>(motionsSize + argumentsSize);
+        uint8_t *const payload = buffer + COMMAND_HEADER_LENGTH;
+        for (size_t i = 0u; i < motionCount; i++)
+        {
+            writeMotion(payload + (i * MOTION_LENGTH), motions[i]);
+        }
+        if (command.code == CMD_MOVE_TO)
+        {
+            writeUint32(payload + motionsSize, command.targetPosition);
+        }
+        else if (command.code == CMD_SEGMENT)
+        {
+            writeUint32(payload + motionsSize, command.targetPosition);
+            writeUint16(payload + motionsSize + 4, command.segmentSpeed);
+            writeUint16(payload + motionsSize + 6, command.startDelayUS);
+            writeUint32(payload + motionsSize + 8, command.startUS);
+            payload[motionsSize + 12] = command.isStartSynchronized ? 1u : 0u;
+        }
+        else if (command.code == CMD_TIME_SYNC)
+        {
+            payload[motionsSize] = command.previousSyncSequence;
+            writeUint32(payload + motionsSize + 1, command.previousSyncWrittenUS);
+            writeUint32(payload + motionsSize + 5, command.previousSyncReadUS);
+        }
+        else if (command.code == CMD_JOG)
+        {
+            payload[motionsSize] = static_cast<uint8_t>(command.jogDirection);
+            writeUint16(payload + motionsSize + 1, command.jogSpeed);
+            writeUint16(payload + motionsSize + 3, command.leaseMS);
+        }
+        else if (argumentsSize == 1u)
+        {
+            payload[motionsSize] = command.isEnabled ? 1u : 0u;
+        }
+
+        const size_t crcIndex = COMMAND_HEADER_LENGTH + motionsSize + argumentsSize;
+        buffer[crcIndex] = crc8(buffer, crcIndex);
+        return crcIndex + CRC_LENGTH;
+    }
+
+    // Writes the frame of the command into the buffer, which has to hold MAX_COMMAND_LENGTH bytes. Returns the length.
+    inline size_t encodeCommand(const Command &command, uint8_t *buffer)
+    {
+        return encodeFrame(command, command.code, &command.peer, 1u, buffer);
+    }
+
+    // Same as encodeCommand() for a broadcast, the peer of the command is ignored.
+    inline size_t encodeBroadcast(const Command &command, const Motion &left, const Motion &right, uint8_t *buffer)
+    {
+        const Motion motions[2u]{left, right};
+        return encodeFrame(command, static_cast<uint8_t>(command.code | BROADCAST_FLAG), motions, 2u, buffer);
+    }
+
+    // Decodes a command or a broadcast. Of a broadcast, the motion of the other gearbox becomes the peer.
+    inline DecodeResult decodeCommand(const uint8_t *buffer, const size_t length, Command &command, const bool isLeftGearbox)
+    {
+        if (length < COMMAND_HEADER_LENGTH + CRC_LENGTH)
+        {
+            return DecodeResult::TooShort;
+        }
+        if (buffer[0u] != VERSION)
+        {
+            return DecodeResult::WrongVersion;
+        }
+        const bool isBroadcast = (buffer[2u] & BROADCAST_FLAG) != 0u;
+        const uint8_t code = static_cast<uint8_t>(buffer[2u] & ~BROADCAST_FLAG);
+        const size_t motionsLength = isBroadcast ? 2u * MOTION_LENGTH : MOTION_LENGTH;
+        const size_t payloadLength = buffer[3u];
+        if ((length != COMMAND_HEADER_LENGTH + payloadLength + CRC_LENGTH) || (payloadLength < motionsLength + argumentsLength(code)))
+        {
+            return DecodeResult::WrongLength;
+        }
+        if (crc8(buffer, length - CRC_LENGTH) != buffer[length - CRC_LENGTH])
+        {
+            return DecodeResult::WrongCrc;
+        }
+
+        const uint8_t *const payload = buffer + COMMAND_HEADER_LENGTH;
+        command = Command{};
+        command.sequence = buffer[1u];
+        command.code = code;
+        command.peer = readMotion(payload + ((isBroadcast && isLeftGearbox) ? MOTION_LENGTH : 0u));
+        if (command.code == CMD_MOVE_TO)
+        {
+            command.targetPosition = readUint32(payload + motionsLength);
+        }
+        else if (command.code == CMD_SEGMENT)
+        {
+            command.targetPosition = readUint32(payload + motionsLength);
+            command.segmentSpeed = readUint16(payload + motionsLength + 4);
+            command.startDelayUS = readUint16(payload + motionsLength + 6);
+            command.startUS = readUint32(payload + motionsLength + 8);
+            command.isStartSynchronized = payload[motionsLength + 12] == 1u;
+        }
+        else if (command.code == CMD_TIME_SYNC)
+        {
+            command.previousSyncSequence = payload[motionsLength];
+            command.previousSyncWrittenUS = readUint32(payload + motionsLength + 1);
+            command.previousSyncReadUS = readUint32(payload + motionsLength + 5);
+        }
+        else if (command.code == CMD_JOG)
+        {
+            command.jogDirection = static_cast<int8_t>(payload[motionsLength]);
+            command.jogSpeed = readUint16(payload + motionsLength + 1);
+            command.leaseMS = readUint16(payload + motionsLength + 3);
+        }
+        else if (argumentsLength(command.code) == 1u)
+        {
+            command.isEnabled = payload[motionsLength] == 1u;
+        }
+        return DecodeResult::Ok;
+    }
+
+    // Writes the frame of the status into the buffer, which has to hold STATUS_LENGTH bytes.
+    inline void encodeStatus(const Status &status, uint8_t *buffer)
+    {
+        buffer[0u] = VERSION;
+        buffer[1u] = status.sequence;
+        buffer[2u] = status.flags;
+        writeUint32(buffer + 3, status.motion.position);
+        writeUint16(buffer + 7, static_cast<uint16_t>(status.motion.speed));
+        buffer[9u] = status.brakeState;
+        writeUint16(buffer + 10, status.skippedSteps);
+        writeUint16(buffer + 12, status.motion.ageUS);
+        buffer[14u] = status.events;
+        buffer[STATUS_LENGTH - CRC_LENGTH] = crc8(buffer, STATUS_LENGTH - CRC_LENGTH);
+    }
+
+    inline DecodeResult decodeStatus(const uint8_t *buffer, const size_t length, Status &status)
+    {
+        if (length < STATUS_LENGTH)
+        {
+            return DecodeResult::TooShort;
+        }
+        if (buffer[0u] != VERSION)
+        {
+            return DecodeResult::WrongVersion;
+        }
+        if (crc8(buffer, STATUS_LENGTH - CRC_LENGTH) != buffer[STATUS_LENGTH - CRC_LENGTH])
+        {
+            return DecodeResult::WrongCrc;
+        }
+
+        status = Status{};
+        status.sequence = buffer[1u];
+        status.flags = buffer[2u];
+        status.motion.position = readUint32(buffer + 3);
+        status.motion.speed = static_cast<int16_t>(readUint16(buffer + 7));
+        status.brakeState = buffer[9u];
+        status.skippedSteps = readUint16(buffer + 10);
+        status.motion.ageUS = readUint16(buffer + 12);
+        status.events = buffer[14u];
+        return DecodeResult::Ok;
+    }
+
+    // Whether the reply to a read is a time sync reply, it is decoded with decodeTimeSyncReply() then.
+    inline bool isTimeSyncReply(const uint8_t *buffer, const size_t length)
+    {
+        return (length > 0u) && (buffer[0u] == (VERSION | TIME_SYNC_REPLY_FLAG));
+    }
+
+    // Writes the frame of the reply into the buffer, which has to hold TIME_SYNC_REPLY_LENGTH bytes.
+    inline void encodeTimeSyncReply(const TimeSyncReply &reply, uint8_t *buffer)
+    {
+        buffer[0u] = VERSION | TIME_SYNC_REPLY_FLAG;
+        buffer[1u] = reply.sequence;
+        writeUint32(buffer + 2, reply.receivedUS);
+        writeUint32(buffer + 6, reply.repliedUS);
+        writeUint32(buffer + 10, 0u);
+        buffer[14u] = 0u;
+        buffer[TIME_SYNC_REPLY_LENGTH - CRC_LENGTH] = crc8(buffer, TIME_SYNC_REPLY_LENGTH - CRC_LENGTH);
+    }
+
+    inline DecodeResult decodeTimeSyncReply(const uint8_t *buffer, const size_t length, TimeSyncReply &reply)
+    {
+        if (length < TIME_SYNC_REPLY_LENGTH)
+        {
+            return DecodeResult::TooShort;
+        }
+        if (!isTimeSyncReply(buffer, length))
+        {
+            return DecodeResult::WrongVersion;
+        }
+        if (crc8(buffer, TIME_SYNC_REPLY_LENGTH - CRC_LENGTH) != buffer[TIME_SYNC_REPLY_LENGTH - CRC_LENGTH])
+        {
+            return DecodeResult::WrongCrc;
+        }
+
+        reply = TimeSyncReply{};
+        reply.sequence = buffer[1u];
+        reply.receivedUS = readUint32(buffer + 2);
+        reply.repliedUS = readUint32(buffer + 6);
+        return DecodeResult::Ok;
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-capacity ring buffer for any number of producers and a single consumer, e.g. log records written from several
+// tasks. Neither side ever blocks or allocates. Every slot carries a sequence number that tells whether it is free for
+// the producer of a certain position or holds an element for the consumer (D. Vyukov, bounded MPMC queue). Producers
+// claim a position with a compare-and-swap and publish the element by releasing the sequence of its slot.
+template <typename T, size_t Capacity>
+class MpscRing
+{
+    static_assert(Capacity >= 2u && (Capacity & (Capacity - 1u)) == 0u, "The capacity has to be a power of two.");
+
+private:
+    static constexpr uint32_t INDEX_MASK{Capacity - 1u};
+
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence{0u};
+        T element{};
+    };
+
+    Slot slots[Capacity]{};
+    std::atomic<uint32_t> enqueuePosition{0u};
+    // Only used by the consumer.
+    uint32_t dequeuePosition{0u};
+
+public:
+    MpscRing()
+    {
+        for (uint32_t index = 0u; index < Capacity; index++)
+        {
+            slots[index].sequence.store(index, std::memory_order_relaxed);
+        }
+    }
+    ~MpscRing() = default;
+    MpscRing(const MpscRing &) = delete;
+    MpscRing &operator=(const MpscRing &) = delete;
+
+    // Producer side, safe to call from several contexts. Returns false without modifying the ring if it is full.
+    bool push(const T &element)
+    {
+        uint32_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Slot *slot = nullptr;
+        while (true)
+        {
+            slot = &slots[position & INDEX_MASK];
+            const int32_t difference = static_cast<int32_t>(slot->sequence.load(std::memory_order_acquire) - position);
+            if (difference == 0)
+            {
+                // The slot is free for this position, try to claim it.
+                if (enqueuePosition.compare_exchange_weak(position, position + 1u, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                // The slot still holds the element of the previous round.
+                return false;
+            }
+            else
+            {
+                // Another producer claimed the position in the meantime.
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->element = element;
+        slot->sequence.store(position + 1u, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the ring is empty or the next element is not completely written yet.
+    bool pop(T &element)
+    {
+        Slot &slot = slots[dequeuePosition & INDEX_MASK];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1u)
+        {
+            return false;
+        }
+
+        element = slot.element;
+        // Free the slot for the producer of the next round.
+        slot.sequence.store(dequeuePosition + Capacity, std::memory_order_release);
+        dequeuePosition++;
+        return true;
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+};
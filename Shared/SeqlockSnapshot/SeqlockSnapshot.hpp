@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Latest value of a small, trivially copyable struct that one writer publishes and any number of readers copy, e.g. a
+// status that a task prepares for an I2C request handler. Neither side ever blocks.
+// The value is double buffered: publication n goes into buffer n % 2, thus, a reader that copies publication n is only
+// disturbed if publication n + 2 starts during the copy. In that rare case the reader simply copies again.
+template <typename T>
+class SeqlockSnapshot
+{
+private:
+    T buffers[2u]{};
+    // Number of the last publication that was started and the last one that is complete.
+    std::atomic<uint32_t> startedSequence{0u};
+    std::atomic<uint32_t> sequence{0u};
+
+public:
+    SeqlockSnapshot() = default;
+    ~SeqlockSnapshot() = default;
+    SeqlockSnapshot(const SeqlockSnapshot &) = delete;
+    SeqlockSnapshot &operator=(const SeqlockSnapshot &) = delete;
+
+    // Only one context may publish.
+    void publish(const T &value)
+    {
+        const uint32_t next = sequence.load(std::memory_order_relaxed) + 1u;
+        startedSequence.store(next, std::memory_order_relaxed);
+        // Readers that see any part of the new value also see that the publication started.
+        std::atomic_thread_fence(std::memory_order_release);
+        buffers[next & 1u] = value;
+        sequence.store(next, std::memory_order_release);
+    }
+
+    // Copies the last complete publication and returns its sequence number.
+    uint32_t read(T &value) const
+    {
+        while (true)
+        {
+            const uint32_t current = sequence.load(std::memory_order_acquire);
+            value = buffers[current & 1u];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // The buffer is written again by publication current + 2.
+            if (startedSequence.load(std::memory_order_relaxed) - current < 2u)
+            {
+                return current;
+            }
+        }
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Fixed-capacity ring buffer for exactly one producer and one consumer, e.g. an I2C callback handing data to a task.
+// Neither side ever blocks or allocates. The producer publishes an element by releasing the head index after the
+// element is written, the consumer frees a slot by releasing the tail index after the element is read. Head and tail
+// count up freely, their difference is the number of stored elements.
+template <typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity >= 2u && (Capacity & (Capacity - 1u)) == 0u, "The capacity has to be a power of two.");
+
+private:
+    static constexpr size_t INDEX_MASK{Capacity - 1u};
+
+    T elements[Capacity]{};
+    // Only written by the producer.
+    std::atomic<size_t> head{0u};
+    // Only written by the consumer.
+    std::atomic<size_t> tail{0u};
+
+public:
+    SpscRing() = default;
+    ~SpscRing() = default;
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    // Producer side. Returns false without modifying the ring if it is full.
+    bool push(const T &element)
+    {
+        const size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead - tail.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+
+        elements[currentHead & INDEX_MASK] = element;
+        head.store(currentHead + 1u, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the ring is empty.
+    bool pop(T &element)
+    {
+        const size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == currentTail)
+        {
+            return false;
+        }
+
+        element = elements[currentTail & INDEX_MASK];
+        tail.store(currentTail + 1u, std::memory_order_release);
+        return true;
+    }
+
+    // Only a snapshot, the other side might change it right after.
+    size_t size() const
+    {
+        // The tail is read first, the head can only grow afterwards which keeps the difference from wrapping.
+        const size_t currentTail = tail.load(std::memory_order_acquire);
+        return head.load(std::memory_order_acquire) - currentTail;
+    }
+    bool isEmpty() const { return size() == 0u; }
+    static constexpr size_t capacity() { return Capacity; }
+};
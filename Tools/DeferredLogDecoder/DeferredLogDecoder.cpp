@@ -0,0 +1,145 @@
+// Turns the binary output of the deferred logger back into text. Bytes that are not part of a valid frame, e.g. plain
+// Serial prints during startup, are passed through unchanged.
+//
+// Usage: deferred-log-decoder <gearbox|controller|controlpanel> [capture file]
+// Reads from stdin if no capture file is given, which allows to pipe a serial monitor into the decoder.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "DeferredLogFormat.hpp"
+#include "../../Getriebe_Test_V1/src/LogMessages.hpp"
+#include "../../GeneralController/src/LogMessages.hpp"
+#include "../../ControlPanel/LogMessages.h"
+
+namespace
+{
+    struct Catalog
+    {
+        const char *name;
+        const char *const *formats;
+        size_t formatCount;
+    };
+
+    template <size_t Count>
+    Catalog makeCatalog(const char *name, const char *const (&formats)[Count])
+    {
+        return Catalog{name, formats, Count};
+    }
+
+    void printUsage(const Catalog *catalogs, const size_t catalogCount)
+    {
+        fprintf(stderr, "Usage: deferred-log-decoder <");
+        for (size_t i = 0u; i < catalogCount; i++)
+        {
+            fprintf(stderr, "%s%s", i > 0u ? "|" : "", catalogs[i].name);
+        }
+        fprintf(stderr, "> [capture file]\n");
+    }
+
+    // Number of bytes the frame at the start of the buffer needs, as far as it is known yet.
+    size_t expectedFrameSize(const std::vector<uint8_t> &buffer)
+    {
+        if (buffer.size() < DeferredLogFormat::FRAME_HEADER_SIZE)
+        {
+            return DeferredLogFormat::FRAME_HEADER_SIZE;
+        }
+        // A frame with too many arguments is invalid, its bytes are plain text.
+        return buffer[8u] <= DeferredLogFormat::MAX_ARGUMENTS ? DeferredLogFormat::frameSize(buffer[8u]) : 0u;
+    }
+
+    bool isFrameStart(const std::vector<uint8_t> &buffer)
+    {
+        return buffer[0u] == DeferredLogFormat::FRAME_MAGIC[0u] &&
+               (buffer.size() < 2u || buffer[1u] == DeferredLogFormat::FRAME_MAGIC[1u]);
+    }
+
+    // Decodes as much of the buffer as possible. Keeps a frame that may still be incomplete unless isEnd is set.
+    void decode(std::vector<uint8_t> &buffer, const Catalog &catalog, const bool isEnd)
+    {
+        while (!buffer.empty())
+        {
+            if (isFrameStart(buffer))
+            {
+                DeferredLogFormat::Record record;
+                const size_t size = DeferredLogFormat::decodeFrame(buffer.data(), buffer.size(), record);
+                if (size > 0u)
+                {
+                    char line[256u];
+                    DeferredLogFormat::formatLine(line, sizeof(line), record, catalog.formats, catalog.formatCount);
+                    printf("%s\n", line);
+                    buffer.erase(buffer.begin(), buffer.begin() + size);
+                    continue;
+                }
+                if (!isEnd && buffer.size() < expectedFrameSize(buffer))
+                {
+                    // Wait for the rest of the frame.
+                    break;
+                }
+            }
+
+            // No frame starts here, the byte is plain text.
+            putchar(buffer[0u]);
+            buffer.erase(buffer.begin());
+        }
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const Catalog catalogs[] = {
+        makeCatalog("gearbox", GearboxLogFormats),
+        makeCatalog("controller", ControllerLogFormats),
+        makeCatalog("controlpanel", ControlPanelLogFormats),
+    };
+    const size_t catalogCount = sizeof(catalogs) / sizeof(catalogs[0u]);
+
+    if (argc < 2 || argc > 3)
+    {
+        printUsage(catalogs, catalogCount);
+        return 1;
+    }
+
+    const Catalog *catalog = nullptr;
+    for (size_t i = 0u; i < catalogCount; i++)
+    {
+        if (strcmp(argv[1], catalogs[i].name) == 0)
+        {
+            catalog = &catalogs[i];
+        }
+    }
+    if (catalog == nullptr)
+    {
+        printUsage(catalogs, catalogCount);
+        return 1;
+    }
+
+    FILE *input = stdin;
+    if (argc == 3)
+    {
+        input = fopen(argv[2], "rb");
+        if (input == nullptr)
+        {
+            fprintf(stderr, "Cannot open %s\n", argv[2]);
+            return 1;
+        }
+    }
+
+    std::vector<uint8_t> buffer;
+    uint8_t chunk[256u];
+    size_t readBytes = 0u;
+    while ((readBytes = fread(chunk, 1u, sizeof(chunk), input)) > 0u)
+    {
+        buffer.insert(buffer.end(), chunk, chunk + readBytes);
+        decode(buffer, *catalog, false);
+    }
+    decode(buffer, *catalog, true);
+
+    if (input != stdin)
+    {
+        fclose(input);
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include "Column.hpp"
+#include <functional>
+
+Column::Column(const Parameters &parameters, const MotorPins &pins, const uint8_t upDirectionLevel) : parameters(parameters), pins(pins), upDirectionLevel(upDirectionLevel)
+{
+}
+
+void Column::attach(NativeArduino::Board &newBoard)
+{
+    board = &newBoard;
+    board->onPinWrite = [this](const uint8_t pin, const uint8_t value)
+    { onPinWrite(pin, value); };
+}
+
+void Column::onPinWrite(const uint8_t pin, const uint8_t value)
+{
+    if (pin != pins.step)
+    {
+        return;
+    }
+
+    // The driver steps on the rising edge.
+    const bool isRisingEdge = (stepLevel == LOW) && (value == HIGH);
+    stepLevel = value;
+    if (isRisingEdge)
+    {
+        onStep();
+    }
+}
+
+void Column::onStep()
+{
+    const bool isDriverPowered = board->pinLevels[pins.driverPower] == HIGH;
+    const bool isDriverEnabled = board->pinLevels[pins.enable] == LOW;
+    if (!isDriverPowered || !isDriverEnabled)
+    {
+        // Nobody drives the motor, the step is lost without the driver noticing.
+        return;
+    }
+
+    const uint64_t nowUS = NativeArduino::now();
+    const uint64_t intervalUS = nowUS - lastStepUS;
+    const double stepRate = (!hasStepped || intervalUS >= STANDSTILL_US || intervalUS == 0u) ? 0.0 : 1e6 / static_cast<double>(intervalUS);
+    lastStepUS = nowUS;
+    hasStepped = true;
+
+    const int direction = (board->pinLevels[pins.direction] == upDirectionLevel) ? 1 : -1;
+    const double availableForceN = parameters.holdingForceN * (1.0 - (stepRate / parameters.pullOutStepRate));
+    const double requiredForceN = parameters.frictionN + (direction > 0 ? parameters.loadN : 0.0);
+
+    if (requiredForceN > availableForceN)
+    {
+        lostSteps++;
+        if (parameters.reportsLostSteps)
+        {
+            // The counter follows the direction input of the driver, like the position of the profile.
+            const uint32_t motorDirection = (board->pinLevels[pins.direction] == HIGH) ? 1u : 0xFFFFFu;
+            board->driverLostSteps = (board->driverLostSteps + motorDirection) & 0xFFFFFu;
+        }
+        return;
+    }
+
+    position += direction;
+}
+
+bool Column::isResting(const uint64_t nowUS, const uint64_t durationUS) const
+{
+    return !hasStepped || (nowUS - lastStepUS >= durationUS);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include "NativeArduino.hpp"
+#include "SimFirmware.hpp"
+
+// Mechanical model of one desk column. It follows the step pulses of its gearbox and loses steps whenever the motor
+// cannot deliver the force the column needs at the current step rate.
+class Column
+{
+public:
+    struct Parameters
+    {
+        // Weight resting on this column, moving up has to lift it (N).
+        double loadN;
+        // Friction of the spindle in both directions (N).
+        double frictionN;
+        // Force of the motor at standstill, it falls linearly to zero at the pull-out step rate.
+        double holdingForceN;
+        double pullOutStepRate;
+        // True if the driver counts lost steps. The TMC2130 only does with dcStep, which needs its DCEN input high.
+        bool reportsLostSteps;
+    };
+
+private:
+    // A step after this pause starts from standstill.
+    static constexpr uint64_t STANDSTILL_US{100000u};
+
+    const Parameters parameters;
+    const MotorPins pins;
+    // Direction level of the motor that moves the column up, the right gearbox turns the other way.
+    const uint8_t upDirectionLevel;
+    NativeArduino::Board *board{nullptr};
+
+    uint8_t stepLevel{LOW};
+    long position{0};
+    uint32_t lostSteps{0u};
+    uint64_t lastStepUS{0u};
+    bool hasStepped{false};
+
+    void onPinWrite(const uint8_t pin, const uint8_t value);
+    void onStep();
+
+public:
+    Column(const Parameters &parameters, const MotorPins &pins, const uint8_t upDirectionLevel);
+    ~Column() = default;
+
+    // Follows the step pin of the board from now on.
+    void attach(NativeArduino::Board &board);
+
+    // Height of the column in motor steps.
+    long getPosition() const { return position; }
+    uint32_t getLostSteps() const { return lostSteps; }
+    // Time of the last step that the motor did or lost.
+    uint64_t getLastStepUS() const { return lastStepUS; }
+    // True if the column did not move for the given time.
+    bool isResting(const uint64_t nowUS, const uint64_t durationUS) const;
+};
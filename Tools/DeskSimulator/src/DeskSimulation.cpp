@@ -0,0 +1,340 @@
+#include "DeskSimulation.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include "../../../Getriebe_Test_V1/src/LogMessages.hpp"
+#include "../../../GeneralController/src/LogMessages.hpp"
+
+namespace
+{
+    // Button events of the control panel, see ButtonEvents.hpp of the general controller.
+    constexpr uint8_t SINGLE_CLICK{0u};
+    constexpr uint8_t BUTTON_PRESSED{6u};
+    constexpr uint8_t BUTTON_RELEASED{7u};
+
+    // The motor of the left gearbox moves the column up while its direction pin is high, the right one is mirrored.
+    constexpr uint8_t LEFT_UP_DIRECTION_LEVEL{HIGH};
+    constexpr uint8_t RIGHT_UP_DIRECTION_LEVEL{LOW};
+    // The gearboxes power up a bit before the general controller, thus, their clocks are ahead of its one.
+    constexpr int64_t LEFT_CLOCK_OFFSET_US{1700};
+    constexpr int64_t RIGHT_CLOCK_OFFSET_US{4100};
+
+    bool isGearboxEmergencyStop(const uint16_t formatId)
+    {
+        return formatId == static_cast<uint16_t>(GearboxLog::MOVE_UP_EMERGENCY_STOP) ||
+               formatId == static_cast<uint16_t>(GearboxLog::MOVE_DOWN_EMERGENCY_STOP) ||
+               formatId == static_cast<uint16_t>(GearboxLog::MOVE_TO_TOO_FAR);
+    }
+}
+
+DeskSimulation::GearboxNode::GearboxNode(GearboxFirmware &firmware, const Column::Parameters &parameters, const uint8_t upDirectionLevel, const char *name, const bool isPrinting, LogMonitor::RecordCallback onRecord) : firmware(firmware), column(parameters, firmware.motorPins(), upDirectionLevel), log(name, GearboxLogFormats, isPrinting, onRecord), nextWakeUS(0u), nextPollUS(0u), lastRefusalUS(NEVER)
+{
+    column.attach(board);
+}
+
+DeskSimulation::DeskSimulation(const Scenario &scenario, const uint32_t busLatencyUS, const uint32_t busJitterUS, const uint32_t seed, const bool isPrintingLogs) : scenario(scenario), controller(controllerFirmware()), bus(I2C_FREQUENCY, scenario.busMaxFrequencyHz, busLatencyUS, busJitterUS, seed), busRight(I2C_FREQUENCY, scenario.busMaxFrequencyHz, busLatencyUS, busJitterUS, ~seed)
+{
+    left.reset(new GearboxNode(leftGearboxFirmware(), scenario.leftColumn, LEFT_UP_DIRECTION_LEVEL, "left", isPrintingLogs, gearboxRecordCallback(left)));
+    right.reset(new GearboxNode(rightGearboxFirmware(), scenario.rightColumn, RIGHT_UP_DIRECTION_LEVEL, "right", isPrintingLogs, gearboxRecordCallback(right)));
+    left->board.clockOffsetUS = LEFT_CLOCK_OFFSET_US;
+    left->board.clockDriftPPM = scenario.clockDriftPPM;
+    right->board.clockOffsetUS = RIGHT_CLOCK_OFFSET_US;
+    right->board.clockDriftPPM = -scenario.clockDriftPPM;
+
+    controllerLog.reset(new LogMonitor("controller", ControllerLogFormats, isPrintingLogs, [this](const DeferredLogFormat::Record &record)
+                                       {
+        const bool isStateChange = record.formatId == static_cast<uint16_t>(ControllerLog::GEARBOX_STATE);
+        if (isStateChange && (record.argumentCount > 0u) && (record.arguments[0u] == CONTROLLER_EMERGENCY_STOP_STATE))
+        {
+            result.controllerEmergencyStops++;
+            onEmergencyStop();
+        } }));
+
+    uart.reset(new VirtualUart(controller.controlPanelUart(), UART_BAUDRATE));
+    bus.setGeneralCallAccepted(scenario.acceptsGeneralCall);
+    busRight.setGeneralCallAccepted(scenario.acceptsGeneralCall);
+    bus.addSlave(controller.gearboxLeftAddress(), left->board, left->firmware.wire());
+    controller.wire().attachBus(&bus);
+    if (scenario.hasSeparateBuses)
+    {
+        busRight.addSlave(controller.gearboxRightAddress(), right->board, right->firmware.wire());
+        controller.wireRight().attachBus(&busRight);
+    }
+    else
+    {
+        bus.addSlave(controller.gearboxRightAddress(), right->board, right->firmware.wire());
+    }
+    attentionLineLeft.attach(left->board, left->firmware.attentionLinePin());
+    attentionLineLeft.attach(controllerBoard, controller.gearboxAttentionPin(true));
+    attentionLineRight.attach(right->board, right->firmware.attentionLinePin());
+    attentionLineRight.attach(controllerBoard, controller.gearboxAttentionPin(false));
+    if (scenario.hasEmergencyStopLine)
+    {
+        emergencyStopLine.attach(controllerBoard, controller.emergencyStopLinePin());
+        emergencyStopLine.attach(left->board, left->firmware.emergencyStopLinePin());
+        emergencyStopLine.attach(right->board, right->firmware.emergencyStopLinePin());
+    }
+}
+
+RunResult DeskSimulation::run()
+{
+    NativeArduino::resetTime();
+    for (GearboxNode *node : {left.get(), right.get()})
+    {
+        NativeArduino::selectBoard(node->board);
+        node->firmware.begin();
+    }
+    NativeArduino::selectBoard(controllerBoard);
+    controller.begin(scenario.hasSeparateBuses);
+
+    uint64_t nextLoopUS{0u};
+    while ((nextActionUS != NEVER) && (NativeArduino::now() < scenario.timeLimitUS))
+    {
+        // A pin interrupt, e.g. of the emergency stop line, wakes the motor task of the gearbox.
+        for (GearboxNode *node : {left.get(), right.get()})
+        {
+            if (node->board.isNotified)
+            {
+                node->nextWakeUS = std::min(node->nextWakeUS, NativeArduino::now());
+            }
+        }
+        const uint64_t nextEventUS = std::min({left->nextWakeUS, left->nextPollUS, right->nextWakeUS, right->nextPollUS, nextLoopUS,
+                                               nextActionUS, bus.nextDeliveryUS(), busRight.nextDeliveryUS(), uart->nextDeliveryUS()});
+        if (nextEventUS > NativeArduino::now())
+        {
+            NativeArduino::advance(nextEventUS - NativeArduino::now());
+        }
+
+        if (uart->deliverDue())
+        {
+            NativeArduino::selectBoard(controllerBoard);
+            if (controller.runControlPanelReader())
+            {
+                nextLoopUS = NativeArduino::now();
+            }
+        }
+        for (VirtualI2cBus *i2cBus : {&bus, &busRight})
+        {
+            while (i2cBus->nextDeliveryUS() <= NativeArduino::now())
+            {
+                // A command wakes the motor task of the gearbox.
+                NativeArduino::Board &board = i2cBus->deliverNext();
+                GearboxNode &node = (&board == &left->board) ? *left : *right;
+                if (board.isNotified)
+                {
+                    node.nextWakeUS = std::min(node.nextWakeUS, NativeArduino::now());
+                }
+            }
+        }
+
+        if (nextActionUS <= NativeArduino::now())
+        {
+            runPanel();
+        }
+        if (nextLoopUS <= NativeArduino::now())
+        {
+            runController();
+            nextLoopUS = controller.nextLoopUS();
+        }
+        for (GearboxNode *node : {left.get(), right.get()})
+        {
+            if (node->nextPollUS <= NativeArduino::now())
+            {
+                NativeArduino::selectBoard(node->board);
+                node->firmware.pollDriverStatus();
+                node->nextPollUS += node->firmware.driverPollIntervalUS();
+            }
+            if (node->nextWakeUS <= NativeArduino::now())
+            {
+                runGearbox(*node);
+            }
+        }
+
+        measure();
+    }
+
+    result.simulatedUS = NativeArduino::now();
+    result.finalDeviation = labs(left->column.getPosition() - right->column.getPosition());
+    result.lostStepsLeft = left->column.getLostSteps();
+    result.lostStepsRight = right->column.getLostSteps();
+    result.busTransfers = bus.getTransfers() + busRight.getTransfers();
+
+    NativeArduino::selectBoard(controllerBoard);
+    controller.drainLog(*controllerLog);
+    controller.end();
+    for (GearboxNode *node : {left.get(), right.get()})
+    {
+        NativeArduino::selectBoard(node->board);
+        node->firmware.drainLog(node->log);
+        node->firmware.end();
+    }
+    return result;
+}
+
+LogMonitor::RecordCallback DeskSimulation::gearboxRecordCallback(std::unique_ptr<GearboxNode> &node)
+{
+    // The node does not exist yet, thus, the callback looks it up when a record arrives.
+    std::unique_ptr<GearboxNode> *nodeSlot = &node;
+    return [this, nodeSlot](const DeferredLogFormat::Record &record)
+    {
+        if (!isGearboxEmergencyStop(record.formatId))
+        {
+            return;
+        }
+        GearboxNode &refusingNode = **nodeSlot;
+        const uint64_t nowUS = NativeArduino::now();
+        onEmergencyStop();
+        if ((refusingNode.lastRefusalUS == NEVER) || (nowUS - refusingNode.lastRefusalUS >= REFUSAL_EPISODE_GAP_US))
+        {
+            result.gearboxEmergencyStops++;
+        }
+        refusingNode.lastRefusalUS = nowUS;
+    };
+}
+
+void DeskSimulation::runGearbox(GearboxNode &node)
+{
+    NativeArduino::selectBoard(node.board);
+    NativeArduino::takeNotification();
+    const uint64_t sleepUS = node.firmware.runMotorCycle();
+    node.firmware.drainLog(node.log);
+
+    // The task sleeps till the timer alarm, a notification or the time its cycle asked for.
+    if (NativeArduino::takeNotification())
+    {
+        node.nextWakeUS = NativeArduino::now();
+        return;
+    }
+    node.nextWakeUS = (sleepUS == NEVER) ? NEVER : (NativeArduino::now() + sleepUS);
+    if (NativeArduino::isAlarmEnabled())
+    {
+        node.nextWakeUS = std::min(node.nextWakeUS, NativeArduino::alarmTime());
+    }
+}
+
+void DeskSimulation::runController()
+{
+    NativeArduino::selectBoard(controllerBoard);
+    controller.runLoop();
+    controller.drainLog(*controllerLog);
+}
+
+void DeskSimulation::runPanel()
+{
+    while (actionIndex < scenario.actions.size())
+    {
+        const PanelAction &action = scenario.actions[actionIndex];
+        const uint64_t nowUS = NativeArduino::now();
+        switch (action.type)
+        {
+        case PanelAction::Type::Click:
+            sendButtonEvent(action.button, SINGLE_CLICK);
+            break;
+        case PanelAction::Type::Press:
+            sendButtonEvent(action.button, BUTTON_PRESSED);
+            break;
+        case PanelAction::Type::Release:
+            sendButtonEvent(action.button, BUTTON_RELEASED);
+            break;
+        case PanelAction::Type::Wait:
+            if (!isActionStarted)
+            {
+                isActionStarted = true;
+                actionEndUS = nowUS + (1000u * static_cast<uint64_t>(action.value));
+            }
+            if (nowUS < actionEndUS)
+            {
+                nextActionUS = actionEndUS;
+                return;
+            }
+            break;
+        case PanelAction::Type::WaitForHeight:
+            if (!isActionStarted)
+            {
+                isActionStarted = true;
+                isWaitingForRise = meanHeight() < action.value;
+            }
+            if (isWaitingForRise ? (meanHeight() < action.value) : (meanHeight() > action.value))
+            {
+                nextActionUS = nowUS + PANEL_POLL_INTERVAL_US;
+                return;
+            }
+            break;
+        case PanelAction::Type::WaitForRest:
+        {
+            const uint64_t durationUS = 1000u * static_cast<uint64_t>(action.value);
+            if (!left->column.isResting(nowUS, durationUS) || !right->column.isResting(nowUS, durationUS))
+            {
+                nextActionUS = nowUS + PANEL_POLL_INTERVAL_US;
+                return;
+            }
+            break;
+        }
+        }
+
+        actionIndex++;
+        isActionStarted = false;
+    }
+
+    // Script done, the run ends.
+    nextActionUS = NEVER;
+}
+
+void DeskSimulation::sendButtonEvent(const uint8_t button, const uint8_t event)
+{
+    // Same message as sendButtonStateChange() of the control panel: length, one event, terminating zero.
+    const uint8_t message[]{5u, 'B', button, 'S', event, 0u};
+    uart->send(message, sizeof(message));
+}
+
+long DeskSimulation::meanHeight() const
+{
+    return (left->column.getPosition() + right->column.getPosition()) / 2;
+}
+
+void DeskSimulation::onEmergencyStop()
+{
+    if (stopRequestUS == NEVER)
+    {
+        stopRequestUS = NativeArduino::now();
+    }
+}
+
+void DeskSimulation::measure()
+{
+    const long leftPosition = left->column.getPosition();
+    const long rightPosition = right->column.getPosition();
+    result.peakColumnDeviation = std::max(result.peakColumnDeviation, labs(leftPosition - rightPosition));
+
+    const int32_t firmwareDeviation = static_cast<int32_t>(left->firmware.position()) - static_cast<int32_t>(right->firmware.position());
+    result.peakFirmwareDeviation = std::max(result.peakFirmwareDeviation, static_cast<long>(abs(firmwareDeviation)));
+
+    // The clock of the general controller is the simulated time.
+    for (GearboxNode *node : {left.get(), right.get()})
+    {
+        NativeArduino::selectBoard(node->board);
+        if (node->firmware.isClockSynchronized())
+        {
+            const int32_t clockError = static_cast<int32_t>(node->firmware.syncedMicros() - static_cast<uint32_t>(NativeArduino::now()));
+            result.peakClockError = std::max(result.peakClockError, static_cast<long>(abs(clockError)));
+        }
+    }
+    NativeArduino::selectBoard(controllerBoard);
+
+    if ((stopRequestUS != NEVER) && left->column.isResting(NativeArduino::now(), STOPPED_US) && right->column.isResting(NativeArduino::now(), STOPPED_US))
+    {
+        const uint64_t lastStepUS = std::max(left->column.getLastStepUS(), right->column.getLastStepUS());
+        result.peakStopLatencyUS = std::max(result.peakStopLatencyUS, lastStepUS > stopRequestUS ? lastStepUS - stopRequestUS : 0u);
+        stopRequestUS = NEVER;
+    }
+
+    const bool isAtTarget = (labs(leftPosition - scenario.targetPosition) <= TARGET_TOLERANCE) && (labs(rightPosition - scenario.targetPosition) <= TARGET_TOLERANCE);
+    if (!isAtTarget)
+    {
+        hasLeftTarget = true;
+    }
+    else if (hasLeftTarget && !result.hasReachedTarget)
+    {
+        result.hasReachedTarget = true;
+        result.timeToTargetUS = NativeArduino::now();
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include "Column.hpp"
+#include "LogMonitor.hpp"
+#include "NativeArduino.hpp"
+#include "Scenario.hpp"
+#include "SimFirmware.hpp"
+#include "VirtualBus.hpp"
+
+// Outcome of one run of a scenario.
+struct RunResult
+{
+    // Largest height difference of the columns, respectively of the positions the gearboxes reported, in steps.
+    long peakColumnDeviation{0};
+    long peakFirmwareDeviation{0};
+    // Largest difference of syncedMicros() of a synchronized gearbox to the clock of the general controller, in us.
+    long peakClockError{0};
+    bool hasReachedTarget{false};
+    uint64_t timeToTargetUS{0u};
+    // Entries of the general controller into its emergency stop state.
+    uint32_t controllerEmergencyStops{0u};
+    // Episodes in which a gearbox refused moves because the other gearbox was too far away.
+    uint32_t gearboxEmergencyStops{0u};
+    // Longest time from an emergency stop of any firmware till the last step of both columns, in us.
+    uint64_t peakStopLatencyUS{0u};
+    // Writes and reads of the general controller on all buses.
+    uint32_t busTransfers{0u};
+    uint32_t lostStepsLeft{0u};
+    uint32_t lostStepsRight{0u};
+    long finalDeviation{0};
+    uint64_t simulatedUS{0u};
+};
+
+// Runs the general controller and both gearboxes of the desk through one scenario. All three firmwares share the
+// simulated clock, which jumps from one event to the next: a timer alarm or the wake time that a motor task asked for, a
+// driver poll, a loop of the general controller, a byte arriving on the bus or the UART, or the next panel action.
+class DeskSimulation
+{
+private:
+    static constexpr uint64_t NEVER{UINT64_MAX};
+    // Clock of the buses till the general controller sets its own.
+    static constexpr uint32_t I2C_FREQUENCY{100000u};
+    static constexpr uint32_t UART_BAUDRATE{115200u};
+    // Columns closer than this to the target count as arrived.
+    static constexpr long TARGET_TOLERANCE{50};
+    // The simulated user watches the desk at this rate.
+    static constexpr uint64_t PANEL_POLL_INTERVAL_US{10000u};
+    // Value of InputController::GearboxState::EmergencyStop in the log of the general controller.
+    static constexpr uint32_t CONTROLLER_EMERGENCY_STOP_STATE{5u};
+    // A gearbox refuses every move command while it is too far off, refusals closer than this count as one episode.
+    static constexpr uint64_t REFUSAL_EPISODE_GAP_US{500000u};
+    // Both columns count as stopped once they did not step for this time.
+    static constexpr uint64_t STOPPED_US{5000u};
+
+    struct GearboxNode
+    {
+        GearboxFirmware &firmware;
+        NativeArduino::Board board;
+        Column column;
+        LogMonitor log;
+        uint64_t nextWakeUS;
+        uint64_t nextPollUS;
+        uint64_t lastRefusalUS;
+
+        GearboxNode(GearboxFirmware &firmware, const Column::Parameters &parameters, const uint8_t upDirectionLevel, const char *name, const bool isPrinting, LogMonitor::RecordCallback onRecord);
+    };
+
+    const Scenario &scenario;
+    ControllerFirmware &controller;
+    NativeArduino::Board controllerBoard;
+    std::unique_ptr<GearboxNode> left;
+    std::unique_ptr<GearboxNode> right;
+    std::unique_ptr<LogMonitor> controllerLog;
+    VirtualI2cBus bus;
+    // Bus of the right gearbox, only used if the scenario has separate buses.
+    VirtualI2cBus busRight;
+    std::unique_ptr<VirtualUart> uart;
+    // Only connected if the scenario has it.
+    VirtualOpenDrainLine emergencyStopLine;
+    // Each gearbox has a line of its own to the controller.
+    VirtualOpenDrainLine attentionLineLeft;
+    VirtualOpenDrainLine attentionLineRight;
+
+    size_t actionIndex{0u};
+    uint64_t nextActionUS{0u};
+    bool isActionStarted{false};
+    bool isWaitingForRise{false};
+    uint64_t actionEndUS{0u};
+    bool hasLeftTarget{false};
+    // Time of the first emergency stop that the columns did not follow yet.
+    uint64_t stopRequestUS{NEVER};
+    RunResult result;
+
+    LogMonitor::RecordCallback gearboxRecordCallback(std::unique_ptr<GearboxNode> &node);
+    void runGearbox(GearboxNode &node);
+    void runController();
+    void runPanel();
+    void sendButtonEvent(const uint8_t button, const uint8_t event);
+    void onEmergencyStop();
+    void measure();
+    long meanHeight() const;
+
+public:
+    DeskSimulation(const Scenario &scenario, const uint32_t busLatencyUS, const uint32_t busJitterUS, const uint32_t seed, const bool isPrintingLogs);
+    ~DeskSimulation() = default;
+
+    RunResult run();
+};
@@ -0,0 +1,111 @@
+// Compiles the gearbox firmware into the namespace SIM_GEARBOX_NAMESPACE, included by SimGearboxLeft.cpp and
+// SimGearboxRight.cpp. Everything outside of the firmware is included before the namespace is opened, thus, only the
+// firmware and the shared libraries end up inside of it.
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <SPI.h>
+#include <AccelStepper.h>
+#include <TMCStepper.h>
+#include <AS5600.h>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include "NativeArduino.hpp"
+#include "SimFirmware.hpp"
+
+namespace SIM_GEARBOX_NAMESPACE
+{
+    // Peripherals of this board, they hide the global stand-ins from the firmware.
+    HardwareSerial Serial;
+    TwoWire Wire;
+
+#include "../../../Getriebe_Test_V1/src/Brake.cpp"
+#include "../../../Getriebe_Test_V1/src/ColumnSync.cpp"
+#include "../../../Getriebe_Test_V1/src/Communication.cpp"
+#include "../../../Getriebe_Test_V1/src/DeskMotor.cpp"
+#include "../../../Getriebe_Test_V1/src/DriverMonitor.cpp"
+#include "../../../Getriebe_Test_V1/src/Gearbox.cpp"
+#include "../../../Getriebe_Test_V1/src/Lightgate.cpp"
+#include "../../../Getriebe_Test_V1/src/MotionProfile.cpp"
+#include "../../../Getriebe_Test_V1/src/MotorTimer.cpp"
+#include "../../../Getriebe_Test_V1/src/RotarySensor.cpp"
+#include "../../../Getriebe_Test_V1/src/SyncedClock.cpp"
+
+    // Plays main.cpp and the FreeRTOS tasks of the gearbox.
+    class DeskSimulatorGearbox : public GearboxFirmware
+    {
+    private:
+        // Same values as in main.cpp.
+        static constexpr float gearboxSensorHeight = 0.0f;
+        static constexpr float gearboxMathematicalHeight = 0.0f;
+        static constexpr uint32_t driverPollIntervalMS = 20u;
+
+        static Communication *communication;
+        MotorTimer *motorTimer{nullptr};
+
+    public:
+        void begin() override
+        {
+            Serial.setMuted(true);
+            communication = new Communication{gearboxSensorHeight, gearboxMathematicalHeight};
+            motorTimer = new MotorTimer{communication->getGearbox()->getDeskMotor(), communication->getGearbox()->getLargeBrake(), []()
+                                        { return communication->processCommands(); }};
+        }
+
+        void end() override
+        {
+            delete motorTimer;
+            delete communication;
+            motorTimer = nullptr;
+            communication = nullptr;
+            MotorTimer::instance = nullptr;
+        }
+
+        uint64_t runMotorCycle() override
+        {
+            const uint32_t cycleDueUS = motorTimer->runCycle();
+            if (cycleDueUS == MotorTimer::NO_CYCLE_DUE)
+            {
+                return UINT64_MAX;
+            }
+            // The task sleeps in whole ticks of 1 ms, see MotorTimer::runTask().
+            return 1000u * ((static_cast<uint64_t>(cycleDueUS) + 999u) / 1000u);
+        }
+
+        void pollDriverStatus() override
+        {
+            if (communication->getGearbox()->getDeskMotor()->pollDriverStatus())
+            {
+                MotorTimer::wake();
+            }
+        }
+
+        uint32_t driverPollIntervalUS() const override { return 1000u * driverPollIntervalMS; }
+
+        void drainLog(Print &output) override { DeferredLog::drain(output, SIZE_MAX); }
+
+        TwoWire &wire() override { return Wire; }
+
+        MotorPins motorPins() const override { return MotorPins{DESK_MOTOR_STEP_PIN, DESK_MOTOR_DIR_PIN, DESK_MOTOR_EN_PIN, RELAY_3V}; }
+
+        uint32_t position() override { return communication->getGearbox()->getCurrentPosition(); }
+
+        uint8_t emergencyStopLinePin() const override { return EMERGENCY_STOP_LINE_PIN; }
+        uint8_t attentionLinePin() const override { return ATTENTION_LINE_PIN; }
+
+        uint32_t syncedMicros() override { return SIM_GEARBOX_NAMESPACE::syncedMicros(); }
+
+        bool isClockSynchronized() override { return SyncedClock::isSynchronized(); }
+    };
+
+    Communication *DeskSimulatorGearbox::communication;
+}
+
+GearboxFirmware &SIM_GEARBOX_FACTORY()
+{
+    static SIM_GEARBOX_NAMESPACE::DeskSimulatorGearbox firmware;
+    return firmware;
+}
@@ -0,0 +1,53 @@
+#include "LogMonitor.hpp"
+
+size_t LogMonitor::write(uint8_t value)
+{
+    return write(&value, 1u);
+}
+
+size_t LogMonitor::write(const uint8_t *data, size_t size)
+{
+    buffer.insert(buffer.end(), data, data + size);
+    decode();
+    return size;
+}
+
+void LogMonitor::decode()
+{
+    size_t offset = 0u;
+    while (offset < buffer.size())
+    {
+        if (buffer[offset] != DeferredLogFormat::FRAME_MAGIC[0u])
+        {
+            // The firmware only sends frames, skip till the next one.
+            offset++;
+            continue;
+        }
+
+        DeferredLogFormat::Record record{};
+        const size_t frameSize = DeferredLogFormat::decodeFrame(&buffer[offset], buffer.size() - offset, record);
+        if (frameSize == 0u)
+        {
+            if (buffer.size() - offset < DeferredLogFormat::MAX_FRAME_SIZE)
+            {
+                // Might be the start of a frame that is not complete yet.
+                break;
+            }
+            offset++;
+            continue;
+        }
+        offset += frameSize;
+
+        if (isPrinting)
+        {
+            char line[256u];
+            DeferredLogFormat::formatLine(line, sizeof(line), record, formats, formatCount);
+            ::printf("%-10s %s\n", name, line);
+        }
+        if (onRecord)
+        {
+            onRecord(record);
+        }
+    }
+    buffer.erase(buffer.begin(), buffer.begin() + offset);
+}
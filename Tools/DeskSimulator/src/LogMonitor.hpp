@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+#include <vector>
+#include <DeferredLogFormat.hpp>
+
+// Receives the deferred log of one firmware, decodes its frames and hands the records to the simulation. Optionally
+// prints them as text, like Tools/DeferredLogDecoder does.
+class LogMonitor : public Print
+{
+public:
+    using RecordCallback = std::function<void(const DeferredLogFormat::Record &record)>;
+
+private:
+    const char *const name;
+    const char *const *const formats;
+    const size_t formatCount;
+    const bool isPrinting;
+    RecordCallback onRecord;
+    std::vector<uint8_t> buffer;
+
+    void decode();
+
+public:
+    template <size_t N>
+    LogMonitor(const char *name, const char *const (&formats)[N], const bool isPrinting, RecordCallback onRecord) : name(name), formats(formats), formatCount(N), isPrinting(isPrinting), onRecord(onRecord)
+    {
+    }
+    ~LogMonitor() = default;
+
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t *data, size_t size) override;
+    using Print::write;
+};
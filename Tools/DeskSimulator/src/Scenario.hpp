@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Column.hpp"
+
+// What the user does on the control panel, the script runs from top to bottom.
+struct PanelAction
+{
+    enum class Type
+    {
+        Click,
+        Press,
+        Release,
+        // Waits for the given time in ms.
+        Wait,
+        // Waits till the mean height of the columns passed the given position, in the direction of the current movement.
+        WaitForHeight,
+        // Waits till both columns rested for the given time in ms.
+        WaitForRest
+    };
+
+    Type type;
+    // Button for Click, Press and Release, see ButtonEvents of the general controller.
+    uint8_t button;
+    long value;
+};
+
+struct Scenario
+{
+    const char *name;
+    const char *description;
+    Column::Parameters leftColumn;
+    Column::Parameters rightColumn;
+    uint32_t busLatencyUS;
+    uint32_t busJitterUS;
+    // Fastest I2C clock the wiring carries.
+    uint32_t busMaxFrequencyHz;
+    std::vector<PanelAction> actions;
+    // Height both columns have to reach, in steps.
+    long targetPosition;
+    uint64_t timeLimitUS;
+    // Each gearbox on an I2C bus of its own, see GEARBOX_SEPARATE_I2C_BUSES of the general controller.
+    bool hasSeparateBuses;
+    // Rate error of the gearbox clocks against the one of the general controller, the right one is off the other way.
+    double clockDriftPPM;
+    // Controller and gearboxes share the emergency stop line, see EMERGENCY_STOP_LINE.
+    bool hasEmergencyStopLine;
+    // The I2C slaves of the gearboxes acknowledge the general call, like the virtual bus. The ones of the firmware on
+    // real hardware do not, thus, the controller has to address each gearbox.
+    bool acceptsGeneralCall;
+};
+
+std::vector<Scenario> createScenarios();
@@ -0,0 +1,72 @@
+#include "Scenario.hpp"
+
+namespace
+{
+    // Button ids and events of the control panel, see ButtonEvents.hpp of the general controller.
+    constexpr uint8_t ID_MAIN{0u};
+    constexpr uint8_t ID_MOVE_UP{1u};
+    constexpr uint8_t ID_MOVE_DOWN{2u};
+    constexpr uint8_t ID_SHORTCUT_2{4u};
+
+    // Target of the move to shortcut, see InputController::performDriveMode().
+    constexpr long MOVE_TO_POSITION{40000};
+    constexpr long JOG_HEIGHT{8000};
+    constexpr uint32_t BUS_LATENCY_US{300u};
+    constexpr uint32_t BUS_JITTER_US{400u};
+    // Latency of a bus that is shared with other devices or a slave that is busy with interrupts.
+    constexpr uint32_t SLOW_BUS_LATENCY_US{3000u};
+    constexpr uint32_t SLOW_BUS_JITTER_US{6000u};
+    constexpr uint32_t FAST_MODE_PLUS_HZ{1000000u};
+    // Long cables to the columns, too much capacitance for Fast-mode Plus.
+    constexpr uint32_t LONG_WIRING_MAX_HZ{400000u};
+    // Beyond the tolerance of common crystals.
+    constexpr double CLOCK_DRIFT_PPM{100.0};
+
+    // About 20 kg per column, the motor keeps up with it at full speed. The driver counts lost steps with dcStep, like
+    // the TMC2130 as DeskMotor sets it up.
+    constexpr Column::Parameters BALANCED{200.0, 100.0, 1000.0, 4000.0, true};
+    // Monitor arm on one side, the motor pulls out close to its max speed.
+    constexpr Column::Parameters HEAVY{650.0, 100.0, 1000.0, 4000.0, true};
+    // Same load with a driver whose DCEN input is not tied high, it does not count the lost steps.
+    constexpr Column::Parameters HEAVY_NO_DCSTEP{650.0, 100.0, 1000.0, 4000.0, false};
+
+    PanelAction click(const uint8_t button) { return PanelAction{PanelAction::Type::Click, button, 0}; }
+    PanelAction press(const uint8_t button) { return PanelAction{PanelAction::Type::Press, button, 0}; }
+    PanelAction release(const uint8_t button) { return PanelAction{PanelAction::Type::Release, button, 0}; }
+    PanelAction wait(const long durationMS) { return PanelAction{PanelAction::Type::Wait, 0u, durationMS}; }
+    PanelAction waitForHeight(const long position) { return PanelAction{PanelAction::Type::WaitForHeight, 0u, position}; }
+    PanelAction waitForRest(const long durationMS) { return PanelAction{PanelAction::Type::WaitForRest, 0u, durationMS}; }
+
+    // Holds the button till the desk reached the height, then lets it come to rest.
+    std::vector<PanelAction> jog(const uint8_t button, const long position)
+    {
+        return {click(ID_MAIN), wait(300), press(button), waitForHeight(position), release(button), waitForRest(1000)};
+    }
+}
+
+std::vector<Scenario> createScenarios()
+{
+    const std::vector<PanelAction> jogUpDown{click(ID_MAIN), wait(300), press(ID_MOVE_UP), waitForHeight(JOG_HEIGHT), release(ID_MOVE_UP),
+                                             wait(500), press(ID_MOVE_DOWN), waitForHeight(0), release(ID_MOVE_DOWN), waitForRest(1000)};
+    // The wait lets the gearboxes synchronize their clocks in some of the runs, thus, segments start on the synchronized
+    // clock as well as by their reception.
+    const std::vector<PanelAction> moveTo{click(ID_MAIN), wait(2000), click(ID_SHORTCUT_2), waitForHeight(MOVE_TO_POSITION), waitForRest(1000)};
+
+    const std::vector<PanelAction> idle{wait(10000)};
+
+    return {
+        {"jog-up", "Balanced load, hold up", BALANCED, BALANCED, BUS_LATENCY_US, BUS_JITTER_US, FAST_MODE_PLUS_HZ, jog(ID_MOVE_UP, JOG_HEIGHT), JOG_HEIGHT, 60000000u, false, 0.0, false, true},
+        {"jog-up-down", "Balanced load, hold up, then down", BALANCED, BALANCED, BUS_LATENCY_US, BUS_JITTER_US, FAST_MODE_PLUS_HZ, jogUpDown, 0, 60000000u, false, 0.0, false, true},
+        {"move-to", "Balanced load, move to shortcut", BALANCED, BALANCED, BUS_LATENCY_US, BUS_JITTER_US, FAST_MODE_PLUS_HZ, moveTo, MOVE_TO_POSITION, 90000000u, false, 0.0, false, true},
+        {"asym-up", "Heavy right side, hold up", BALANCED, HEAVY, BUS_LATENCY_US, BUS_JITTER_US, FAST_MODE_PLUS_HZ, jog(ID_MOVE_UP, JOG_HEIGHT), JOG_HEIGHT, 60000000u, false, 0.0, false, true},
+        {"asym-move-to", "Heavy right side, move to shortcut", BALANCED, HEAVY, BUS_LATENCY_US, BUS_JITTER_US, FAST_MODE_PLUS_HZ, moveTo, MOVE_TO_POSITION, 90000000u, false, 0.0, false, true},
+        {"asym-up-line", "Heavy right side, hold up, the gearboxes share the emergency stop line", BALANCED, HEAVY, BUS_LATENCY_US, BUS_JITTER_US, FAST_MODE_PLUS_HZ, jog(ID_MOVE_UP, JOG_HEIGHT), JOG_HEIGHT, 60000000u, false, 0.0, true, true},
+        {"asym-no-dcstep", "Heavy right side, hold up, the driver does not count lost steps", BALANCED, HEAVY_NO_DCSTEP, BUS_LATENCY_US, BUS_JITTER_US, FAST_MODE_PLUS_HZ, jog(ID_MOVE_UP, JOG_HEIGHT), JOG_HEIGHT, 60000000u, false, 0.0, false, true},
+        {"slow-bus", "Balanced load, hold up on a slow bus", BALANCED, BALANCED, SLOW_BUS_LATENCY_US, SLOW_BUS_JITTER_US, FAST_MODE_PLUS_HZ, jog(ID_MOVE_UP, JOG_HEIGHT), JOG_HEIGHT, 60000000u, false, 0.0, false, true},
+        {"separate-buses", "Balanced load, hold up, then down, one bus per gearbox", BALANCED, BALANCED, BUS_LATENCY_US, BUS_JITTER_US, FAST_MODE_PLUS_HZ, jogUpDown, 0, 60000000u, true, 0.0, false, true},
+        {"long-wiring", "Balanced load, hold up, the bus falls back to Fast-mode", BALANCED, BALANCED, BUS_LATENCY_US, BUS_JITTER_US, LONG_WIRING_MAX_HZ, jog(ID_MOVE_UP, JOG_HEIGHT), JOG_HEIGHT, 60000000u, false, 0.0, false, true},
+        {"idle", "Balanced load, the desk rests", BALANCED, BALANCED, BUS_LATENCY_US, BUS_JITTER_US, FAST_MODE_PLUS_HZ, idle, 0, 20000000u, false, 0.0, false, true},
+        {"no-general-call", "Balanced load, move to shortcut, the gearboxes reject the general call", BALANCED, BALANCED, BUS_LATENCY_US, BUS_JITTER_US, FAST_MODE_PLUS_HZ, moveTo, MOVE_TO_POSITION, 90000000u, false, 0.0, true, false},
+        {"clock-drift", "Balanced load, move to shortcut, the gearbox clocks drift apart", BALANCED, BALANCED, BUS_LATENCY_US, BUS_JITTER_US, FAST_MODE_PLUS_HZ, moveTo, MOVE_TO_POSITION, 90000000u, false, CLOCK_DRIFT_PPM, false, true},
+    };
+}
@@ -0,0 +1,138 @@
+// Firmware of the general controller, compiled into the namespace GeneralController like the gearboxes, see
+// GearboxFirmware.inl.
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "SimFirmware.hpp"
+
+namespace GeneralController
+{
+    // Peripherals of this board, they hide the global stand-ins from the firmware.
+    HardwareSerial Serial;
+    HardwareSerial Serial2;
+    TwoWire Wire;
+    TwoWire Wire1;
+
+#include "../../../GeneralController/src/ControlPanelCommunication.cpp"
+#include "../../../GeneralController/src/I2cTransactionEngine.cpp"
+#include "../../../GeneralController/src/GearboxCommunication.cpp"
+#include "../../../GeneralController/src/InputController.cpp"
+#include "../../../GeneralController/src/LoopScheduler.cpp"
+
+    // Plays main.cpp of the general controller. The simulator calls runLoop() when the next iteration is due instead of
+    // sleeping, and runControlPanelReader() once bytes of the control panel arrived.
+    class DeskSimulatorController : public ControllerFirmware
+    {
+    private:
+        // Same values as in main.cpp.
+        static constexpr uint8_t GEARBOX_LEFT_ADDRESS = 0x33;
+        static constexpr uint8_t GEARBOX_RIGHT_ADDRESS = 0x88;
+        static constexpr int I2C_SDA_PIN = 21;
+        static constexpr int I2C_SCL_PIN = 22;
+        static constexpr int I2C_RIGHT_SDA_PIN = 25;
+        static constexpr int I2C_RIGHT_SCL_PIN = 26;
+        static constexpr uint32_t I2C_FREQ = 1000000u;
+        static constexpr int8_t UART_TX_PIN = 17;
+        static constexpr int8_t UART_RX_PIN = 16;
+        static constexpr uint32_t UART_CONFIG = SERIAL_8N1;
+        static constexpr uint32_t UART_BAUDRATE = 115200u;
+        static constexpr LoopScheduler::CatchUpPolicy LOOP_CATCH_UP_POLICY = LoopScheduler::CatchUpPolicy::Skip;
+
+        GearboxCommunication *gearbox{nullptr};
+        InputEventQueue eventQueue;
+        InputController *inputController{nullptr};
+        ControlPanelCommunication *controlPanelCommunication{nullptr};
+        LoopScheduler *loopScheduler{nullptr};
+
+    public:
+        void begin(const bool hasSeparateBuses) override
+        {
+            Serial.setMuted(true);
+            if (hasSeparateBuses)
+            {
+                gearbox = new GearboxCommunication(GEARBOX_LEFT_ADDRESS, GEARBOX_RIGHT_ADDRESS, &Wire, I2C_SDA_PIN, I2C_SCL_PIN, &Wire1, I2C_RIGHT_SDA_PIN, I2C_RIGHT_SCL_PIN, I2C_FREQ);
+            }
+            else
+            {
+                gearbox = new GearboxCommunication(GEARBOX_LEFT_ADDRESS, GEARBOX_RIGHT_ADDRESS, &Wire, I2C_SDA_PIN, I2C_SCL_PIN, I2C_FREQ);
+            }
+            inputController = new InputController(gearbox, &eventQueue);
+            controlPanelCommunication = new ControlPanelCommunication(&eventQueue, UART_TX_PIN, UART_RX_PIN, UART_CONFIG, UART_BAUDRATE);
+            loopScheduler = new LoopScheduler(inputController->getLoopIntervalUS(), LOOP_CATCH_UP_POLICY);
+            loopScheduler->begin(micros());
+        }
+
+        void end() override
+        {
+            delete loopScheduler;
+            delete controlPanelCommunication;
+            delete inputController;
+            delete gearbox;
+            controlPanelCommunication = nullptr;
+            loopScheduler = nullptr;
+            inputController = nullptr;
+            gearbox = nullptr;
+            InputEvent event{};
+            while (eventQueue.pop(event))
+            {
+            }
+            // Drop what the control panel sent after the last loop.
+            while (Serial2.available() > 0)
+            {
+                Serial2.read();
+            }
+        }
+
+        void runLoop() override
+        {
+            loopScheduler->beginIteration(micros());
+
+            gearbox->processReplies();
+
+            inputController->update();
+
+            // Plays the I2C task, which starts on the queued transactions right away.
+            gearbox->busLeft.processQueue();
+            gearbox->busRight.processQueue();
+
+            loopScheduler->endIteration(micros(), inputController->getLoopIntervalUS());
+        }
+
+        uint64_t nextLoopUS() const override { return loopScheduler->getDueUS(); }
+
+        bool runControlPanelReader() override
+        {
+            const size_t queuedEvents = eventQueue.size();
+            while (controlPanelCommunication->update())
+            {
+            }
+            return eventQueue.size() != queuedEvents;
+        }
+
+        void drainLog(Print &output) override { DeferredLog::drain(output, SIZE_MAX); }
+
+        TwoWire &wire() override { return Wire; }
+        TwoWire &wireRight() override { return Wire1; }
+
+        HardwareSerial &controlPanelUart() override { return Serial2; }
+
+        uint8_t gearboxLeftAddress() const override { return GEARBOX_LEFT_ADDRESS; }
+
+        uint8_t gearboxRightAddress() const override { return GEARBOX_RIGHT_ADDRESS; }
+
+        uint8_t emergencyStopLinePin() const override { return EMERGENCY_STOP_LINE_PIN; }
+        uint8_t gearboxAttentionPin(const bool isLeftGearbox) const override { return isLeftGearbox ? GEARBOX_LEFT_ATTENTION_PIN : GEARBOX_RIGHT_ATTENTION_PIN; }
+    };
+}
+
+ControllerFirmware &controllerFirmware()
+{
+    static GeneralController::DeskSimulatorController firmware;
+    return firmware;
+}
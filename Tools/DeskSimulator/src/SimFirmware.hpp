@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// The firmwares of the desk, each compiled into its own namespace (see GearboxFirmware.inl and SimController.cpp), such
+// that two gearboxes and the general controller live in one process. The simulator selects the board of a firmware
+// before it calls into it.
+
+// Pins of the desk motor that the mechanical model watches.
+struct MotorPins
+{
+    uint8_t step;
+    uint8_t direction;
+    // Active low.
+    uint8_t enable;
+    // Relay that powers the motor driver.
+    uint8_t driverPower;
+};
+
+class GearboxFirmware
+{
+public:
+    virtual ~GearboxFirmware() = default;
+
+    // Constructs the objects that main.cpp of the gearbox creates, respectively destroys them again.
+    virtual void begin() = 0;
+    virtual void end() = 0;
+
+    // One cycle of the motor task: pending commands are executed and the due steps are done. The task sleeps afterwards
+    // until the timer alarm, a notification or the returned time, UINT64_MAX if it does not wake on its own, see
+    // MotorTimer.
+    virtual uint64_t runMotorCycle() = 0;
+    // One poll of the driver monitor task.
+    virtual void pollDriverStatus() = 0;
+    virtual uint32_t driverPollIntervalUS() const = 0;
+    virtual void drainLog(Print &output) = 0;
+
+    // I2C slave that the virtual bus delivers to.
+    virtual TwoWire &wire() = 0;
+    virtual MotorPins motorPins() const = 0;
+    // Position the firmware believes to be at, in steps.
+    virtual uint32_t position() = 0;
+    // Pin of the emergency stop line, see EMERGENCY_STOP_LINE.
+    virtual uint8_t emergencyStopLinePin() const = 0;
+    // Pin of the attention line to the controller, see GEARBOX_ATTENTION_LINE.
+    virtual uint8_t attentionLinePin() const = 0;
+    // Estimate of the clock of the general controller, see syncedMicros().
+    virtual uint32_t syncedMicros() = 0;
+    virtual bool isClockSynchronized() = 0;
+};
+
+class ControllerFirmware
+{
+public:
+    virtual ~ControllerFirmware() = default;
+
+    // Constructs the objects that main.cpp of the general controller creates, respectively destroys them again. The right
+    // gearbox gets its own bus like with GEARBOX_SEPARATE_I2C_BUSES if requested.
+    virtual void begin(const bool hasSeparateBuses) = 0;
+    virtual void end() = 0;
+
+    // Body of the control task without the wait for the next iteration.
+    virtual void runLoop() = 0;
+    // Body of the control panel reader task, returns true if it queued events, which wake the control task.
+    virtual bool runControlPanelReader() = 0;
+    // Time at which the next iteration is due.
+    virtual uint64_t nextLoopUS() const = 0;
+    virtual void drainLog(Print &output) = 0;
+
+    // I2C master that is attached to the virtual bus.
+    virtual TwoWire &wire() = 0;
+    // I2C master of the right gearbox, only used with separate buses.
+    virtual TwoWire &wireRight() = 0;
+    // UART that receives the messages of the control panel.
+    virtual HardwareSerial &controlPanelUart() = 0;
+    virtual uint8_t gearboxLeftAddress() const = 0;
+    virtual uint8_t gearboxRightAddress() const = 0;
+    virtual uint8_t emergencyStopLinePin() const = 0;
+    virtual uint8_t gearboxAttentionPin(const bool isLeftGearbox) const = 0;
+};
+
+GearboxFirmware &leftGearboxFirmware();
+GearboxFirmware &rightGearboxFirmware();
+ControllerFirmware &controllerFirmware();
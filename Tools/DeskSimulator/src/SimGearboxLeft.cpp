@@ -0,0 +1,7 @@
+// Firmware of the left gearbox.
+
+#define GEARBOX_LEFT
+#define SIM_GEARBOX_NAMESPACE GearboxLeft
+#define SIM_GEARBOX_FACTORY leftGearboxFirmware
+
+#include "GearboxFirmware.inl"
@@ -0,0 +1,7 @@
+// Firmware of the right gearbox.
+
+#define GEARBOX_RIGHT
+#define SIM_GEARBOX_NAMESPACE GearboxRight
+#define SIM_GEARBOX_FACTORY rightGearboxFirmware
+
+#include "GearboxFirmware.inl"
@@ -0,0 +1,182 @@
+#include "VirtualBus.hpp"
+
+VirtualI2cBus::VirtualI2cBus(const uint32_t frequencyHz, const uint32_t maxFrequencyHz, const uint32_t latencyUS, const uint32_t jitterUS, const uint32_t seed) : frequencyHz(frequencyHz), maxFrequencyHz(maxFrequencyHz), latencyUS(latencyUS), jitterUS(jitterUS), random(seed)
+{
+}
+
+void VirtualI2cBus::addSlave(const uint16_t address, NativeArduino::Board &board, TwoWire &wire)
+{
+    slaves[address] = Slave{&board, &wire, 0u};
+}
+
+uint64_t VirtualI2cBus::transfer(const size_t size)
+{
+    // Every byte takes 9 clocks including the acknowledge, plus start and stop condition.
+    const uint64_t clocks = 9u * (1u + size) + 2u;
+    transfers++;
+    busyUntilUS = max(busyUntilUS, NativeArduino::now()) + ((clocks * 1000000u) + frequencyHz - 1u) / frequencyHz;
+    NativeArduino::currentBoard().busyUntilUS = busyUntilUS;
+    return busyUntilUS;
+}
+
+uint8_t VirtualI2cBus::transmit(const uint16_t address, const uint8_t *data, const size_t size)
+{
+    const uint64_t transferEndUS = transfer(size);
+    if (frequencyHz > maxFrequencyHz)
+    {
+        return 2u;
+    }
+    if ((address == GENERAL_CALL_ADDRESS) && !slaves.empty())
+    {
+        if (!isGeneralCallAccepted)
+        {
+            return 2u;
+        }
+        for (auto &slave : slaves)
+        {
+            schedule(slave.first, slave.second, transferEndUS, data, size);
+        }
+        return 0u;
+    }
+
+    const auto slave = slaves.find(address);
+    if (slave == slaves.end())
+    {
+        // NACK on the address.
+        return 2u;
+    }
+    schedule(address, slave->second, transferEndUS, data, size);
+    return 0u;
+}
+
+void VirtualI2cBus::schedule(const uint16_t address, Slave &slave, const uint64_t transferEndUS, const uint8_t *data, const size_t size)
+{
+    const uint32_t jitter = jitterUS > 0u ? std::uniform_int_distribution<uint32_t>(0u, jitterUS)(random) : 0u;
+    // The slave task does not overtake itself.
+    const uint64_t deliveryUS = max(transferEndUS + latencyUS + jitter, slave.lastDeliveryUS);
+    slave.lastDeliveryUS = deliveryUS;
+
+    Delivery delivery{deliveryUS, address, std::vector<uint8_t>(data, data + size)};
+    auto position = deliveries.end();
+    while (position != deliveries.begin() && (position - 1)->timeUS > deliveryUS)
+    {
+        position--;
+    }
+    deliveries.insert(position, delivery);
+}
+
+size_t VirtualI2cBus::request(const uint16_t address, uint8_t *data, const size_t size)
+{
+    const uint64_t startUS = max(busyUntilUS, NativeArduino::now());
+    transfer(size);
+    const auto slave = slaves.find(address);
+    if ((slave == slaves.end()) || (frequencyHz > maxFrequencyHz))
+    {
+        return 0u;
+    }
+
+    NativeArduino::Board &master = NativeArduino::currentBoard();
+    NativeArduino::Board &slaveBoard = *slave->second.board;
+    const uint64_t slaveBusyUntilUS = slaveBoard.busyUntilUS;
+    slaveBoard.busyUntilUS = max(slaveBusyUntilUS, startUS);
+    NativeArduino::selectBoard(slaveBoard);
+    const size_t count = slave->second.wire->request(data, size);
+    NativeArduino::selectBoard(master);
+    slaveBoard.busyUntilUS = slaveBusyUntilUS;
+    return count;
+}
+
+uint64_t VirtualI2cBus::nextDeliveryUS() const
+{
+    return deliveries.empty() ? NOTHING_PENDING : deliveries.front().timeUS;
+}
+
+NativeArduino::Board &VirtualI2cBus::deliverNext()
+{
+    const Delivery delivery = deliveries.front();
+    deliveries.pop_front();
+
+    Slave &slave = slaves[delivery.address];
+    NativeArduino::selectBoard(*slave.board);
+    slave.wire->receive(delivery.data.data(), delivery.data.size());
+    return *slave.board;
+}
+
+void VirtualOpenDrainLine::attach(NativeArduino::Board &board, const uint8_t pin)
+{
+    const size_t tapIndex = taps.size();
+    taps.push_back(Tap{&board, pin, false});
+    board.pinLevels[pin] = level;
+    const std::function<void(uint8_t, uint8_t)> previousCallback = board.onPinWrite;
+    board.onPinWrite = [this, tapIndex, pin, previousCallback](const uint8_t writtenPin, const uint8_t value)
+    {
+        if (writtenPin == pin)
+        {
+            onPinWrite(tapIndex, value);
+        }
+        else if (previousCallback)
+        {
+            previousCallback(writtenPin, value);
+        }
+    };
+}
+
+void VirtualOpenDrainLine::onPinWrite(const size_t tapIndex, const uint8_t value)
+{
+    Tap &writer = taps[tapIndex];
+    writer.isDrivingLow = value == LOW;
+    bool isLow{false};
+    for (const Tap &tap : taps)
+    {
+        isLow |= tap.isDrivingLow;
+    }
+    const uint8_t newLevel = isLow ? LOW : HIGH;
+    // The pin of the writing board reads the line and not what the board drives.
+    writer.board->pinLevels[writer.pin] = newLevel;
+    if (newLevel == level)
+    {
+        return;
+    }
+    level = newLevel;
+
+    NativeArduino::Board &currentBoard = NativeArduino::currentBoard();
+    for (Tap &tap : taps)
+    {
+        if (&tap != &writer)
+        {
+            NativeArduino::selectBoard(*tap.board);
+            NativeArduino::setInputLevel(tap.pin, newLevel);
+        }
+    }
+    NativeArduino::selectBoard(currentBoard);
+}
+
+VirtualUart::VirtualUart(HardwareSerial &receiver, const uint32_t baudrate) : receiver(receiver), byteTimeUS((BITS_PER_BYTE * 1000000u + baudrate - 1u) / baudrate)
+{
+}
+
+void VirtualUart::send(const uint8_t *data, const size_t size)
+{
+    for (size_t i = 0u; i < size; i++)
+    {
+        busyUntilUS = max(busyUntilUS, NativeArduino::now()) + byteTimeUS;
+        bytes.emplace_back(busyUntilUS, data[i]);
+    }
+}
+
+uint64_t VirtualUart::nextDeliveryUS() const
+{
+    return bytes.empty() ? VirtualI2cBus::NOTHING_PENDING : bytes.front().first;
+}
+
+bool VirtualUart::deliverDue()
+{
+    bool isDelivered{false};
+    while (!bytes.empty() && bytes.front().first <= NativeArduino::now())
+    {
+        receiver.receive(&bytes.front().second, 1u);
+        bytes.pop_front();
+        isDelivered = true;
+    }
+    return isDelivered;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+#include "NativeArduino.hpp"
+
+// I2C bus between the general controller and the gearboxes. A write of the master reaches the slave after its transfer
+// time plus a latency with random jitter, writes to the same slave stay in order. Reads are answered right away with the
+// reply the slave prepared, i.e. before any write that is still on its way, the slave's clock reads the start of the
+// read meanwhile. The master's clock reads the end of its transfers. A write to the general call address reaches all
+// slaves, each with a jitter of its own, or is not acknowledged if the slaves do not accept general calls. Above the
+// fastest clock that the wiring carries, no slave recognizes its address.
+class VirtualI2cBus : public I2cBus
+{
+public:
+    static constexpr uint64_t NOTHING_PENDING{UINT64_MAX};
+    static constexpr uint16_t GENERAL_CALL_ADDRESS{0x00u};
+
+private:
+    struct Slave
+    {
+        NativeArduino::Board *board;
+        TwoWire *wire;
+        uint64_t lastDeliveryUS;
+    };
+    struct Delivery
+    {
+        uint64_t timeUS;
+        uint16_t address;
+        std::vector<uint8_t> data;
+    };
+
+    uint32_t frequencyHz;
+    const uint32_t maxFrequencyHz;
+    const uint32_t latencyUS;
+    const uint32_t jitterUS;
+    bool isGeneralCallAccepted{true};
+    std::mt19937 random;
+    std::map<uint16_t, Slave> slaves;
+    // Sorted by time.
+    std::deque<Delivery> deliveries;
+    // Time at which the last transfer ends.
+    uint64_t busyUntilUS{0u};
+    // Writes and reads of the master.
+    uint32_t transfers{0u};
+
+    // Occupies the bus for the transfer of the address and the given number of bytes, returns when the transfer ends.
+    uint64_t transfer(const size_t size);
+    void schedule(const uint16_t address, Slave &slave, const uint64_t transferEndUS, const uint8_t *data, const size_t size);
+
+public:
+    VirtualI2cBus(const uint32_t frequencyHz, const uint32_t maxFrequencyHz, const uint32_t latencyUS, const uint32_t jitterUS, const uint32_t seed);
+    ~VirtualI2cBus() = default;
+
+    void addSlave(const uint16_t address, NativeArduino::Board &board, TwoWire &wire);
+
+    uint8_t transmit(const uint16_t address, const uint8_t *data, const size_t size) override;
+    size_t request(const uint16_t address, uint8_t *data, const size_t size) override;
+    void setClock(const uint32_t newFrequencyHz) override { frequencyHz = newFrequencyHz; }
+    void setGeneralCallAccepted(const bool isAccepted) { isGeneralCallAccepted = isAccepted; }
+    uint32_t getTransfers() const { return transfers; }
+
+    uint64_t nextDeliveryUS() const;
+    // Hands the next write to the receive callback of its slave and returns the board of the slave.
+    NativeArduino::Board &deliverNext();
+};
+
+// Open-drain line between boards, e.g. the emergency stop line, pulled up while no board drives it low. A change of its
+// level reaches the pins of the other boards right away, including their pin interrupts.
+class VirtualOpenDrainLine
+{
+private:
+    struct Tap
+    {
+        NativeArduino::Board *board;
+        uint8_t pin;
+        bool isDrivingLow;
+    };
+
+    std::vector<Tap> taps;
+    uint8_t level{HIGH};
+
+    void onPinWrite(const size_t tapIndex, const uint8_t value);
+
+public:
+    VirtualOpenDrainLine() = default;
+    ~VirtualOpenDrainLine() = default;
+
+    // Connects the pin of the board to the line, other pins keep their callback. The pin reads the level of the line.
+    void attach(NativeArduino::Board &board, const uint8_t pin);
+    uint8_t getLevel() const { return level; }
+};
+
+// UART from the control panel to the general controller, bytes arrive one after the other at the baud rate.
+class VirtualUart
+{
+private:
+    // Start, 8 data bits and stop.
+    static constexpr uint32_t BITS_PER_BYTE{10u};
+
+    HardwareSerial &receiver;
+    const uint64_t byteTimeUS;
+    std::deque<std::pair<uint64_t, uint8_t>> bytes;
+    uint64_t busyUntilUS{0u};
+
+public:
+    VirtualUart(HardwareSerial &receiver, const uint32_t baudrate);
+    ~VirtualUart() = default;
+
+    void send(const uint8_t *data, const size_t size);
+
+    uint64_t nextDeliveryUS() const;
+    // Hands all bytes to the receiver that arrived till now, returns false if there were none.
+    bool deliverDue();
+};
@@ -0,0 +1,165 @@
+// Whole-desk simulator: the general controller and both gearboxes run their real firmware against a virtual I2C bus, a
+// virtual UART and a mechanical model of the two columns. Every scenario is repeated with different bus jitter and
+// summarized in one line.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "DeskSimulation.hpp"
+#include "Scenario.hpp"
+
+namespace
+{
+    struct Options
+    {
+        uint32_t runs{20u};
+        uint32_t seed{1u};
+        // Negative values keep the bus timing of the scenario.
+        long busLatencyUS{-1};
+        long busJitterUS{-1};
+        std::string scenario;
+        bool isPrintingLogs{false};
+    };
+
+    void printUsage(const char *program)
+    {
+        printf("Usage: %s [--runs N] [--seed N] [--latency-us N] [--jitter-us N] [--scenario NAME] [--log]\n", program);
+    }
+
+    bool parseOptions(const int argc, char **argv, Options &options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string option = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (option == "--log")
+            {
+                options.isPrintingLogs = true;
+            }
+            else if (option == "--runs" && hasValue)
+            {
+                options.runs = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+            }
+            else if (option == "--seed" && hasValue)
+            {
+                options.seed = strtoul(argv[++i], nullptr, 10);
+            }
+            else if (option == "--latency-us" && hasValue)
+            {
+                options.busLatencyUS = strtol(argv[++i], nullptr, 10);
+            }
+            else if (option == "--jitter-us" && hasValue)
+            {
+                options.busJitterUS = strtol(argv[++i], nullptr, 10);
+            }
+            else if (option == "--scenario" && hasValue)
+            {
+                options.scenario = argv[++i];
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void printSummary(const Scenario &scenario, const std::vector<RunResult> &results)
+    {
+        long peakColumnDeviation{0};
+        long peakFirmwareDeviation{0};
+        long peakClockError{0};
+        uint64_t peakStopLatencyUS{0u};
+        size_t reachedCount{0u};
+        uint64_t timeToTargetUS{0u};
+        uint32_t emergencyStops{0u};
+        size_t runsWithEmergencyStop{0u};
+        uint64_t lostSteps{0u};
+        uint64_t busTransfers{0u};
+        uint64_t simulatedUS{0u};
+        for (const RunResult &result : results)
+        {
+            peakColumnDeviation = std::max(peakColumnDeviation, result.peakColumnDeviation);
+            peakFirmwareDeviation = std::max(peakFirmwareDeviation, result.peakFirmwareDeviation);
+            peakClockError = std::max(peakClockError, result.peakClockError);
+            peakStopLatencyUS = std::max(peakStopLatencyUS, result.peakStopLatencyUS);
+            if (result.hasReachedTarget)
+            {
+                reachedCount++;
+                timeToTargetUS += result.timeToTargetUS;
+            }
+            const uint32_t runEmergencyStops = result.controllerEmergencyStops + result.gearboxEmergencyStops;
+            emergencyStops += runEmergencyStops;
+            runsWithEmergencyStop += runEmergencyStops > 0u ? 1u : 0u;
+            lostSteps += result.lostStepsLeft + result.lostStepsRight;
+            busTransfers += result.busTransfers;
+            simulatedUS += result.simulatedUS;
+        }
+
+        char timeToTarget[32u];
+        if (reachedCount > 0u)
+        {
+            snprintf(timeToTarget, sizeof(timeToTarget), "%.2f s", timeToTargetUS / 1e6 / reachedCount);
+        }
+        else
+        {
+            snprintf(timeToTarget, sizeof(timeToTarget), "-");
+        }
+        printf("%-16s %9ld %9ld %11s %5zu/%-3zu %9.2f %5zu/%-3zu %10.0f %9ld %9llu %9.0f\n", scenario.name, peakColumnDeviation, peakFirmwareDeviation,
+               timeToTarget, reachedCount, results.size(), static_cast<double>(emergencyStops) / results.size(), runsWithEmergencyStop,
+               results.size(), static_cast<double>(lostSteps) / results.size(), peakClockError, static_cast<unsigned long long>(peakStopLatencyUS),
+               busTransfers / (simulatedUS / 1e6));
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    const std::vector<Scenario> scenarios = createScenarios();
+    printf("%-16s %9s %9s %11s %9s %9s %9s %10s %9s %9s %9s\n", "Scenario", "Dev col", "Dev fw", "To target", "Reached", "E-stops", "E-stop", "Lost", "Clock", "Stop", "Bus");
+    printf("%-16s %9s %9s %11s %9s %9s %9s %10s %9s %9s %9s\n", "", "(steps)", "(steps)", "(mean)", "", "per run", "runs", "steps/run", "(us)", "(us)", "(1/s)");
+
+    const auto hostStart = std::chrono::steady_clock::now();
+    uint64_t simulatedUS{0u};
+    bool hasScenario{false};
+    for (const Scenario &scenario : scenarios)
+    {
+        if (!options.scenario.empty() && options.scenario != scenario.name)
+        {
+            continue;
+        }
+        hasScenario = true;
+
+        const uint32_t busLatencyUS = options.busLatencyUS >= 0 ? static_cast<uint32_t>(options.busLatencyUS) : scenario.busLatencyUS;
+        const uint32_t busJitterUS = options.busJitterUS >= 0 ? static_cast<uint32_t>(options.busJitterUS) : scenario.busJitterUS;
+        std::vector<RunResult> results;
+        for (uint32_t run = 0u; run < options.runs; run++)
+        {
+            DeskSimulation simulation(scenario, busLatencyUS, busJitterUS, options.seed + run, options.isPrintingLogs);
+            results.push_back(simulation.run());
+            simulatedUS += results.back().simulatedUS;
+        }
+        printSummary(scenario, results);
+    }
+
+    if (!hasScenario)
+    {
+        printf("Unknown scenario: %s\n", options.scenario.c_str());
+        return 1;
+    }
+
+    const double hostSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - hostStart).count();
+    printf("\nSimulated %.1f s in %.1f s (%.0fx real time)\n", simulatedUS / 1e6, hostSeconds, simulatedUS / 1e6 / std::max(hostSeconds, 1e-9));
+    return 0;
+}